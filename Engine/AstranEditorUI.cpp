@@ -9,8 +9,27 @@
 #include "backends/imgui_impl_vulkan.h"
 
 #include "Renderer/Texture.h"
+#include "Renderer/TextureLoader.h"
+#include "Renderer/TextureAtlas.h"
+#include "Renderer/UploadManager.h"
+#include "Renderer/DeviceMemoryAllocator.h"
+#include "Renderer/SamplerCache.h"
+#include "Renderer/TextureResidency.h"
+#include "Renderer/TextureRegistry.h"
+#include "Renderer/ThumbnailService.h"
+#include "Renderer/FrameContext.h"
+#include "Renderer/OneShotSubmitter.h"
+#include "Renderer/GpuCompletionTracker.h"
+#include "Renderer/PipelineCache.h"
+#include "Renderer/PixelKernels.h"
+#include "ImageViewerPanel.h"
+#include "Core/JobSystem.h"
+#include "Core/MappedFile.h"
 #include "AstranWidgetUI.h"
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <mutex>
 
 #pragma region NN
 
@@ -20,17 +39,51 @@ static VkPhysicalDevice         g_PhysicalDevice = VK_NULL_HANDLE;
 static VkDevice                 g_Device = VK_NULL_HANDLE;
 static uint32_t                 g_QueueFamily = (uint32_t)-1;
 static VkQueue                  g_Queue = VK_NULL_HANDLE;
+// Transfer only (DMA) and compute without graphics families, the graphics family where there are none
+static uint32_t                 g_TransferQueueFamily = (uint32_t)-1;
+static VkQueue                  g_TransferQueue = VK_NULL_HANDLE;
+static uint32_t                 g_ComputeQueueFamily = (uint32_t)-1;
+static VkQueue                  g_ComputeQueue = VK_NULL_HANDLE;
 static VkDebugReportCallbackEXT g_DebugReport = VK_NULL_HANDLE;
-static VkPipelineCache          g_PipelineCache = VK_NULL_HANDLE;
 static VkDescriptorPool         g_DescriptorPool = VK_NULL_HANDLE;
 
 static ImGui_ImplVulkanH_Window g_MainWindowData;
 static int                      g_MinImageCount = 2;
+// Frames the CPU may build ahead of the GPU, independent of the swapchain image count
+static uint32_t                 g_FramesInFlight = 2;
 static bool                     g_SwapChainRebuild = false;
 
 static const int RESOLUTION_X = 800;
 static const int RESOLUTION_Y = 600;
 static bool ShowConsoleWindow;
+// VK_EXT_memory_budget is enabled on g_Device, see TextureResidency
+static bool                     g_HasMemoryBudget = false;
+// VK_KHR_timeline_semaphore is enabled on g_Device, see GpuCompletionTracker
+static bool                     g_HasTimelineSemaphore = false;
+
+// Font files ImGui reads straight from the mapping, kept until the context is gone
+static std::vector<std::unique_ptr<MappedFile>> g_FontFiles;
+
+// AddFontFromFileTTF without the heap copy, the atlas reads the mapped file and never owns it
+static ImFont* AddFontFromMappedFile(ImFontAtlas* atlas, const char* path, float size, const ImFontConfig* config = NULL)
+{
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+	if (!file->Open(path, FileAccess::Sequential))
+		return NULL;
+
+	ImFontConfig fontConfig = config ? *config : ImFontConfig();
+	fontConfig.FontDataOwnedByAtlas = false;
+	if (fontConfig.Name[0] == '\0')
+	{
+		const char* name = strrchr(path, '/');
+		ImFormatString(fontConfig.Name, IM_ARRAYSIZE(fontConfig.Name), "%s, %.0fpx", name ? name + 1 : path, size);
+	}
+
+	// stb_truetype only reads the data, the cast drops nothing that is written to
+	ImFont* font = atlas->AddFontFromMemoryTTF((void*)file->GetData(), (int)file->GetSize(), size, &fontConfig);
+	g_FontFiles.push_back(std::move(file));
+	return font;
+}
 
 
 static void SetupVulkan(const char** extensions, uint32_t extensions_count)
@@ -39,6 +92,28 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 
 	// Create Vulkan Instance
 	{
+		// Memory budget queries go through vkGetPhysicalDeviceMemoryProperties2KHR, a 1.0 instance needs the extension for it
+		bool has_properties2 = false;
+		std::vector<const char*> instance_extensions(extensions, extensions + extensions_count);
+		{
+			uint32_t count = 0;
+			vkEnumerateInstanceExtensionProperties(NULL, &count, NULL);
+			std::vector<VkExtensionProperties> available(count);
+			vkEnumerateInstanceExtensionProperties(NULL, &count, available.data());
+			for (const VkExtensionProperties& extension : available)
+			{
+				if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+				{
+					instance_extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+					has_properties2 = true;
+					break;
+				}
+			}
+		}
+		extensions = instance_extensions.data();
+		extensions_count = (uint32_t)instance_extensions.size();
+		g_HasMemoryBudget = has_properties2;
+
 		VkInstanceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 		create_info.enabledExtensionCount = extensions_count;
@@ -123,29 +198,109 @@ static void SetupVulkan(const char** extensions, uint32_t extensions_count)
 				g_QueueFamily = i;
 				break;
 			}
-		free(queues);
 		IM_ASSERT(g_QueueFamily != (uint32_t)-1);
+
+		// Texture streaming copies run on a DMA queue where there is one, so they never queue up in
+		// front of UI rendering. Only families that copy at texel granularity, UploadManager copies
+		// arbitrary mip sizes.
+		g_TransferQueueFamily = g_QueueFamily;
+		g_ComputeQueueFamily = g_QueueFamily;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			VkQueueFlags flags = queues[i].queueFlags;
+			if (flags & VK_QUEUE_GRAPHICS_BIT)
+				continue;
+
+			const VkExtent3D& granularity = queues[i].minImageTransferGranularity;
+			bool texelGranularity = granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
+			if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT) && texelGranularity && g_TransferQueueFamily == g_QueueFamily)
+				g_TransferQueueFamily = i;
+			if ((flags & VK_QUEUE_COMPUTE_BIT) && g_ComputeQueueFamily == g_QueueFamily)
+				g_ComputeQueueFamily = i;
+		}
+		free(queues);
 	}
 
 	// Create Logical Device (with 1 queue)
 	{
-		int device_extension_count = 1;
-		const char* device_extensions[] = { "VK_KHR_swapchain" };
+		std::vector<const char*> device_extensions = { "VK_KHR_swapchain" };
+		// Both optional extensions need VK_KHR_get_physical_device_properties2 on the instance, which
+		// g_HasMemoryBudget stands for up to here
+		bool has_properties2 = g_HasMemoryBudget;
+		g_HasMemoryBudget = false;
+		g_HasTimelineSemaphore = false;
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = {};
+		timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		if (has_properties2)
+		{
+			uint32_t count = 0;
+			vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, NULL, &count, NULL);
+			std::vector<VkExtensionProperties> available(count);
+			vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, NULL, &count, available.data());
+			for (const VkExtensionProperties& extension : available)
+			{
+				// Real per heap usage/budget numbers for texture residency, heap sizes are the fallback
+				if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+				{
+					device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+					g_HasMemoryBudget = true;
+				}
+				// GPU completion tracking with a single semaphore, pooled fences are the fallback
+				if (strcmp(extension.extensionName, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0)
+				{
+					auto vkGetPhysicalDeviceFeatures2KHR = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(g_Instance, "vkGetPhysicalDeviceFeatures2KHR");
+					VkPhysicalDeviceFeatures2KHR features2 = {};
+					features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+					features2.pNext = &timeline_features;
+					if (vkGetPhysicalDeviceFeatures2KHR)
+						vkGetPhysicalDeviceFeatures2KHR(g_PhysicalDevice, &features2);
+					if (timeline_features.timelineSemaphore)
+					{
+						device_extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+						g_HasTimelineSemaphore = true;
+					}
+				}
+			}
+		}
+		// One queue per distinct family: graphics, then transfer and compute where they have their own
 		const float queue_priority[] = { 1.0f };
-		VkDeviceQueueCreateInfo queue_info[1] = {};
-		queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queue_info[0].queueFamilyIndex = g_QueueFamily;
-		queue_info[0].queueCount = 1;
-		queue_info[0].pQueuePriorities = queue_priority;
+		const uint32_t families[] = { g_QueueFamily, g_TransferQueueFamily, g_ComputeQueueFamily };
+		VkDeviceQueueCreateInfo queue_info[3] = {};
+		uint32_t queue_info_count = 0;
+		for (uint32_t family : families)
+		{
+			bool created = false;
+			for (uint32_t i = 0; i < queue_info_count; i++)
+				created |= queue_info[i].queueFamilyIndex == family;
+			if (created)
+				continue;
+
+			VkDeviceQueueCreateInfo& info = queue_info[queue_info_count++];
+			info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+			info.queueFamilyIndex = family;
+			info.queueCount = 1;
+			info.pQueuePriorities = queue_priority;
+		}
+		// BC formats and anisotropic filtering are optional, only turn them on where the device has them
+		VkPhysicalDeviceFeatures supported_features = {};
+		vkGetPhysicalDeviceFeatures(g_PhysicalDevice, &supported_features);
+		VkPhysicalDeviceFeatures enabled_features = {};
+		enabled_features.textureCompressionBC = supported_features.textureCompressionBC;
+		enabled_features.samplerAnisotropy = supported_features.samplerAnisotropy;
 		VkDeviceCreateInfo create_info = {};
 		create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		create_info.queueCreateInfoCount = sizeof(queue_info) / sizeof(queue_info[0]);
+		create_info.queueCreateInfoCount = queue_info_count;
 		create_info.pQueueCreateInfos = queue_info;
-		create_info.enabledExtensionCount = device_extension_count;
-		create_info.ppEnabledExtensionNames = device_extensions;
+		create_info.enabledExtensionCount = (uint32_t)device_extensions.size();
+		create_info.ppEnabledExtensionNames = device_extensions.data();
+		create_info.pEnabledFeatures = &enabled_features;
+		if (g_HasTimelineSemaphore)
+			create_info.pNext = &timeline_features;
 		err = vkCreateDevice(g_PhysicalDevice, &create_info, g_Allocator, &g_Device);
 		check_vk_result(err);
 		vkGetDeviceQueue(g_Device, g_QueueFamily, 0, &g_Queue);
+		vkGetDeviceQueue(g_Device, g_TransferQueueFamily, 0, &g_TransferQueue);
+		vkGetDeviceQueue(g_Device, g_ComputeQueueFamily, 0, &g_ComputeQueue);
 	}
 
 	// Create Descriptor Pool
@@ -228,37 +383,33 @@ static void CleanupVulkanWindow()
 	ImGui_ImplVulkanH_DestroyWindow(g_Instance, g_Device, &g_MainWindowData, g_Allocator);
 }
 
-static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
+// Records and submits the frame into FrameContext's current slot, false when nothing was submitted
+static bool FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 {
 	VkResult err;
 
-	VkSemaphore image_acquired_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].ImageAcquiredSemaphore;
-	VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].RenderCompleteSemaphore;
+	// The slot's fence was already waited for in FrameContext::BeginFrame, before the CPU built this frame
+	VkSemaphore image_acquired_semaphore = FrameContext::GetImageAcquiredSemaphore();
 	err = vkAcquireNextImageKHR(g_Device, wd->Swapchain, UINT64_MAX, image_acquired_semaphore, VK_NULL_HANDLE, &wd->FrameIndex);
-	if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
+	if (err == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		g_SwapChainRebuild = true;
-		return;
+		return false;
 	}
-	check_vk_result(err);
+	// Suboptimal still acquired the image and signals the semaphore, render and present it before rebuilding
+	if (err == VK_SUBOPTIMAL_KHR)
+		g_SwapChainRebuild = true;
+	else
+		check_vk_result(err);
+
+	FrameContext::WaitForImage(wd->FrameIndex);
 
 	ImGui_ImplVulkanH_Frame* fd = &wd->Frames[wd->FrameIndex];
-	{
-		err = vkWaitForFences(g_Device, 1, &fd->Fence, VK_TRUE, UINT64_MAX);    // wait indefinitely instead of periodically checking
-		check_vk_result(err);
+	VkCommandBuffer command_buffer = FrameContext::BeginCommandBuffer();
+
+	// Streaming texture copies ride along in the frame, outside the render pass
+	Texture::RecordStreamingCopies(command_buffer, FrameContext::GetFence());
 
-		err = vkResetFences(g_Device, 1, &fd->Fence);
-		check_vk_result(err);
-	}
-	{
-		err = vkResetCommandPool(g_Device, fd->CommandPool, 0);
-		check_vk_result(err);
-		VkCommandBufferBeginInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		err = vkBeginCommandBuffer(fd->CommandBuffer, &info);
-		check_vk_result(err);
-	}
 	{
 		VkRenderPassBeginInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -268,38 +419,21 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 		info.renderArea.extent.height = wd->Height;
 		info.clearValueCount = 1;
 		info.pClearValues = &wd->ClearValue;
-		vkCmdBeginRenderPass(fd->CommandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(command_buffer, &info, VK_SUBPASS_CONTENTS_INLINE);
 	}
 
 	// Record dear imgui primitives into command buffer
-	ImGui_ImplVulkan_RenderDrawData(draw_data, fd->CommandBuffer);
+	ImGui_ImplVulkan_RenderDrawData(draw_data, command_buffer);
 
 	// Submit command buffer
-	vkCmdEndRenderPass(fd->CommandBuffer);
-	{
-		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		VkSubmitInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		info.waitSemaphoreCount = 1;
-		info.pWaitSemaphores = &image_acquired_semaphore;
-		info.pWaitDstStageMask = &wait_stage;
-		info.commandBufferCount = 1;
-		info.pCommandBuffers = &fd->CommandBuffer;
-		info.signalSemaphoreCount = 1;
-		info.pSignalSemaphores = &render_complete_semaphore;
-
-		err = vkEndCommandBuffer(fd->CommandBuffer);
-		check_vk_result(err);
-		err = vkQueueSubmit(g_Queue, 1, &info, fd->Fence);
-		check_vk_result(err);
-	}
+	vkCmdEndRenderPass(command_buffer);
+	FrameContext::Submit(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	return true;
 }
 
 static void FramePresent(ImGui_ImplVulkanH_Window* wd)
 {
-	if (g_SwapChainRebuild)
-		return;
-	VkSemaphore render_complete_semaphore = wd->FrameSemaphores[wd->SemaphoreIndex].RenderCompleteSemaphore;
+	VkSemaphore render_complete_semaphore = FrameContext::GetRenderCompleteSemaphore();
 	VkPresentInfoKHR info = {};
 	info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	info.waitSemaphoreCount = 1;
@@ -314,7 +448,6 @@ static void FramePresent(ImGui_ImplVulkanH_Window* wd)
 		return;
 	}
 	check_vk_result(err);
-	wd->SemaphoreIndex = (wd->SemaphoreIndex + 1) % wd->ImageCount; // Now we can use the next set of semaphores
 }
 
 static void glfw_error_callback(int error, const char* description)
@@ -351,57 +484,59 @@ VkDevice AstranEditorUI::GetDevice()
 	return g_Device;
 }
 
-VkCommandBuffer AstranEditorUI::GetCommandBuffer(bool begin)
+VkQueue AstranEditorUI::GetQueue()
 {
-	ImGui_ImplVulkanH_Window* wd = &g_MainWindowData;
-
-	// Use any command queue
-	VkCommandPool command_pool = wd->Frames[wd->FrameIndex].CommandPool;
+	return g_Queue;
+}
 
-	VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
-	cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cmdBufAllocateInfo.commandPool = command_pool;
-	cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cmdBufAllocateInfo.commandBufferCount = 1;
+uint32_t AstranEditorUI::GetQueueFamily()
+{
+	return g_QueueFamily;
+}
 
-	VkCommandBuffer command_buffer;
-	auto err = vkAllocateCommandBuffers(g_Device, &cmdBufAllocateInfo, &command_buffer);
+VkQueue AstranEditorUI::GetTransferQueue()
+{
+	return g_TransferQueue;
+}
 
-	VkCommandBufferBeginInfo begin_info = {};
-	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	err = vkBeginCommandBuffer(command_buffer, &begin_info);
-	check_vk_result(err);
+uint32_t AstranEditorUI::GetTransferQueueFamily()
+{
+	return g_TransferQueueFamily;
+}
 
-	return command_buffer;
+bool AstranEditorUI::HasDedicatedTransferQueue()
+{
+	return g_TransferQueueFamily != g_QueueFamily;
 }
 
-void AstranEditorUI::FlushCommandBuffer(VkCommandBuffer commandBuffer)
+VkQueue AstranEditorUI::GetComputeQueue()
 {
-	const uint64_t DEFAULT_FENCE_TIMEOUT = 100000000000;
+	return g_ComputeQueue;
+}
 
-	VkSubmitInfo end_info = {};
-	end_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	end_info.commandBufferCount = 1;
-	end_info.pCommandBuffers = &commandBuffer;
-	auto err = vkEndCommandBuffer(commandBuffer);
-	check_vk_result(err);
+uint32_t AstranEditorUI::GetComputeQueueFamily()
+{
+	return g_ComputeQueueFamily;
+}
 
-	// Create fence to ensure that the command buffer has finished executing
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = 0;
-	VkFence fence;
-	err = vkCreateFence(g_Device, &fenceCreateInfo, nullptr, &fence);
-	check_vk_result(err);
+VkDescriptorPool AstranEditorUI::GetDescriptorPool()
+{
+	return g_DescriptorPool;
+}
 
-	err = vkQueueSubmit(g_Queue, 1, &end_info, fence);
-	check_vk_result(err);
+uint32_t AstranEditorUI::GetFramesInFlight()
+{
+	return FrameContext::GetFramesInFlight();
+}
 
-	err = vkWaitForFences(g_Device, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT);
-	check_vk_result(err);
+bool AstranEditorUI::HasMemoryBudget()
+{
+	return g_HasMemoryBudget;
+}
 
-	vkDestroyFence(g_Device, fence, nullptr);
+bool AstranEditorUI::HasTimelineSemaphore()
+{
+	return g_HasTimelineSemaphore;
 }
 
 
@@ -908,6 +1043,72 @@ namespace
 
 	}
 
+	// Set by the stats window, Defragment has to run outside the frame
+	static bool g_DefragmentRequested = false;
+
+	// Filled in by a JobSystem job, the benchmark is too slow for the render thread
+	static std::mutex g_PixelKernelBenchmarkMutex;
+	static std::vector<PixelKernels::BenchmarkResult> g_PixelKernelBenchmark;
+	static bool g_PixelKernelBenchmarkRunning = false;
+
+	// Per frame renderer counters, nothing is logged every frame
+	void RendererStatsWindow(const ImGuiID& statsWindowDockID)
+	{
+		ImGui::SetNextWindowDockID(statsWindowDockID, ImGuiCond_FirstUseEver);
+		if (!ImGui::Begin("Renderer Stats"))
+		{
+			ImGui::End();
+			return;
+		}
+
+		const UploadStats& uploads = UploadManager::GetLastFrameStats();
+		ImGui::Text("Uploads: %u (%.2f MiB), %u submits", uploads.Uploads, uploads.Bytes / (1024.0 * 1024.0), uploads.Submits);
+		ImGui::Text("Staging in use: %.2f MiB", UploadManager::GetStagingBytesInUse() / (1024.0 * 1024.0));
+
+		ResidencyStats residency = TextureResidency::GetStats();
+		ImGui::Text("Textures: %.1f of %.1f MiB budget%s, %u tracked, %u evicted (%llu evictions, %llu restreams)",
+			residency.Usage / (1024.0 * 1024.0), residency.Budget / (1024.0 * 1024.0), residency.FromMemoryBudget ? "" : " (heap size)",
+			residency.Tracked, residency.Evicted, (unsigned long long)residency.TotalEvictions, (unsigned long long)residency.TotalRestreams);
+
+		DeviceMemoryStats memory = DeviceMemoryAllocator::GetStats();
+		ImGui::Text("Device memory: %.1f of %.1f MiB used, %u blocks, %u allocations, fragmentation %.2f",
+			memory.UsedBytes / (1024.0 * 1024.0), memory.BlockBytes / (1024.0 * 1024.0), memory.BlockCount, memory.AllocationCount, memory.Fragmentation);
+		if (ImGui::Button("Defragment"))
+			g_DefragmentRequested = true;
+		ImGui::SameLine();
+		if (ImGui::Button("Log memory"))
+			DeviceMemoryAllocator::LogStats();
+		DefragmentationResult defragmentation = DeviceMemoryAllocator::GetLastDefragmentation();
+		ImGui::SameLine();
+		ImGui::Text("last: %u moves, %.1f MiB moved, %u blocks freed", defragmentation.Moves, defragmentation.BytesMoved / (1024.0 * 1024.0), defragmentation.BlocksFreed);
+
+		{
+			std::lock_guard<std::mutex> lock(g_PixelKernelBenchmarkMutex);
+			ImGui::Text("Pixel kernels: %s%s", PixelKernels::GetInstructionSetName(PixelKernels::GetInstructionSet()), PixelKernels::HasHardwareHalf() ? ", hardware half" : "");
+			ImGui::SameLine();
+			if (g_PixelKernelBenchmarkRunning)
+				ImGui::TextUnformatted("(benchmarking...)");
+			else if (ImGui::Button("Benchmark"))
+			{
+				g_PixelKernelBenchmarkRunning = true;
+				JobSystem::Submit([]()
+				{
+					std::vector<PixelKernels::BenchmarkResult> results = PixelKernels::Benchmark();
+					std::lock_guard<std::mutex> lock(g_PixelKernelBenchmarkMutex);
+					g_PixelKernelBenchmark = std::move(results);
+					g_PixelKernelBenchmarkRunning = false;
+				});
+			}
+			for (const PixelKernels::BenchmarkResult& result : g_PixelKernelBenchmark)
+			{
+				ImGui::Text("  %s: scalar %.0f MP/s, %s %.0f MP/s (%.1fx)", result.Kernel, result.ScalarMPixels,
+					PixelKernels::GetInstructionSetName(result.Simd), result.SimdMPixels, result.SimdMPixels / std::max(result.ScalarMPixels, 1e-9));
+			}
+		}
+
+		ImGui::End();
+	}
+
 }
 
 int AstranEditorUI::StartupModule()
@@ -951,6 +1152,8 @@ int AstranEditorUI::StartupModule()
 	uint32_t extensions_count = 0;
 	const char** extensions = glfwGetRequiredInstanceExtensions(&extensions_count);
 	SetupVulkan(extensions, extensions_count);
+	GpuCompletionTracker::Initialize();
+	PipelineCache::Initialize();
 	// Create Window Surface
 	VkSurfaceKHR surface;
 	VkResult err = glfwCreateWindowSurface(g_Instance, window, g_Allocator, &surface);
@@ -989,11 +1192,12 @@ int AstranEditorUI::StartupModule()
 	init_info.Device = g_Device;
 	init_info.QueueFamily = g_QueueFamily;
 	init_info.Queue = g_Queue;
-	init_info.PipelineCache = g_PipelineCache;
+	init_info.PipelineCache = PipelineCache::Get();
 	init_info.DescriptorPool = g_DescriptorPool;
 	init_info.Subpass = 0;
 	init_info.MinImageCount = g_MinImageCount;
-	init_info.ImageCount = g_MinImageCount;// wd->ImageCount;
+	// The backend cycles its vertex buffers over ImageCount frames, none may still be in flight
+	init_info.ImageCount = std::max((uint32_t)g_MinImageCount, g_FramesInFlight);
 	init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 	init_info.Allocator = g_Allocator;
 	init_info.CheckVkResultFn = check_vk_result;
@@ -1007,14 +1211,14 @@ int AstranEditorUI::StartupModule()
 	// - Read 'docs/FONTS.md' for more instructions and details.
 	// - Remember that in C/C++ if you want to include a backslash \ in a string literal you need to write a double backslash \\ !
 	//io.Fonts->AddFontDefault();
-	RobotoMedium = io.Fonts->AddFontFromFileTTF("../ThirdParty/imgui/misc/fonts/Roboto-Medium.ttf", 20.0f);
+	RobotoMedium = AddFontFromMappedFile(io.Fonts, "../ThirdParty/imgui/misc/fonts/Roboto-Medium.ttf", 20.0f);
 	//io.Fonts->AddFontFromFileTTF("../../misc/fonts/Cousine-Regular.ttf", 15.0f);
 
 	ImFontConfig config;
 	//config.OversampleH = 2;
 	//config.OversampleV = 1;
 	//config.GlyphExtraSpacing.x = 5.0f;
-	DroidSans = io.Fonts->AddFontFromFileTTF("../ThirdParty/imgui/misc/fonts/DroidSans.ttf", 18.0f, &config);
+	DroidSans = AddFontFromMappedFile(io.Fonts, "../ThirdParty/imgui/misc/fonts/DroidSans.ttf", 18.0f, &config);
 	//io.Fonts->AddFontFromFileTTF("../../misc/fonts/ProggyTiny.ttf", 10.0f);
 	//ImFont* font = io.Fonts->AddFontFromFileTTF("c:\\Windows\\Fonts\\ArialUni.ttf", 18.0f, NULL, io.Fonts->GetGlyphRangesJapanese());
 	//IM_ASSERT(font != NULL);
@@ -1041,16 +1245,24 @@ int AstranEditorUI::StartupModule()
 		end_info.pCommandBuffers = &command_buffer;
 		err = vkEndCommandBuffer(command_buffer);
 		check_vk_result(err);
-		err = vkQueueSubmit(g_Queue, 1, &end_info, VK_NULL_HANDLE);
-		check_vk_result(err);
 
-		err = vkDeviceWaitIdle(g_Device);
-		check_vk_result(err);
-		ImGui_ImplVulkan_DestroyFontUploadObjects();
+		// The staging buffer goes once the copy is done, the first frame is queued behind it anyway
+		uint64_t uploaded = GpuCompletionTracker::Submit(g_Queue, end_info);
+		GpuCompletionTracker::OnComplete(uploaded, []() { ImGui_ImplVulkan_DestroyFontUploadObjects(); });
 	}
 
 	std::cout << "Current path is " << std::filesystem::current_path() << '\n';
 
+	FrameContext::Initialize(g_FramesInFlight);
+	OneShotSubmitter::Initialize();
+	JobSystem::Initialize();
+	DeviceMemoryAllocator::Initialize();
+	UploadManager::Initialize();
+	TextureLoader::Initialize();
+	TextureResidency::Initialize();
+	ThumbnailService::Initialize();
+	m_ImageViewer = new ImageViewerPanel();
+
 	IconLoad();
 
 	return 0;
@@ -1065,10 +1277,9 @@ void AstranEditorUI::IconLoad()
 
 	std::string path = "../Contents/Editor/Icons/";
 	
-	appIcon = new Texture(path + "UE4.png", Texture::TextureSourceType::RASTER, 1, false);
-	GameObjectOn = new Texture(path + "GameObject On@64.png", Texture::TextureSourceType::RASTER, 1, false);
-	TransformIcon = new Texture(path + "d_Transform@32.png", Texture::TextureSourceType::RASTER, 1, false);
-	ThreeDotButtonIcon = new Texture(path + "_Menu@2x.png", Texture::TextureSourceType::RASTER, 1, false);
+	// One shared page instead of a texture and descriptor per icon, so icon draws batch
+	iconAtlas = std::make_shared<TextureAtlas>();
+	iconAtlas->AddDirectoryAsync(path);
 
 	/*
 	appIcon = new Texture("Contents/Editor/Icons/UE4.png", Texture::TextureSourceType::RASTER, 1, false);
@@ -1076,33 +1287,41 @@ void AstranEditorUI::IconLoad()
 	TransformIcon = new Texture("Contents/Editor/Icons/d_Transform@32.png", Texture::TextureSourceType::RASTER, 1, false);
 	ThreeDotButtonIcon = new Texture("Contents/Editor/Icons/_Menu@2x.png", Texture::TextureSourceType::RASTER, 1, false);
 	*/
-
-	saveButton = appIcon;
-
-	auto testIcon = TransformIcon;
-
-	std::cout << (ImTextureID)testIcon->GetDescriptorSet() << ", " << testIcon->m_height << ", " << testIcon->m_width << "\n";
 }
 
 void AstranEditorUI::IconDestroy()
 {
-	//delete saveButton;
-	delete appIcon;
-	delete GameObjectOn;
-	delete TransformIcon;
-	delete ThreeDotButtonIcon;
+	iconAtlas.reset();
 }
 
 void AstranEditorUI::ShutdownModule()
 {
-	IconDestroy();
+	// Stop decoding first so no job touches the loader while it tears down
+	JobSystem::Shutdown();
 
 	// Cleanup
 	VkResult err = vkDeviceWaitIdle(g_Device);
 	check_vk_result(err);
+
+	IconDestroy();
+	delete m_ImageViewer;
+	m_ImageViewer = nullptr;
+	ThumbnailService::Shutdown();
+	TextureRegistry::Clear();
+	TextureResidency::Shutdown();
+	TextureLoader::Shutdown();
+	UploadManager::Shutdown();
+	OneShotSubmitter::Shutdown();
+	// Last callbacks may still release memory
+	GpuCompletionTracker::Shutdown();
+	DeviceMemoryAllocator::Shutdown();
+	SamplerCache::Shutdown();
+	FrameContext::Shutdown();
+	PipelineCache::Shutdown();
 	ImGui_ImplVulkan_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
+	g_FontFiles.clear();
 
 	CleanupVulkanWindow();
 	CleanupVulkan();
@@ -1441,6 +1660,9 @@ void AstranEditorUI::Editor()
 	static ImGuiID dock_id_left = ImGui::DockBuilderSplitNode(mainDockedSpaceID, ImGuiDir_Left, 0.3f, nullptr, &dock_id_right);
 
 	InspectorWindow(dock_id_left);
+	RendererStatsWindow(dock_id_left);
+	m_ImageViewer->Draw(dock_id_right);
+	m_ImageViewer->DrawBrowser(dock_id_right);
 	
 	MainDockSpaceEnd();
 
@@ -2129,13 +2351,13 @@ void AstranEditorUI::JayanamMeshEditor()
 	ImGui::PopStyleVar(2);
 
 	ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, ImVec2(0, 0));
-	ImGui::Image((void*)(intptr_t)saveButton->GetDescriptorSet(), ImVec2(saveButton->m_width, saveButton->m_height));
+	iconAtlas->Image("UE4", iconAtlas->GetSize("UE4"));
 	ImGui::SameLine();
 
 	ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.0f, 0.0f, 0.0f, 0.00f));
 	ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(0.0f, 0.0f, 0.0f, 1.0f));
 	ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(0.0f, 0.0f, 0.0f, 1.0f));
-	ImGui::ImageButton((void*)(intptr_t)saveButton->GetDescriptorSet(), ImVec2(saveButton->m_width, saveButton->m_height));
+	iconAtlas->ImageButton("UE4", iconAtlas->GetSize("UE4"));
 	ImGui::PopStyleColor(3);
 	ImGui::PopStyleVar();
 	/*
@@ -2321,6 +2543,23 @@ void AstranEditorUI::ImGuiRender()
 			}
 		}
 
+		// The only CPU/GPU sync point of the frame: wait until the frame that last used this slot
+		// has finished on the GPU, everything after it overlaps with the frames still in flight
+		FrameContext::BeginFrame();
+		// Completion callbacks of whatever finished meanwhile
+		GpuCompletionTracker::Poll();
+		PipelineCache::Update();
+		if (g_DefragmentRequested)
+		{
+			DeviceMemoryAllocator::Defragment();
+			g_DefragmentRequested = false;
+		}
+
+		// Hand finished decodes to the GPU and swap in textures whose upload completed
+		TextureLoader::Update();
+		iconAtlas->Update();
+		ThumbnailService::Update();
+
 		// Start the Dear ImGui frame
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -2347,13 +2586,19 @@ void AstranEditorUI::ImGuiRender()
 		// Rendering
 		ImGui::Render();
 		ImDrawData* main_draw_data = ImGui::GetDrawData();
+		// Sees what this frame draws, evicts or restreams before anything is recorded
+		TextureResidency::Update();
 		const bool main_is_minimized = (main_draw_data->DisplaySize.x <= 0.0f || main_draw_data->DisplaySize.y <= 0.0f);
 		wd->ClearValue.color.float32[0] = clear_color.x * clear_color.w;
 		wd->ClearValue.color.float32[1] = clear_color.y * clear_color.w;
 		wd->ClearValue.color.float32[2] = clear_color.z * clear_color.w;
 		wd->ClearValue.color.float32[3] = clear_color.w;
-		if (!main_is_minimized)
-			FrameRender(wd, main_draw_data);
+		// All texture copies queued this frame go out in a single submit ahead of the frame itself
+		Texture::FlushPendingUpdates();
+		UploadManager::SubmitFrame();
+		OneShotSubmitter::SubmitFrame();
+
+		bool main_is_rendered = !main_is_minimized && FrameRender(wd, main_draw_data);
 
 		// Update and Render additional Platform Windows
 		if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable)
@@ -2363,9 +2608,11 @@ void AstranEditorUI::ImGuiRender()
 		}
 
 		// Present Main Platform Window
-		if (!main_is_minimized)
+		if (main_is_rendered)
 			FramePresent(wd);
 
+		FrameContext::EndFrame();
+
 		prevTime = currentTime;
 	}
 }
@@ -34,6 +34,8 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debug_report(VkDebugReportFlagsEXT flags,
 #endif // IMGUI_VULKAN_DEBUG_REPORT
 
 class Texture;
+class TextureAtlas;
+class ImageViewerPanel;
 struct GLFWwindow;
 
 /*
@@ -407,11 +409,8 @@ class AstranEditorUI
 {
 	ImFont* DroidSans;
 	ImFont* RobotoMedium;
-	Texture* saveButton;
-	Texture* appIcon;
-	Texture* GameObjectOn;
-	Texture* TransformIcon;
-	Texture* ThreeDotButtonIcon;
+	// Every editor icon lives in this atlas, drawn by file stem e.g. iconAtlas->Image("UE4", size)
+	std::shared_ptr<TextureAtlas> iconAtlas;
 
 public:
 	AstranEditorUI()
@@ -457,16 +456,41 @@ public:
 	static VkPhysicalDevice GetPhysicalDevice();
 	
 	static VkDevice GetDevice();
-	
-	static VkCommandBuffer GetCommandBuffer(bool begin);
-	
-	static void FlushCommandBuffer(VkCommandBuffer commandBuffer);
+
+	static VkQueue GetQueue();
+
+	static uint32_t GetQueueFamily();
+
+	// Transfer only queue for uploads, the graphics queue when the device has no such family.
+	// Images it writes have to be released to GetQueueFamily(), see UploadManager.
+	static VkQueue GetTransferQueue();
+	static uint32_t GetTransferQueueFamily();
+	static bool HasDedicatedTransferQueue();
+
+	// Compute queue without graphics for async compute, the graphics queue when there is none
+	static VkQueue GetComputeQueue();
+	static uint32_t GetComputeQueueFamily();
+
+	// Pool ImGui allocates texture descriptor sets from, created with FREE_DESCRIPTOR_SET_BIT
+	static VkDescriptorPool GetDescriptorPool();
+
+	// Frames the swapchain can have queued at once, i.e. how many per frame resources to keep
+	static uint32_t GetFramesInFlight();
+
+	// VK_EXT_memory_budget is enabled, vkGetPhysicalDeviceMemoryProperties2KHR reports heap usage and budgets
+	static bool HasMemoryBudget();
+
+	// VK_KHR_timeline_semaphore is enabled with its timelineSemaphore feature
+	static bool HasTimelineSemaphore();
 
 private:
 	void StyleColorsDarkUE5();
 
 	std::vector<ImguiStack*> m_ImguiStacks;
 
+	// Tiled viewer for images too large to load as one texture
+	ImageViewerPanel* m_ImageViewer = nullptr;
+
 	// Our state
 	bool show_demo_window = true;
 	bool show_another_window = false;
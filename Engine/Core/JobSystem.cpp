@@ -0,0 +1,141 @@
+#include "JobSystem.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static std::vector<std::thread>            g_Workers;
+static std::deque<std::function<void()>>   g_Jobs;
+static std::mutex                          g_JobMutex;
+static std::condition_variable             g_JobCondition;
+static bool                                g_ShuttingDown = false;
+
+static void WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(g_JobMutex);
+			g_JobCondition.wait(lock, [] { return g_ShuttingDown || !g_Jobs.empty(); });
+
+			if (g_ShuttingDown)
+				return;
+
+			job = std::move(g_Jobs.front());
+			g_Jobs.pop_front();
+		}
+
+		job();
+	}
+}
+
+void JobSystem::Initialize(uint32_t workerCount)
+{
+	if (!g_Workers.empty())
+		return;
+
+	if (workerCount == 0)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	g_ShuttingDown = false;
+	g_Workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++)
+	{
+		g_Workers.emplace_back(WorkerLoop);
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_JobMutex);
+		g_ShuttingDown = true;
+		g_Jobs.clear();
+	}
+	g_JobCondition.notify_all();
+
+	for (std::thread& worker : g_Workers)
+	{
+		worker.join();
+	}
+	g_Workers.clear();
+}
+
+void JobSystem::Submit(std::function<void()> job)
+{
+	//Run inline if nobody is around to pick it up, keeps tools and early startup code working
+	if (g_Workers.empty())
+	{
+		job();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(g_JobMutex);
+		g_Jobs.push_back(std::move(job));
+	}
+	g_JobCondition.notify_one();
+}
+
+void JobSystem::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+{
+	if (count == 0)
+		return;
+
+	struct ParallelForState
+	{
+		std::atomic<uint32_t> next{ 0 };
+		std::atomic<uint32_t> done{ 0 };
+		uint32_t count = 0;
+		const std::function<void(uint32_t)>* job = nullptr;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	auto state = std::make_shared<ParallelForState>();
+	state->count = count;
+	state->job = &job;
+
+	// Helpers only touch `job` after claiming an index, and every claimed index is finished before we return
+	auto drain = [](ParallelForState& s)
+	{
+		for (uint32_t i = s.next.fetch_add(1); i < s.count; i = s.next.fetch_add(1))
+		{
+			(*s.job)(i);
+			if (s.done.fetch_add(1) + 1 == s.count)
+			{
+				std::lock_guard<std::mutex> lock(s.mutex);
+				s.finished.notify_all();
+			}
+		}
+	};
+
+	uint32_t helpers = count - 1 < GetWorkerCount() ? count - 1 : GetWorkerCount();
+	for (uint32_t i = 0; i < helpers; i++)
+	{
+		Submit([state, drain]() { drain(*state); });
+	}
+
+	drain(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&] { return state->done.load() == state->count; });
+}
+
+uint32_t JobSystem::GetWorkerCount()
+{
+	return (uint32_t)g_Workers.size();
+}
+
+bool JobSystem::IsInitialized()
+{
+	return !g_Workers.empty();
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+
+// Small fixed-size worker pool used for CPU side work that must stay off the render thread
+// (image decoding, compression, rasterization). Jobs are plain closures executed in FIFO order.
+class JobSystem
+{
+public:
+	// workerCount == 0 picks hardware_concurrency - 1 (at least 1)
+	static void Initialize(uint32_t workerCount = 0);
+	static void Shutdown();
+
+	static void Submit(std::function<void()> job);
+
+	// Runs job(i) for i in [0, count) across the workers and blocks until every index is done.
+	// The calling thread takes part in the work, so it is safe to call from inside a job.
+	static void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job);
+
+	static uint32_t GetWorkerCount();
+	static bool IsInitialized();
+};
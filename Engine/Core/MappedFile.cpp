@@ -0,0 +1,176 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Utils {
+
+#ifdef _WIN32
+	typedef BOOL(WINAPI* PrefetchVirtualMemoryFunction)(HANDLE, ULONG_PTR, PWIN32_MEMORY_RANGE_ENTRY, ULONG);
+
+	// Windows 8 and later, looked up so older systems just skip the hint
+	static PrefetchVirtualMemoryFunction GetPrefetchVirtualMemory()
+	{
+		static PrefetchVirtualMemoryFunction function = (PrefetchVirtualMemoryFunction)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+		return function;
+	}
+
+	// The cache manager's read-ahead for the file also serves the mapping's page faults
+	static DWORD GetAccessFlags(FileAccess access)
+	{
+		switch (access)
+		{
+		case FileAccess::Sequential: return FILE_FLAG_SEQUENTIAL_SCAN;
+		case FileAccess::Random: return FILE_FLAG_RANDOM_ACCESS;
+		default: return 0;
+		}
+	}
+#else
+	static int GetAdvice(FileAccess access)
+	{
+		switch (access)
+		{
+		case FileAccess::Sequential: return MADV_SEQUENTIAL;
+		case FileAccess::Random: return MADV_RANDOM;
+		default: return MADV_NORMAL;
+		}
+	}
+#endif
+
+	static void PrefetchRange(const uint8_t* data, uint64_t size)
+	{
+#ifdef _WIN32
+		PrefetchVirtualMemoryFunction prefetch = GetPrefetchVirtualMemory();
+		if (prefetch)
+		{
+			WIN32_MEMORY_RANGE_ENTRY range;
+			range.VirtualAddress = (PVOID)data;
+			range.NumberOfBytes = (SIZE_T)size;
+			prefetch(GetCurrentProcess(), 1, &range, 0);
+		}
+#else
+		// madvise wants a page aligned start
+		uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+		uintptr_t start = (uintptr_t)data / pageSize * pageSize;
+		madvise((void*)start, (size_t)((uintptr_t)data + size - start), MADV_WILLNEED);
+#endif
+	}
+
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& path, FileAccess access, bool reportMissing)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | Utils::GetAccessFlags(access), nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		DWORD error = GetLastError();
+		if (reportMissing || (error != ERROR_FILE_NOT_FOUND && error != ERROR_PATH_NOT_FOUND))
+			std::cout << "MappedFile: could not open " << path << "\n";
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		std::cout << "MappedFile: could not map " << path << "\n";
+		CloseHandle(file);
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		std::cout << "MappedFile: could not map " << path << "\n";
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_FileHandle = file;
+	m_MappingHandle = mapping;
+	m_Data = (const uint8_t*)data;
+	m_Size = (uint64_t)size.QuadPart;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		if (reportMissing || errno != ENOENT)
+			std::cout << "MappedFile: could not open " << path << "\n";
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// The mapping keeps its own reference to the file
+	void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		std::cout << "MappedFile: could not map " << path << "\n";
+		return false;
+	}
+
+	madvise(data, (size_t)info.st_size, Utils::GetAdvice(access));
+
+	m_Data = (const uint8_t*)data;
+	m_Size = (uint64_t)info.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::Prefetch(uint64_t offset, uint64_t size) const
+{
+	if (!m_Data || offset >= m_Size)
+		return;
+	Utils::PrefetchRange(m_Data + offset, std::min(size, m_Size - offset));
+}
+
+void MappedFile::Close()
+{
+	if (!m_Data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_Data);
+	CloseHandle((HANDLE)m_MappingHandle);
+	CloseHandle((HANDLE)m_FileHandle);
+	m_MappingHandle = nullptr;
+	m_FileHandle = nullptr;
+#else
+	munmap((void*)m_Data, (size_t)m_Size);
+#endif
+
+	m_Data = nullptr;
+	m_Size = 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+// How a mapping will be read, steers the OS read-ahead for its page faults
+enum class FileAccess
+{
+	Normal = 0,
+	// Front to back once (decoders, hashing), read far ahead and drop pages behind
+	Sequential,
+	// Scattered reads (tile pyramids, archives), no read-ahead beyond the touched page
+	Random
+};
+
+// Read only view of a whole file through the OS page cache. Nothing is read up front,
+// pages fault in as they are touched. Loaders hand GetData() to *_from_memory entry points
+// instead of letting libraries fopen and buffer the file themselves.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// reportMissing = false for probes (cache lookups) where a missing file is the normal case,
+	// other failures are still reported
+	bool Open(const std::string& path, FileAccess access = FileAccess::Normal, bool reportMissing = true);
+	void Close();
+
+	// Starts reading [offset, offset + size) in the background so the first touches don't block
+	void Prefetch(uint64_t offset, uint64_t size) const;
+
+	bool IsOpen() const { return m_Data != nullptr; }
+	const uint8_t* GetData() const { return m_Data; }
+	uint64_t GetSize() const { return m_Size; }
+
+private:
+	const uint8_t* m_Data = nullptr;
+	uint64_t m_Size = 0;
+
+#ifdef _WIN32
+	void* m_FileHandle = nullptr;
+	void* m_MappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,230 @@
+#include "ImageViewerPanel.h"
+#include "Renderer/TiledImage.h"
+#include "Renderer/ThumbnailService.h"
+#include "Renderer/TextureRegistry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+namespace Utils {
+
+	static const float g_MinZoom = 1.0f / 1024.0f;
+	static const float g_MaxZoom = 32.0f;
+	static const float g_WheelStep = 1.2f;
+	static const float g_ThumbnailCell = 96.0f;
+
+	static bool IsImageFile(const std::filesystem::path& path)
+	{
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+		return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp"
+			|| extension == ".psd" || extension == ".gif" || extension == ".hdr";
+	}
+
+}
+
+ImageViewerPanel::ImageViewerPanel()
+{
+}
+
+ImageViewerPanel::~ImageViewerPanel()
+{
+}
+
+void ImageViewerPanel::Open(const std::string& path)
+{
+	m_Image = TextureRegistry::LoadTiled(path);
+	snprintf(m_PathInput, sizeof(m_PathInput), "%s", path.c_str());
+	m_FitPending = true;
+}
+
+void ImageViewerPanel::Close()
+{
+	m_Image.reset();
+}
+
+void ImageViewerPanel::FitToView(const ImVec2& viewSize)
+{
+	float width = (float)m_Image->GetWidth();
+	float height = (float)m_Image->GetHeight();
+	m_Zoom = std::min(std::max(std::min(viewSize.x / width, viewSize.y / height), Utils::g_MinZoom), Utils::g_MaxZoom);
+	m_Offset = ImVec2((viewSize.x - width * m_Zoom) * 0.5f, (viewSize.y - height * m_Zoom) * 0.5f);
+}
+
+void ImageViewerPanel::ZoomAbout(const ImVec2& pivot, float zoom)
+{
+	// Keeps the image pixel under pivot where it is
+	zoom = std::min(std::max(zoom, Utils::g_MinZoom), Utils::g_MaxZoom);
+	float ratio = zoom / m_Zoom;
+	m_Offset.x = pivot.x - (pivot.x - m_Offset.x) * ratio;
+	m_Offset.y = pivot.y - (pivot.y - m_Offset.y) * ratio;
+	m_Zoom = zoom;
+}
+
+void ImageViewerPanel::Draw(const ImGuiID& dockID)
+{
+	ImGui::SetNextWindowDockID(dockID, ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Image Viewer"))
+	{
+		ImGui::End();
+		return;
+	}
+
+	bool open = ImGui::InputText("##Path", m_PathInput, sizeof(m_PathInput), ImGuiInputTextFlags_EnterReturnsTrue);
+	ImGui::SameLine();
+	open |= ImGui::Button("Open");
+	if (open && m_PathInput[0])
+	{
+		Open(m_PathInput);
+	}
+
+	bool ready = m_Image && m_Image->IsReady();
+	ImVec2 canvasSize = ImGui::GetContentRegionAvail();
+	if (ready)
+	{
+		ImGui::SameLine();
+		if (ImGui::Button("Fit"))
+			m_FitPending = true;
+		ImGui::SameLine();
+		if (ImGui::Button("1:1"))
+			ZoomAbout(ImVec2(canvasSize.x * 0.5f, canvasSize.y * 0.5f), 1.0f);
+
+		const TiledImageStats& stats = m_Image->GetStats();
+		ImGui::Text("%ux%u  %.1f%%  level %u/%u  tiles %u visible, %u/%u resident, %u loading",
+			m_Image->GetWidth(), m_Image->GetHeight(), m_Zoom * 100.0f, stats.Level, m_Image->GetLevelCount() - 1,
+			stats.VisibleTiles, stats.ResidentTiles, stats.CacheSlots, stats.PendingTiles);
+	}
+	else if (m_Image && m_Image->HasFailed())
+	{
+		ImGui::Text("Could not open %s", m_Image->GetPath().c_str());
+	}
+	else if (m_Image)
+	{
+		ImGui::Text("Building tiles for %s...", m_Image->GetPath().c_str());
+	}
+
+	ImVec2 canvasMin = ImGui::GetCursorScreenPos();
+	canvasSize = ImGui::GetContentRegionAvail();
+	canvasSize.x = std::max(canvasSize.x, 1.0f);
+	canvasSize.y = std::max(canvasSize.y, 1.0f);
+	ImVec2 canvasMax = ImVec2(canvasMin.x + canvasSize.x, canvasMin.y + canvasSize.y);
+
+	ImGui::InvisibleButton("##Canvas", canvasSize, ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonMiddle);
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(canvasMin, canvasMax, IM_COL32(20, 20, 22, 255));
+
+	if (m_Image)
+	{
+		m_Image->Update();
+	}
+
+	if (ready)
+	{
+		if (m_FitPending)
+		{
+			FitToView(canvasSize);
+			m_FitPending = false;
+		}
+
+		ImGuiIO& io = ImGui::GetIO();
+		if (ImGui::IsItemActive() && (ImGui::IsMouseDragging(ImGuiMouseButton_Left, 0.0f) || ImGui::IsMouseDragging(ImGuiMouseButton_Middle, 0.0f)))
+		{
+			m_Offset.x += io.MouseDelta.x;
+			m_Offset.y += io.MouseDelta.y;
+		}
+		if (ImGui::IsItemHovered() && io.MouseWheel != 0.0f)
+		{
+			ImVec2 pivot = ImVec2(io.MousePos.x - canvasMin.x, io.MousePos.y - canvasMin.y);
+			ZoomAbout(pivot, m_Zoom * std::pow(Utils::g_WheelStep, io.MouseWheel));
+		}
+
+		ImVec2 origin = ImVec2(canvasMin.x + m_Offset.x, canvasMin.y + m_Offset.y);
+		drawList->PushClipRect(canvasMin, canvasMax, true);
+		m_Image->Draw(drawList, origin, m_Zoom, canvasMin, canvasMax);
+		drawList->PopClipRect();
+	}
+
+	ImGui::End();
+}
+
+void ImageViewerPanel::ListFolder(const std::string& folder)
+{
+	m_FolderImages.clear();
+
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(folder, error))
+	{
+		if (entry.is_regular_file() && Utils::IsImageFile(entry.path()))
+			m_FolderImages.push_back(entry.path().string());
+	}
+	std::sort(m_FolderImages.begin(), m_FolderImages.end());
+
+	if (error)
+	{
+		std::cout << "ImageViewerPanel: could not read " << folder << ": " << error.message() << "\n";
+	}
+}
+
+void ImageViewerPanel::DrawBrowser(const ImGuiID& dockID)
+{
+	ImGui::SetNextWindowDockID(dockID, ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Image Browser"))
+	{
+		ImGui::End();
+		return;
+	}
+
+	bool list = ImGui::InputText("##Folder", m_FolderInput, sizeof(m_FolderInput), ImGuiInputTextFlags_EnterReturnsTrue);
+	ImGui::SameLine();
+	list |= ImGui::Button("List");
+	if (list && m_FolderInput[0])
+	{
+		ListFolder(m_FolderInput);
+	}
+
+	ThumbnailStats stats = ThumbnailService::GetStats();
+	ImGui::Text("%u images  thumbnails %u/%u resident, %u loading, %u queued",
+		(uint32_t)m_FolderImages.size(), stats.Resident, stats.Slots, stats.InFlight, stats.Queued);
+
+	ImGui::BeginChild("##Thumbnails");
+	float spacing = ImGui::GetStyle().ItemSpacing.x;
+	int columns = std::max(1, (int)((ImGui::GetContentRegionAvail().x + spacing) / (Utils::g_ThumbnailCell + spacing)));
+	int rows = ((int)m_FolderImages.size() + columns - 1) / columns;
+
+	// Only the visible rows ask for thumbnails, the service forgets the rest as they scroll by
+	ImGuiListClipper clipper;
+	clipper.Begin(rows, Utils::g_ThumbnailCell + ImGui::GetStyle().ItemSpacing.y);
+	while (clipper.Step())
+	{
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+		{
+			for (int column = 0; column < columns; column++)
+			{
+				size_t index = (size_t)row * columns + column;
+				if (index >= m_FolderImages.size())
+					break;
+				if (column > 0)
+					ImGui::SameLine();
+
+				const std::string& path = m_FolderImages[index];
+				ImGui::PushID((int)index);
+				ImVec2 cell = ImVec2(Utils::g_ThumbnailCell, Utils::g_ThumbnailCell);
+				ThumbnailService::Image(path, cell);
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::SetTooltip("%s", path.c_str());
+					if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+						Open(path);
+				}
+				ImGui::PopID();
+			}
+		}
+	}
+	clipper.End();
+	ImGui::EndChild();
+
+	ImGui::End();
+}
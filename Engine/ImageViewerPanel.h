@@ -0,0 +1,39 @@
+#pragma once
+#include "imgui.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class TiledImage;
+
+// Dockable pan/zoom view of one TiledImage. Drag to pan, mouse wheel zooms about the cursor.
+// DrawBrowser lists a folder as a thumbnail grid, double clicking one opens it in the viewer.
+class ImageViewerPanel
+{
+public:
+	ImageViewerPanel();
+	~ImageViewerPanel();
+
+	void Open(const std::string& path);
+	void Close();
+
+	void Draw(const ImGuiID& dockID);
+	void DrawBrowser(const ImGuiID& dockID);
+
+private:
+	void FitToView(const ImVec2& viewSize);
+	void ZoomAbout(const ImVec2& pivot, float zoom);
+	void ListFolder(const std::string& folder);
+
+	// Shared through the TextureRegistry, reopening an open path keeps its resident tiles
+	std::shared_ptr<TiledImage> m_Image;
+	char m_PathInput[512] = {};
+
+	// Screen offset of the image's top left corner from the canvas corner, and screen pixels per image pixel
+	ImVec2 m_Offset = ImVec2(0, 0);
+	float m_Zoom = 1.0f;
+	bool m_FitPending = false;
+
+	char m_FolderInput[512] = {};
+	std::vector<std::string> m_FolderImages;
+};
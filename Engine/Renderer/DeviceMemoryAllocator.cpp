@@ -0,0 +1,530 @@
+#include "DeviceMemoryAllocator.h"
+#include "OneShotSubmitter.h"
+
+#include "../AstranEditorUI.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Ranges cover the whole block in offset order, Owner is nullptr for free ranges and two free
+// ranges are never adjacent
+struct Suballocation
+{
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+	DeviceAllocation* Owner = nullptr;
+};
+
+struct MemoryBlock
+{
+	VkDeviceMemory Memory = VK_NULL_HANDLE;
+	VkDeviceSize Size = 0;
+	VkDeviceSize Used = 0;
+	uint32_t MemoryType = 0;
+	uint8_t* MappedData = nullptr;
+	// Holds a single oversized allocation, never shared or defragmented
+	bool Dedicated = false;
+	std::vector<Suballocation> Ranges;
+};
+
+static std::recursive_mutex                        g_Mutex;
+static std::vector<std::unique_ptr<MemoryBlock>>   g_Blocks[VK_MAX_MEMORY_TYPES];
+static VkPhysicalDeviceMemoryProperties            g_MemoryProperties = {};
+static VkDeviceSize                                g_BlockSize = 0;
+static VkDeviceSize                                g_Granularity = 1;
+static uint32_t                                    g_DeviceAllocations = 0;
+static uint32_t                                    g_MaxDeviceAllocations = 0;
+// Empty blocks are kept until Defragment is done so the ranges it walks stay put
+static bool                                        g_Defragmenting = false;
+static DefragmentationResult                       g_LastDefragmentation;
+
+namespace Utils {
+
+	static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// bufferImageGranularity is a power of two, pages are aligned to it
+	static bool OnSamePage(VkDeviceSize lastByte, VkDeviceSize firstByte)
+	{
+		return (lastByte & ~(g_Granularity - 1)) == (firstByte & ~(g_Granularity - 1));
+	}
+
+	static bool Conflicts(const Suballocation& range, DeviceResourceKind kind)
+	{
+		return range.Owner && range.Owner->Kind != kind;
+	}
+
+	static uint32_t FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+	{
+		for (uint32_t i = 0; i < g_MemoryProperties.memoryTypeCount; i++)
+		{
+			if ((g_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties && typeBits & (1 << i))
+				return i;
+		}
+
+		return 0xffffffff;
+	}
+
+	// Best fit: index of the smallest free range that can hold the request, or -1
+	static int FindRange(const MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, DeviceResourceKind kind, VkDeviceSize& outOffset)
+	{
+		int best = -1;
+		for (size_t i = 0; i < block.Ranges.size(); i++)
+		{
+			const Suballocation& range = block.Ranges[i];
+			if (range.Owner || range.Size < size)
+				continue;
+			if (best >= 0 && range.Size >= block.Ranges[best].Size)
+				continue;
+
+			VkDeviceSize offset = AlignUp(range.Offset, alignment);
+			if (i > 0 && g_Granularity > 1)
+			{
+				const Suballocation& previous = block.Ranges[i - 1];
+				if (Conflicts(previous, kind) && OnSamePage(previous.Offset + previous.Size - 1, offset))
+					offset = AlignUp(offset, g_Granularity);
+			}
+
+			VkDeviceSize end = offset + size;
+			if (end > range.Offset + range.Size)
+				continue;
+			if (i + 1 < block.Ranges.size() && g_Granularity > 1)
+			{
+				const Suballocation& next = block.Ranges[i + 1];
+				if (Conflicts(next, kind) && OnSamePage(end - 1, next.Offset))
+					continue;
+			}
+
+			best = (int)i;
+			outOffset = offset;
+		}
+
+		return best;
+	}
+
+	// Splits free range index around [offset, offset + owner->Size) and hands it to owner
+	static void Claim(MemoryBlock& block, int index, VkDeviceSize offset, DeviceAllocation* owner)
+	{
+		Suballocation range = block.Ranges[index];
+		VkDeviceSize end = offset + owner->Size;
+
+		Suballocation parts[3];
+		int count = 0;
+		if (offset > range.Offset)
+			parts[count++] = { range.Offset, offset - range.Offset, nullptr };
+		parts[count++] = { offset, owner->Size, owner };
+		if (end < range.Offset + range.Size)
+			parts[count++] = { end, range.Offset + range.Size - end, nullptr };
+
+		block.Ranges.erase(block.Ranges.begin() + index);
+		block.Ranges.insert(block.Ranges.begin() + index, parts, parts + count);
+		block.Used += owner->Size;
+
+		owner->Memory = block.Memory;
+		owner->Offset = offset;
+		owner->MemoryType = block.MemoryType;
+		owner->MappedData = block.MappedData ? block.MappedData + offset : nullptr;
+		owner->Block = &block;
+	}
+
+	// Returns the range of owner to the free list, merging it with free neighbours
+	static void Release(MemoryBlock& block, const DeviceAllocation* owner)
+	{
+		auto it = std::lower_bound(block.Ranges.begin(), block.Ranges.end(), owner->Offset,
+			[](const Suballocation& range, VkDeviceSize offset) { return range.Offset < offset; });
+		IM_ASSERT(it != block.Ranges.end() && it->Owner == owner);
+
+		size_t index = it - block.Ranges.begin();
+		block.Ranges[index].Owner = nullptr;
+		block.Used -= owner->Size;
+
+		if (index + 1 < block.Ranges.size() && !block.Ranges[index + 1].Owner)
+		{
+			block.Ranges[index].Size += block.Ranges[index + 1].Size;
+			block.Ranges.erase(block.Ranges.begin() + index + 1);
+		}
+		if (index > 0 && !block.Ranges[index - 1].Owner)
+		{
+			block.Ranges[index - 1].Size += block.Ranges[index].Size;
+			block.Ranges.erase(block.Ranges.begin() + index);
+		}
+	}
+
+	static MemoryBlock* CreateBlock(uint32_t memoryType, VkDeviceSize size, bool dedicated)
+	{
+		VkDevice device = AstranEditorUI::GetDevice();
+
+		VkMemoryAllocateInfo alloc_info = {};
+		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		alloc_info.allocationSize = size;
+		alloc_info.memoryTypeIndex = memoryType;
+		VkDeviceMemory memory;
+		VkResult err = vkAllocateMemory(device, &alloc_info, nullptr, &memory);
+		if (err != VK_SUCCESS)
+		{
+			std::cout << "DeviceMemoryAllocator: vkAllocateMemory of " << size << " bytes failed (" << err << ") on memory type " << memoryType << "\n";
+			return nullptr;
+		}
+		g_DeviceAllocations++;
+
+		std::unique_ptr<MemoryBlock> block = std::make_unique<MemoryBlock>();
+		block->Memory = memory;
+		block->Size = size;
+		block->MemoryType = memoryType;
+		block->Dedicated = dedicated;
+		block->Ranges.push_back({ 0, size, nullptr });
+
+		// Mapped once for the lifetime of the block, sub-allocations just offset into it
+		if (g_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			void* data = nullptr;
+			err = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data);
+			check_vk_result(err);
+			block->MappedData = (uint8_t*)data;
+		}
+
+		g_Blocks[memoryType].push_back(std::move(block));
+		return g_Blocks[memoryType].back().get();
+	}
+
+	static void DestroyBlock(MemoryBlock* block)
+	{
+		VkDevice device = AstranEditorUI::GetDevice();
+		if (block->MappedData)
+			vkUnmapMemory(device, block->Memory);
+		vkFreeMemory(device, block->Memory, nullptr);
+		g_DeviceAllocations--;
+
+		std::vector<std::unique_ptr<MemoryBlock>>& blocks = g_Blocks[block->MemoryType];
+		blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+			[block](const std::unique_ptr<MemoryBlock>& candidate) { return candidate.get() == block; }), blocks.end());
+	}
+
+	static void AccumulateStats(const MemoryBlock& block, DeviceMemoryStats& stats, VkDeviceSize& freeBytes)
+	{
+		stats.BlockCount++;
+		stats.BlockBytes += block.Size;
+		stats.UsedBytes += block.Used;
+		for (const Suballocation& range : block.Ranges)
+		{
+			if (range.Owner)
+			{
+				stats.AllocationCount++;
+				continue;
+			}
+			stats.FreeRangeCount++;
+			stats.LargestFreeRange = std::max(stats.LargestFreeRange, range.Size);
+			freeBytes += range.Size;
+		}
+	}
+
+	static void FinishStats(DeviceMemoryStats& stats, VkDeviceSize freeBytes)
+	{
+		stats.Fragmentation = freeBytes ? 1.0f - (float)((double)stats.LargestFreeRange / (double)freeBytes) : 0.0f;
+	}
+
+}
+
+void DeviceMemoryAllocator::Initialize(VkDeviceSize blockSize)
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+
+	VkPhysicalDevice physicalDevice = AstranEditorUI::GetPhysicalDevice();
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &g_MemoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	g_Granularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+	g_MaxDeviceAllocations = properties.limits.maxMemoryAllocationCount;
+
+	g_BlockSize = blockSize;
+	g_DeviceAllocations = 0;
+}
+
+void DeviceMemoryAllocator::Shutdown()
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+
+	for (std::vector<std::unique_ptr<MemoryBlock>>& blocks : g_Blocks)
+	{
+		while (!blocks.empty())
+		{
+			IM_ASSERT(blocks.back()->Used == 0 && "DeviceMemoryAllocator: allocation leaked at shutdown");
+			Utils::DestroyBlock(blocks.back().get());
+		}
+	}
+}
+
+DeviceAllocation* DeviceMemoryAllocator::AllocateForImage(VkImage image, VkMemoryPropertyFlags properties)
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	VkMemoryRequirements req;
+	vkGetImageMemoryRequirements(device, image, &req);
+	DeviceAllocation* allocation = Allocate(req, properties, DeviceResourceKind::Image);
+	if (!allocation)
+		return nullptr;
+
+	VkResult err = vkBindImageMemory(device, image, allocation->Memory, allocation->Offset);
+	check_vk_result(err);
+	return allocation;
+}
+
+DeviceAllocation* DeviceMemoryAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	VkMemoryRequirements req;
+	vkGetBufferMemoryRequirements(device, buffer, &req);
+	DeviceAllocation* allocation = Allocate(req, properties, DeviceResourceKind::Buffer);
+	if (!allocation)
+		return nullptr;
+
+	VkResult err = vkBindBufferMemory(device, buffer, allocation->Memory, allocation->Offset);
+	check_vk_result(err);
+	return allocation;
+}
+
+DeviceAllocation* DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, DeviceResourceKind kind)
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+	IM_ASSERT(g_BlockSize && "DeviceMemoryAllocator::Initialize was not called");
+
+	uint32_t memoryType = Utils::FindMemoryType(requirements.memoryTypeBits, properties);
+	if (memoryType == 0xffffffff)
+	{
+		std::cout << "DeviceMemoryAllocator: no memory type with flags " << properties << " in mask " << requirements.memoryTypeBits << "\n";
+		return nullptr;
+	}
+
+	std::unique_ptr<DeviceAllocation> allocation = std::make_unique<DeviceAllocation>();
+	allocation->Size = requirements.size;
+	allocation->Alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+	allocation->Kind = kind;
+
+	// Small heaps (BAR memory, some integrated parts) get proportionally smaller blocks
+	VkDeviceSize heapSize = g_MemoryProperties.memoryHeaps[g_MemoryProperties.memoryTypes[memoryType].heapIndex].size;
+	VkDeviceSize blockSize = std::min(g_BlockSize, std::max<VkDeviceSize>(heapSize / 8, 1));
+
+	if (requirements.size > blockSize / 2)
+	{
+		MemoryBlock* block = Utils::CreateBlock(memoryType, requirements.size, true);
+		if (!block)
+			return nullptr;
+		Utils::Claim(*block, 0, 0, allocation.get());
+		return allocation.release();
+	}
+
+	for (std::unique_ptr<MemoryBlock>& block : g_Blocks[memoryType])
+	{
+		if (block->Dedicated || block->Size - block->Used < requirements.size)
+			continue;
+
+		VkDeviceSize offset;
+		int index = Utils::FindRange(*block, requirements.size, allocation->Alignment, kind, offset);
+		if (index >= 0)
+		{
+			Utils::Claim(*block, index, offset, allocation.get());
+			return allocation.release();
+		}
+	}
+
+	MemoryBlock* block = Utils::CreateBlock(memoryType, blockSize, false);
+	if (!block)
+		return nullptr;
+	Utils::Claim(*block, 0, 0, allocation.get());
+	return allocation.release();
+}
+
+void DeviceMemoryAllocator::Free(DeviceAllocation* allocation)
+{
+	if (!allocation)
+		return;
+
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+
+	MemoryBlock* block = allocation->Block;
+	Utils::Release(*block, allocation);
+	delete allocation;
+
+	if (block->Used || g_Defragmenting)
+		return;
+	if (block->Dedicated)
+	{
+		Utils::DestroyBlock(block);
+		return;
+	}
+
+	// Keep one empty shared block per type around, allocation churn would otherwise thrash vkAllocateMemory
+	for (const std::unique_ptr<MemoryBlock>& other : g_Blocks[block->MemoryType])
+	{
+		if (other.get() != block && !other->Dedicated && other->Used == 0)
+		{
+			Utils::DestroyBlock(block);
+			return;
+		}
+	}
+}
+
+DefragmentationResult DeviceMemoryAllocator::Defragment()
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+
+	DefragmentationResult result;
+
+	// Relocate copies read the old ranges, nothing in flight may still be using them
+	vkDeviceWaitIdle(AstranEditorUI::GetDevice());
+	g_Defragmenting = true;
+
+	// Every move records into one command buffer, old resources go once it executed
+	VkCommandBuffer commandBuffer = OneShotSubmitter::Begin();
+	std::vector<std::function<void()>> releases;
+
+	for (uint32_t type = 0; type < g_MemoryProperties.memoryTypeCount; type++)
+	{
+		std::vector<MemoryBlock*> blocks;
+		for (std::unique_ptr<MemoryBlock>& block : g_Blocks[type])
+		{
+			if (!block->Dedicated)
+				blocks.push_back(block.get());
+		}
+		if (blocks.size() < 2)
+			continue;
+
+		// Drain the emptiest blocks into the fullest ones
+		std::sort(blocks.begin(), blocks.end(), [](const MemoryBlock* a, const MemoryBlock* b) { return a->Used < b->Used; });
+
+		for (size_t source = 0; source + 1 < blocks.size(); source++)
+		{
+			std::vector<DeviceAllocation*> owners;
+			for (const Suballocation& range : blocks[source]->Ranges)
+			{
+				if (range.Owner && range.Owner->Relocate)
+					owners.push_back(range.Owner);
+			}
+
+			for (DeviceAllocation* owner : owners)
+			{
+				// A relocation callback may have freed it in the meantime
+				std::vector<Suballocation>& ranges = blocks[source]->Ranges;
+				if (std::none_of(ranges.begin(), ranges.end(), [owner](const Suballocation& range) { return range.Owner == owner; }))
+					continue;
+
+				for (size_t target = blocks.size() - 1; target > source; target--)
+				{
+					MemoryBlock& destination = *blocks[target];
+					if (destination.Size - destination.Used < owner->Size)
+						continue;
+
+					VkDeviceSize offset;
+					int index = Utils::FindRange(destination, owner->Size, owner->Alignment, owner->Kind, offset);
+					if (index < 0)
+						continue;
+
+					std::function<void()> release;
+					if (!owner->Relocate(destination.Memory, offset, commandBuffer, release))
+						break;
+					if (release)
+						releases.push_back(std::move(release));
+
+					MemoryBlock& origin = *owner->Block;
+					Utils::Release(origin, owner);
+					Utils::Claim(destination, index, offset, owner);
+
+					result.Moves++;
+					result.BytesMoved += owner->Size;
+					break;
+				}
+			}
+		}
+	}
+
+	OneShotSubmitter::Wait(OneShotSubmitter::End(commandBuffer));
+	for (std::function<void()>& release : releases)
+	{
+		release();
+	}
+
+	g_Defragmenting = false;
+
+	for (std::vector<std::unique_ptr<MemoryBlock>>& blocks : g_Blocks)
+	{
+		for (size_t i = 0; i < blocks.size();)
+		{
+			if (blocks[i]->Used == 0)
+			{
+				Utils::DestroyBlock(blocks[i].get());
+				result.BlocksFreed++;
+				continue;
+			}
+			i++;
+		}
+	}
+
+	g_LastDefragmentation = result;
+	return result;
+}
+
+DefragmentationResult DeviceMemoryAllocator::GetLastDefragmentation()
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+	return g_LastDefragmentation;
+}
+
+DeviceMemoryStats DeviceMemoryAllocator::GetStats()
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+
+	DeviceMemoryStats stats;
+	VkDeviceSize freeBytes = 0;
+	for (const std::vector<std::unique_ptr<MemoryBlock>>& blocks : g_Blocks)
+	{
+		for (const std::unique_ptr<MemoryBlock>& block : blocks)
+			Utils::AccumulateStats(*block, stats, freeBytes);
+	}
+	Utils::FinishStats(stats, freeBytes);
+	return stats;
+}
+
+DeviceMemoryStats DeviceMemoryAllocator::GetStats(uint32_t memoryType)
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+
+	DeviceMemoryStats stats;
+	VkDeviceSize freeBytes = 0;
+	if (memoryType < VK_MAX_MEMORY_TYPES)
+	{
+		for (const std::unique_ptr<MemoryBlock>& block : g_Blocks[memoryType])
+			Utils::AccumulateStats(*block, stats, freeBytes);
+	}
+	Utils::FinishStats(stats, freeBytes);
+	return stats;
+}
+
+uint32_t DeviceMemoryAllocator::GetDeviceAllocationCount()
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+	return g_DeviceAllocations;
+}
+
+void DeviceMemoryAllocator::LogStats()
+{
+	std::lock_guard<std::recursive_mutex> lock(g_Mutex);
+
+	for (uint32_t type = 0; type < g_MemoryProperties.memoryTypeCount; type++)
+	{
+		if (g_Blocks[type].empty())
+			continue;
+
+		DeviceMemoryStats stats = GetStats(type);
+		std::cout << "[memory] type " << type << ": " << stats.BlockCount << " blocks, " << (stats.BlockBytes >> 20) << " MiB, "
+			<< (stats.UsedBytes >> 20) << " MiB used by " << stats.AllocationCount << " allocations, "
+			<< stats.FreeRangeCount << " free ranges, fragmentation " << stats.Fragmentation << "\n";
+	}
+	std::cout << "[memory] " << g_DeviceAllocations << " of " << g_MaxDeviceAllocations << " device allocations\n";
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <functional>
+
+struct MemoryBlock;
+
+enum class DeviceResourceKind
+{
+	Buffer,
+	Image
+};
+
+// One sub-allocated range of a pooled VkDeviceMemory block, owned by DeviceMemoryAllocator.
+// The pointer stays valid until Free, Memory/Offset/MappedData change when Defragment moves it.
+struct DeviceAllocation
+{
+	VkDeviceMemory Memory = VK_NULL_HANDLE;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+	uint32_t MemoryType = 0;
+	// Host visible memory only, the block is mapped once for its whole lifetime
+	void* MappedData = nullptr;
+
+	// Set by the owner to make the allocation movable. Must recreate the resource bound at
+	// (memory, offset) and record the copy of its contents into commandBuffer, returning false leaves
+	// it where it is. The old resource is read until Defragment waited for the copies, destroy it
+	// from release, which runs after that. Allocations without it are never moved.
+	std::function<bool(VkDeviceMemory memory, VkDeviceSize offset, VkCommandBuffer commandBuffer, std::function<void()>& release)> Relocate;
+
+	// Allocator internal
+	MemoryBlock* Block = nullptr;
+	VkDeviceSize Alignment = 1;
+	DeviceResourceKind Kind = DeviceResourceKind::Buffer;
+};
+
+struct DeviceMemoryStats
+{
+	uint32_t BlockCount = 0;
+	uint32_t AllocationCount = 0;
+	VkDeviceSize BlockBytes = 0;
+	VkDeviceSize UsedBytes = 0;
+	uint32_t FreeRangeCount = 0;
+	VkDeviceSize LargestFreeRange = 0;
+	// 1 - largest free range / free bytes. 0 when the free space is one range, towards 1 as it splinters.
+	float Fragmentation = 0.0f;
+};
+
+struct DefragmentationResult
+{
+	uint32_t Moves = 0;
+	VkDeviceSize BytesMoved = 0;
+	uint32_t BlocksFreed = 0;
+};
+
+// Hands out images and buffers from large VkDeviceMemory blocks, one pool per memory type, so the
+// device sees a handful of vkAllocateMemory calls instead of one per resource (drivers may cap
+// maxMemoryAllocationCount as low as 4096). Ranges respect the resource's alignment and keep buffers
+// and optimal images on separate bufferImageGranularity pages. Requests larger than half a block get
+// a block of their own. Thread safe.
+class DeviceMemoryAllocator
+{
+public:
+	static void Initialize(VkDeviceSize blockSize = 64ull * 1024 * 1024);
+	// Every allocation must have been freed
+	static void Shutdown();
+
+	// Allocate + vkBind*Memory. nullptr when no memory type matches or the device is out of memory.
+	static DeviceAllocation* AllocateForImage(VkImage image, VkMemoryPropertyFlags properties);
+	static DeviceAllocation* AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+	static DeviceAllocation* Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, DeviceResourceKind kind);
+	// Accepts nullptr. The resource bound to the range must already be destroyed or unused.
+	static void Free(DeviceAllocation* allocation);
+
+	// Waits for the device to go idle, then moves relocatable allocations out of the emptiest blocks
+	// into the fullest ones and releases blocks left empty. Every copy goes out in one OneShotSubmitter
+	// batch that is waited on once. Render thread only, outside a frame.
+	static DefragmentationResult Defragment();
+	// Result of the most recent Defragment
+	static DefragmentationResult GetLastDefragmentation();
+
+	static DeviceMemoryStats GetStats();
+	static DeviceMemoryStats GetStats(uint32_t memoryType);
+	// Live vkAllocateMemory count against the device limit
+	static uint32_t GetDeviceAllocationCount();
+
+	// Prints one line per memory type in use
+	static void LogStats();
+};
@@ -0,0 +1,116 @@
+#include "DirtyRectList.h"
+
+#include <algorithm>
+
+namespace Utils {
+
+	static uint64_t Area(const TextureRegion& rect)
+	{
+		return (uint64_t)rect.Width * rect.Height;
+	}
+
+	static TextureRegion Union(const TextureRegion& a, const TextureRegion& b)
+	{
+		TextureRegion result;
+		result.X = std::min(a.X, b.X);
+		result.Y = std::min(a.Y, b.Y);
+		result.Width = std::max(a.X + a.Width, b.X + b.Width) - result.X;
+		result.Height = std::max(a.Y + a.Height, b.Y + b.Height) - result.Y;
+		return result;
+	}
+
+	static uint64_t IntersectionArea(const TextureRegion& a, const TextureRegion& b)
+	{
+		uint32_t left = std::max(a.X, b.X);
+		uint32_t top = std::max(a.Y, b.Y);
+		uint32_t right = std::min(a.X + a.Width, b.X + b.Width);
+		uint32_t bottom = std::min(a.Y + a.Height, b.Y + b.Height);
+		return right > left && bottom > top ? (uint64_t)(right - left) * (bottom - top) : 0;
+	}
+
+	static bool Contains(const TextureRegion& outer, const TextureRegion& inner)
+	{
+		return inner.X >= outer.X && inner.Y >= outer.Y && inner.X + inner.Width <= outer.X + outer.Width && inner.Y + inner.Height <= outer.Y + outer.Height;
+	}
+
+	// Texels the merged copy would upload that neither rect asked for
+	static uint64_t MergeWaste(const TextureRegion& a, const TextureRegion& b)
+	{
+		return Area(Union(a, b)) - (Area(a) + Area(b) - IntersectionArea(a, b));
+	}
+
+}
+
+void DirtyRectList::Add(const TextureRegion& rect)
+{
+	if (rect.Width == 0 || rect.Height == 0)
+		return;
+
+	for (const TextureRegion& existing : m_Rects)
+	{
+		if (Utils::Contains(existing, rect))
+			return;
+	}
+
+	m_Rects.erase(std::remove_if(m_Rects.begin(), m_Rects.end(), [&](const TextureRegion& existing) { return Utils::Contains(rect, existing); }), m_Rects.end());
+	m_Rects.push_back(rect);
+}
+
+const std::vector<TextureRegion>& DirtyRectList::Coalesce(uint32_t maxRects)
+{
+	// Cheap merges first: the bounding box wastes at most a quarter of its area
+	bool merged = true;
+	while (merged)
+	{
+		merged = false;
+		for (size_t i = 0; i < m_Rects.size() && !merged; i++)
+		{
+			for (size_t j = i + 1; j < m_Rects.size(); j++)
+			{
+				TextureRegion bounds = Utils::Union(m_Rects[i], m_Rects[j]);
+				if (Utils::MergeWaste(m_Rects[i], m_Rects[j]) * 4 <= Utils::Area(bounds))
+				{
+					m_Rects[i] = bounds;
+					m_Rects.erase(m_Rects.begin() + j);
+					merged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	// Then trade bandwidth for fewer copy regions
+	while (m_Rects.size() > std::max(maxRects, 1u))
+	{
+		size_t bestI = 0, bestJ = 1;
+		uint64_t bestWaste = UINT64_MAX;
+		for (size_t i = 0; i < m_Rects.size(); i++)
+		{
+			for (size_t j = i + 1; j < m_Rects.size(); j++)
+			{
+				uint64_t waste = Utils::MergeWaste(m_Rects[i], m_Rects[j]);
+				if (waste < bestWaste)
+				{
+					bestWaste = waste;
+					bestI = i;
+					bestJ = j;
+				}
+			}
+		}
+
+		m_Rects[bestI] = Utils::Union(m_Rects[bestI], m_Rects[bestJ]);
+		m_Rects.erase(m_Rects.begin() + bestJ);
+	}
+
+	return m_Rects;
+}
+
+uint64_t DirtyRectList::GetArea() const
+{
+	uint64_t area = 0;
+	for (const TextureRegion& rect : m_Rects)
+	{
+		area += Utils::Area(rect);
+	}
+	return area;
+}
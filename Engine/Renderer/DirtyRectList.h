@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+// Texel rectangle inside level 0 of a texture
+struct TextureRegion
+{
+	uint32_t X = 0;
+	uint32_t Y = 0;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+};
+
+// Rectangles written to a texture since its last upload. Coalesce merges them into a few copy
+// regions: pairs whose bounding box is mostly covered are always merged, after that the pair that
+// wastes the least area is merged until maxRects remain.
+class DirtyRectList
+{
+public:
+	void Add(const TextureRegion& rect);
+	const std::vector<TextureRegion>& Coalesce(uint32_t maxRects = 16);
+	void Clear() { m_Rects.clear(); }
+
+	bool IsEmpty() const { return m_Rects.empty(); }
+	const std::vector<TextureRegion>& GetRects() const { return m_Rects; }
+	// Texels covered, overlaps counted twice
+	uint64_t GetArea() const;
+
+private:
+	std::vector<TextureRegion> m_Rects;
+};
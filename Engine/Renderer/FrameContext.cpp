@@ -0,0 +1,183 @@
+#include "FrameContext.h"
+
+#include "GpuCompletionTracker.h"
+
+#include "../AstranEditorUI.h"
+
+#include <algorithm>
+#include <vector>
+
+struct FrameResources
+{
+	VkCommandPool CommandPool = VK_NULL_HANDLE;
+	VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+	// Created signalled and only reset right before a submit, so a frame that never submits
+	// (minimized, out of date swapchain) leaves nothing to wait for
+	VkFence Fence = VK_NULL_HANDLE;
+	VkSemaphore ImageAcquired = VK_NULL_HANDLE;
+	VkSemaphore RenderComplete = VK_NULL_HANDLE;
+};
+
+static std::vector<FrameResources> g_Frames;
+// Fence of the frame that last rendered to each swapchain image
+static std::vector<VkFence>        g_ImageFences;
+static uint32_t                    g_FrameIndex = 0;
+static uint64_t                    g_FrameNumber = 0;
+
+void FrameContext::Initialize(uint32_t framesInFlight)
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+	g_Frames.resize(std::max(framesInFlight, 1u));
+
+	for (FrameResources& frame : g_Frames)
+	{
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = AstranEditorUI::GetQueueFamily();
+		VkResult err = vkCreateCommandPool(device, &poolInfo, nullptr, &frame.CommandPool);
+		check_vk_result(err);
+
+		VkCommandBufferAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocateInfo.commandPool = frame.CommandPool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocateInfo.commandBufferCount = 1;
+		err = vkAllocateCommandBuffers(device, &allocateInfo, &frame.CommandBuffer);
+		check_vk_result(err);
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		err = vkCreateFence(device, &fenceInfo, nullptr, &frame.Fence);
+		check_vk_result(err);
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		err = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.ImageAcquired);
+		check_vk_result(err);
+		err = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.RenderComplete);
+		check_vk_result(err);
+	}
+
+	g_ImageFences.clear();
+	g_FrameIndex = 0;
+	g_FrameNumber = 0;
+}
+
+void FrameContext::Shutdown()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+	for (FrameResources& frame : g_Frames)
+	{
+		vkDestroySemaphore(device, frame.RenderComplete, nullptr);
+		vkDestroySemaphore(device, frame.ImageAcquired, nullptr);
+		vkDestroyFence(device, frame.Fence, nullptr);
+		// Frees the command buffer with it
+		vkDestroyCommandPool(device, frame.CommandPool, nullptr);
+	}
+	g_Frames.clear();
+	g_ImageFences.clear();
+}
+
+void FrameContext::BeginFrame()
+{
+	FrameResources& frame = g_Frames[g_FrameIndex];
+
+	VkDevice device = AstranEditorUI::GetDevice();
+	VkResult err = vkWaitForFences(device, 1, &frame.Fence, VK_TRUE, UINT64_MAX);
+	check_vk_result(err);
+	err = vkResetCommandPool(device, frame.CommandPool, 0);
+	check_vk_result(err);
+
+	g_FrameNumber++;
+}
+
+void FrameContext::EndFrame()
+{
+	g_FrameIndex = (g_FrameIndex + 1) % (uint32_t)g_Frames.size();
+}
+
+VkCommandBuffer FrameContext::BeginCommandBuffer()
+{
+	VkCommandBuffer commandBuffer = g_Frames[g_FrameIndex].CommandBuffer;
+
+	VkCommandBufferBeginInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VkResult err = vkBeginCommandBuffer(commandBuffer, &info);
+	check_vk_result(err);
+	return commandBuffer;
+}
+
+void FrameContext::Submit(VkPipelineStageFlags waitStage)
+{
+	FrameResources& frame = g_Frames[g_FrameIndex];
+
+	VkResult err = vkEndCommandBuffer(frame.CommandBuffer);
+	check_vk_result(err);
+
+	VkSubmitInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	info.waitSemaphoreCount = 1;
+	info.pWaitSemaphores = &frame.ImageAcquired;
+	info.pWaitDstStageMask = &waitStage;
+	info.commandBufferCount = 1;
+	info.pCommandBuffers = &frame.CommandBuffer;
+	info.signalSemaphoreCount = 1;
+	info.pSignalSemaphores = &frame.RenderComplete;
+
+	err = vkResetFences(AstranEditorUI::GetDevice(), 1, &frame.Fence);
+	check_vk_result(err);
+	GpuCompletionTracker::Submit(AstranEditorUI::GetQueue(), info, frame.Fence);
+}
+
+void FrameContext::WaitForImage(uint32_t imageIndex)
+{
+	if (imageIndex >= g_ImageFences.size())
+		g_ImageFences.resize(imageIndex + 1, VK_NULL_HANDLE);
+
+	VkFence fence = g_Frames[g_FrameIndex].Fence;
+	VkFence previous = g_ImageFences[imageIndex];
+	if (previous != VK_NULL_HANDLE && previous != fence)
+	{
+		VkResult err = vkWaitForFences(AstranEditorUI::GetDevice(), 1, &previous, VK_TRUE, UINT64_MAX);
+		check_vk_result(err);
+	}
+	g_ImageFences[imageIndex] = fence;
+}
+
+VkCommandPool FrameContext::GetCommandPool()
+{
+	return g_Frames[g_FrameIndex].CommandPool;
+}
+
+VkFence FrameContext::GetFence()
+{
+	return g_Frames[g_FrameIndex].Fence;
+}
+
+VkSemaphore FrameContext::GetImageAcquiredSemaphore()
+{
+	return g_Frames[g_FrameIndex].ImageAcquired;
+}
+
+VkSemaphore FrameContext::GetRenderCompleteSemaphore()
+{
+	return g_Frames[g_FrameIndex].RenderComplete;
+}
+
+uint32_t FrameContext::GetFrameIndex()
+{
+	return g_FrameIndex;
+}
+
+uint32_t FrameContext::GetFramesInFlight()
+{
+	return (uint32_t)g_Frames.size();
+}
+
+uint64_t FrameContext::GetFrameNumber()
+{
+	return g_FrameNumber;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+// Per frame command pool, command buffer, fence and semaphores for a fixed number of frames in
+// flight, independent of how many images the swapchain has. BeginFrame waits for the frame that
+// last used the slot before the CPU starts building the next one, so the CPU runs at most
+// framesInFlight - 1 frames ahead of the GPU and never waits anywhere else.
+// Render thread only.
+class FrameContext
+{
+public:
+	static void Initialize(uint32_t framesInFlight = 2);
+	// The device must be idle
+	static void Shutdown();
+
+	// Waits for the slot's previous submit and resets its command pool. Call before any CPU work
+	// for the frame (ImGui::NewFrame, uploads).
+	static void BeginFrame();
+	// Moves on to the next slot, after the frame was presented or skipped
+	static void EndFrame();
+
+	// Begins the slot's command buffer for recording
+	static VkCommandBuffer BeginCommandBuffer();
+	// Ends and submits it, waiting on the image acquire and signalling render complete and the fence
+	static void Submit(VkPipelineStageFlags waitStage);
+
+	// Swapchain images can be handed out again while an older frame still renders to them when
+	// there are more frames in flight than images. Waits for that frame, call after acquiring.
+	static void WaitForImage(uint32_t imageIndex);
+
+	static VkCommandPool GetCommandPool();
+	static VkFence GetFence();
+	static VkSemaphore GetImageAcquiredSemaphore();
+	static VkSemaphore GetRenderCompleteSemaphore();
+
+	// Slot of the current frame, in [0, GetFramesInFlight())
+	static uint32_t GetFrameIndex();
+	static uint32_t GetFramesInFlight();
+	// Frames begun since Initialize
+	static uint64_t GetFrameNumber();
+};
@@ -0,0 +1,239 @@
+#include "GpuCompletionTracker.h"
+
+#include "../AstranEditorUI.h"
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <vector>
+
+struct PendingFence
+{
+	uint64_t value = 0;
+	VkFence fence = VK_NULL_HANDLE;
+};
+
+static VkSemaphore                                     g_Timeline = VK_NULL_HANDLE;
+static PFN_vkGetSemaphoreCounterValueKHR               g_GetSemaphoreCounterValue = nullptr;
+static PFN_vkWaitSemaphoresKHR                         g_WaitSemaphores = nullptr;
+
+// Fallback, one fence per submit in submission order
+static std::deque<PendingFence>                        g_PendingFences;
+static std::vector<VkFence>                            g_FreeFences;
+
+static uint64_t                                        g_SubmittedValue = 0;
+static uint64_t                                        g_CompletedValue = 0;
+static std::multimap<uint64_t, std::function<void()>> g_Callbacks;
+
+void GpuCompletionTracker::Initialize()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	g_SubmittedValue = 0;
+	g_CompletedValue = 0;
+	g_Timeline = VK_NULL_HANDLE;
+	g_GetSemaphoreCounterValue = nullptr;
+	g_WaitSemaphores = nullptr;
+
+	if (AstranEditorUI::HasTimelineSemaphore())
+	{
+		g_GetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+		g_WaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+	}
+
+	if (g_GetSemaphoreCounterValue && g_WaitSemaphores)
+	{
+		VkSemaphoreTypeCreateInfoKHR type_info = {};
+		type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		type_info.initialValue = 0;
+		VkSemaphoreCreateInfo semaphore_info = {};
+		semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphore_info.pNext = &type_info;
+		VkResult err = vkCreateSemaphore(device, &semaphore_info, nullptr, &g_Timeline);
+		check_vk_result(err);
+	}
+
+	std::cout << "[gpu] completion tracking with " << (g_Timeline ? "a timeline semaphore" : "fences") << "\n";
+}
+
+void GpuCompletionTracker::Shutdown()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	Wait(g_SubmittedValue);
+	Poll();
+
+	for (VkFence fence : g_FreeFences)
+	{
+		vkDestroyFence(device, fence, nullptr);
+	}
+	g_FreeFences.clear();
+
+	if (g_Timeline)
+	{
+		vkDestroySemaphore(device, g_Timeline, nullptr);
+		g_Timeline = VK_NULL_HANDLE;
+	}
+}
+
+uint64_t GpuCompletionTracker::Submit(VkQueue queue, const VkSubmitInfo& info, VkFence fence)
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+	VkResult err;
+	uint64_t value = ++g_SubmittedValue;
+
+	if (g_Timeline)
+	{
+		// Appended to the caller's signal semaphores, the values of binary ones are ignored
+		std::vector<VkSemaphore> semaphores(info.pSignalSemaphores, info.pSignalSemaphores + info.signalSemaphoreCount);
+		std::vector<uint64_t> values(info.signalSemaphoreCount, 0);
+		semaphores.push_back(g_Timeline);
+		values.push_back(value);
+
+		VkTimelineSemaphoreSubmitInfoKHR timeline_info = {};
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timeline_info.pNext = info.pNext;
+		timeline_info.signalSemaphoreValueCount = (uint32_t)values.size();
+		timeline_info.pSignalSemaphoreValues = values.data();
+
+		VkSubmitInfo submit_info = info;
+		submit_info.pNext = &timeline_info;
+		submit_info.signalSemaphoreCount = (uint32_t)semaphores.size();
+		submit_info.pSignalSemaphores = semaphores.data();
+		err = vkQueueSubmit(queue, 1, &submit_info, fence);
+		check_vk_result(err);
+		return value;
+	}
+
+	err = vkQueueSubmit(queue, 1, &info, fence);
+	check_vk_result(err);
+
+	// The caller's fence is theirs to reset, ours goes in an empty submit that signals once
+	// everything submitted so far has completed
+	PendingFence pending;
+	pending.value = value;
+	if (!g_FreeFences.empty())
+	{
+		pending.fence = g_FreeFences.back();
+		g_FreeFences.pop_back();
+	}
+	else
+	{
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		err = vkCreateFence(device, &fence_info, nullptr, &pending.fence);
+		check_vk_result(err);
+	}
+	err = vkQueueSubmit(queue, 0, nullptr, pending.fence);
+	check_vk_result(err);
+	g_PendingFences.push_back(pending);
+	return value;
+}
+
+void GpuCompletionTracker::Poll()
+{
+	UpdateCompletedValue();
+
+	// Callbacks may register new ones, take the ready ones out first
+	std::vector<std::function<void()>> ready;
+	auto end = g_Callbacks.upper_bound(g_CompletedValue);
+	for (auto it = g_Callbacks.begin(); it != end; ++it)
+	{
+		ready.push_back(std::move(it->second));
+	}
+	g_Callbacks.erase(g_Callbacks.begin(), end);
+
+	for (std::function<void()>& callback : ready)
+	{
+		callback();
+	}
+}
+
+void GpuCompletionTracker::OnComplete(uint64_t value, std::function<void()> callback)
+{
+	g_Callbacks.emplace(value, std::move(callback));
+}
+
+bool GpuCompletionTracker::IsComplete(uint64_t value)
+{
+	if (value <= g_CompletedValue)
+		return true;
+
+	UpdateCompletedValue();
+	return value <= g_CompletedValue;
+}
+
+void GpuCompletionTracker::Wait(uint64_t value)
+{
+	if (IsComplete(value))
+		return;
+
+	IM_ASSERT(value <= g_SubmittedValue && "GpuCompletionTracker: waiting for a value nothing signals");
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	if (g_Timeline)
+	{
+		VkSemaphoreWaitInfoKHR wait_info = {};
+		wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		wait_info.semaphoreCount = 1;
+		wait_info.pSemaphores = &g_Timeline;
+		wait_info.pValues = &value;
+		VkResult err = g_WaitSemaphores(device, &wait_info, UINT64_MAX);
+		check_vk_result(err);
+		UpdateCompletedValue();
+		return;
+	}
+
+	while (!g_PendingFences.empty() && g_PendingFences.front().value <= value)
+	{
+		VkResult err = vkWaitForFences(device, 1, &g_PendingFences.front().fence, VK_TRUE, UINT64_MAX);
+		check_vk_result(err);
+		UpdateCompletedValue();
+	}
+}
+
+uint64_t GpuCompletionTracker::GetSubmittedValue()
+{
+	return g_SubmittedValue;
+}
+
+uint64_t GpuCompletionTracker::GetCompletedValue()
+{
+	return g_CompletedValue;
+}
+
+bool GpuCompletionTracker::UsesTimelineSemaphore()
+{
+	return g_Timeline != VK_NULL_HANDLE;
+}
+
+void GpuCompletionTracker::UpdateCompletedValue()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	if (g_Timeline)
+	{
+		uint64_t value = 0;
+		VkResult err = g_GetSemaphoreCounterValue(device, g_Timeline, &value);
+		check_vk_result(err);
+		g_CompletedValue = std::max(g_CompletedValue, value);
+		return;
+	}
+
+	// One queue, so fences signal in submission order
+	while (!g_PendingFences.empty())
+	{
+		PendingFence& pending = g_PendingFences.front();
+		if (vkGetFenceStatus(device, pending.fence) != VK_SUCCESS)
+			break;
+
+		VkResult err = vkResetFences(device, 1, &pending.fence);
+		check_vk_result(err);
+		g_FreeFences.push_back(pending.fence);
+
+		g_CompletedValue = pending.value;
+		g_PendingFences.pop_front();
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <functional>
+
+// One increasing value per queue submit, reached once that submit and everything submitted before
+// it finished on the GPU. Backed by a VK_KHR_timeline_semaphore signalled by every submit, devices
+// without it get a pooled fence per submit instead.
+// Callbacks registered with OnComplete run from Poll, once per frame, so resource release and
+// completion handling never has to idle the device.
+// Render thread only.
+class GpuCompletionTracker
+{
+public:
+	static void Initialize();
+	// Waits for everything submitted and runs the remaining callbacks
+	static void Shutdown();
+
+	// vkQueueSubmit of a single batch, returns the value it completes with. fence is signalled as usual.
+	static uint64_t Submit(VkQueue queue, const VkSubmitInfo& info, VkFence fence = VK_NULL_HANDLE);
+
+	// Updates the completed value and runs the callbacks it reached, call once per frame
+	static void Poll();
+
+	// Runs callback from the first Poll that sees value reached, even if it already is
+	static void OnComplete(uint64_t value, std::function<void()> callback);
+
+	// Value 0 is always complete
+	static bool IsComplete(uint64_t value);
+	static void Wait(uint64_t value);
+
+	// Value of the most recent Submit
+	static uint64_t GetSubmittedValue();
+	static uint64_t GetCompletedValue();
+	static bool UsesTimelineSemaphore();
+
+private:
+	static void UpdateCompletedValue();
+};
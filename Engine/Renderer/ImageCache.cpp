@@ -0,0 +1,187 @@
+#include "ImageCache.h"
+#include "ImageDecoder.h"
+#include "Texture.h"
+
+#include "../Core/MappedFile.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+static const uint32_t g_CacheMagic = 0x43474D49; // "IMGC"
+static const uint32_t g_CacheVersion = 2;
+
+struct CacheHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Key;
+	uint32_t Width;
+	uint32_t Height;
+	// VkFormat, stable across changes to the ImageFormat enum
+	uint32_t Format;
+	uint32_t Reserved;
+};
+
+static std::mutex             g_DirectoryMutex;
+static std::string            g_Directory = "../Intermediate/ImageCache";
+
+static std::atomic<uint64_t>  g_Hits{ 0 };
+static std::atomic<uint64_t>  g_Misses{ 0 };
+
+namespace Utils {
+
+	static const uint64_t g_Prime1 = 0x9E3779B185EBCA87ull;
+	static const uint64_t g_Prime2 = 0xC2B2AE3D27D4EB4Full;
+	static const uint64_t g_Prime3 = 0x165667B19E3779F9ull;
+
+	static inline uint64_t RotateLeft(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	static inline uint64_t Mix(uint64_t hash, uint64_t value)
+	{
+		value *= g_Prime2;
+		value = RotateLeft(value, 31) * g_Prime1;
+		hash ^= value;
+		return RotateLeft(hash, 27) * g_Prime1 + g_Prime3;
+	}
+
+	static std::string GetEntryPath(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.img", (unsigned long long)key);
+		return (std::filesystem::path(ImageCache::GetDirectory()) / name).string();
+	}
+
+}
+
+void ImageCache::SetDirectory(const std::string& directory)
+{
+	std::lock_guard<std::mutex> lock(g_DirectoryMutex);
+	g_Directory = directory;
+}
+
+std::string ImageCache::GetDirectory()
+{
+	std::lock_guard<std::mutex> lock(g_DirectoryMutex);
+	return g_Directory;
+}
+
+uint64_t ImageCache::Hash(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t hash = seed ^ (size * Utils::g_Prime1);
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = Utils::Mix(hash, word);
+	}
+	for (; i < size; i++)
+	{
+		hash = Utils::RotateLeft(hash ^ (bytes[i] * Utils::g_Prime3), 11) * Utils::g_Prime1;
+	}
+
+	// Final avalanche so nearby inputs land far apart
+	hash ^= hash >> 33;
+	hash *= Utils::g_Prime2;
+	hash ^= hash >> 29;
+	hash *= Utils::g_Prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+uint64_t ImageCache::HashCombine(uint64_t hash, uint64_t value)
+{
+	return Hash(&value, sizeof(value), hash);
+}
+
+bool ImageCache::Load(uint64_t key, DecodedImage& outImage)
+{
+	MappedFile file;
+	// Misses are expected, only real I/O errors are worth a message
+	if (!file.Open(Utils::GetEntryPath(key), FileAccess::Sequential, false) || file.GetSize() < sizeof(CacheHeader))
+	{
+		g_Misses++;
+		return false;
+	}
+
+	CacheHeader header;
+	memcpy(&header, file.GetData(), sizeof(header));
+
+	ImageFormat format = Texture::GetImageFormat((VkFormat)header.Format);
+	bool validFormat = format == ImageFormat::RGBA || format == ImageFormat::RGBA16F;
+	uint64_t pixelBytes = validFormat ? Texture::GetImageSize(format, header.Width, header.Height) : 0;
+	if (header.Magic != g_CacheMagic || header.Version != g_CacheVersion || header.Key != key || !validFormat || file.GetSize() != sizeof(CacheHeader) + pixelBytes)
+	{
+		// Stale or truncated, the next Store replaces it
+		g_Misses++;
+		return false;
+	}
+
+	outImage.Allocate(header.Width, header.Height, format);
+	memcpy(outImage.GetPixels(), file.GetData() + sizeof(CacheHeader), pixelBytes);
+	g_Hits++;
+	return true;
+}
+
+bool ImageCache::Store(uint64_t key, const DecodedImage& image)
+{
+	if (!image.IsValid())
+		return false;
+
+	std::error_code error;
+	std::filesystem::create_directories(GetDirectory(), error);
+
+	std::string path = Utils::GetEntryPath(key);
+	std::string temporaryPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+	{
+		std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!stream)
+		{
+			std::cout << "ImageCache: could not write " << temporaryPath << "\n";
+			return false;
+		}
+
+		CacheHeader header = { g_CacheMagic, g_CacheVersion, key, image.GetWidth(), image.GetHeight(), (uint32_t)Texture::GetVulkanFormat(image.GetFormat()), 0 };
+		stream.write((const char*)&header, sizeof(header));
+		stream.write((const char*)image.GetPixels(), image.GetSize());
+		if (!stream)
+		{
+			std::cout << "ImageCache: could not write " << temporaryPath << "\n";
+			stream.close();
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+	}
+
+	// Readers only ever see complete entries
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	return true;
+}
+
+uint64_t ImageCache::GetHitCount()
+{
+	return g_Hits.load();
+}
+
+uint64_t ImageCache::GetMissCount()
+{
+	return g_Misses.load();
+}
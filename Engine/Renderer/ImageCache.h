@@ -0,0 +1,27 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class DecodedImage;
+
+// On disk store of decoded RGBA8/RGBA16F images keyed by a 64 bit content hash, so expensive decodes
+// (SVG rasterization at a given scale, ...) are paid once per machine instead of once per run.
+// Entries are written to a temporary file and renamed into place, all calls are thread safe.
+class ImageCache
+{
+public:
+	// Created on first store, defaults to ../Intermediate/ImageCache
+	static void SetDirectory(const std::string& directory);
+	static std::string GetDirectory();
+
+	// Fast non cryptographic hash of a whole buffer, e.g. a mapped source file
+	static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+	static uint64_t HashCombine(uint64_t hash, uint64_t value);
+
+	static bool Load(uint64_t key, DecodedImage& outImage);
+	static bool Store(uint64_t key, const DecodedImage& image);
+
+	static uint64_t GetHitCount();
+	static uint64_t GetMissCount();
+};
@@ -0,0 +1,200 @@
+#include "ImageDecoder.h"
+#include "ImageCache.h"
+#include "PixelKernels.h"
+#include "Texture.h"
+
+#include "../Core/MappedFile.h"
+
+#include <climits>
+#include <utility>
+
+#include <stb_image.h>
+
+// Bump when decoded output changes so old cache entries are ignored
+static const uint32_t g_DecoderVersion = 1;
+// Larger decodes (gigapixel sources for TiledImage, ...) aren't worth doubling on disk
+static const uint64_t g_MaxCachedBytes = 64ull * 1024 * 1024;
+
+static thread_local const char* g_FailureReason = nullptr;
+
+DecodedImage::~DecodedImage()
+{
+	Reset();
+}
+
+DecodedImage::DecodedImage(DecodedImage&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+DecodedImage& DecodedImage::operator=(DecodedImage&& other) noexcept
+{
+	if (this != &other)
+	{
+		Reset();
+		std::swap(m_Pixels, other.m_Pixels);
+		std::swap(m_Width, other.m_Width);
+		std::swap(m_Height, other.m_Height);
+		std::swap(m_Format, other.m_Format);
+		std::swap(m_BytesPerPixel, other.m_BytesPerPixel);
+		std::swap(m_OwnedByStb, other.m_OwnedByStb);
+	}
+	return *this;
+}
+
+void DecodedImage::Allocate(uint32_t width, uint32_t height)
+{
+	Allocate(width, height, ImageFormat::RGBA);
+}
+
+void DecodedImage::Allocate(uint32_t width, uint32_t height, ImageFormat format)
+{
+	Reset();
+	m_BytesPerPixel = (uint32_t)Texture::GetImageSize(format, 1, 1);
+	m_Pixels = new uint8_t[(size_t)width * height * m_BytesPerPixel];
+	m_Width = width;
+	m_Height = height;
+	m_Format = format;
+}
+
+void DecodedImage::Reset()
+{
+	if (m_OwnedByStb)
+		stbi_image_free(m_Pixels);
+	else
+		delete[] m_Pixels;
+
+	m_Pixels = nullptr;
+	m_Width = 0;
+	m_Height = 0;
+	m_Format = ImageFormat::None;
+	m_BytesPerPixel = 0;
+	m_OwnedByStb = false;
+}
+
+bool ImageDecoder::DecodeRGBA(const std::string& path, bool flipVertically, DecodedImage& outImage, bool useCache)
+{
+	return DecodeCached(path, ImageFormat::RGBA, flipVertically, outImage, useCache);
+}
+
+bool ImageDecoder::DecodeRGBA16F(const std::string& path, bool flipVertically, DecodedImage& outImage)
+{
+	return DecodeCached(path, ImageFormat::RGBA16F, flipVertically, outImage);
+}
+
+bool ImageDecoder::Decode(const std::string& path, bool flipVertically, DecodedImage& outImage)
+{
+	return DecodeCached(path, ImageFormat::None, flipVertically, outImage);
+}
+
+bool ImageDecoder::IsHdr(const std::string& path)
+{
+	MappedFile file;
+	if (!file.Open(path) || file.GetSize() > (uint64_t)INT_MAX)
+		return false;
+	return stbi_is_hdr_from_memory(file.GetData(), (int)file.GetSize()) != 0;
+}
+
+const char* ImageDecoder::GetFailureReason()
+{
+	if (g_FailureReason)
+		return g_FailureReason;
+
+	const char* reason = stbi_failure_reason();
+	return reason ? reason : "unknown error";
+}
+
+bool ImageDecoder::DecodeCached(const std::string& path, ImageFormat format, bool flipVertically, DecodedImage& outImage, bool useCache)
+{
+	outImage.Reset();
+	g_FailureReason = nullptr;
+
+	// One mapping serves the hash and, on a miss, stb
+	MappedFile file;
+	if (!file.Open(path, FileAccess::Sequential))
+	{
+		g_FailureReason = "could not open file";
+		return false;
+	}
+	if (file.GetSize() > (uint64_t)INT_MAX)
+	{
+		g_FailureReason = "file too large";
+		return false;
+	}
+
+	const uint8_t* data = file.GetData();
+	int size = (int)file.GetSize();
+	if (format == ImageFormat::None)
+		format = stbi_is_hdr_from_memory(data, size) ? ImageFormat::RGBA16F : ImageFormat::RGBA;
+
+	uint64_t key = 0;
+	if (useCache)
+	{
+		key = ImageCache::Hash(data, (size_t)size);
+		key = ImageCache::HashCombine(key, ((uint64_t)g_DecoderVersion << 32) | ((uint64_t)format << 1) | (flipVertically ? 1 : 0));
+		if (ImageCache::Load(key, outImage))
+			return true;
+	}
+
+	bool decoded = format == ImageFormat::RGBA16F
+		? DecodeRGBA16FFromMemory(data, (size_t)size, flipVertically, outImage)
+		: DecodeRGBAFromMemory(data, (size_t)size, flipVertically, outImage);
+	file.Close();
+
+	if (decoded && useCache && outImage.GetSize() <= g_MaxCachedBytes)
+		ImageCache::Store(key, outImage);
+	return decoded;
+}
+
+bool ImageDecoder::DecodeRGBAFromMemory(const uint8_t* data, size_t size, bool flipVertically, DecodedImage& outImage)
+{
+	// Native channel count, stb's own expansion and flip are scalar and the flip flag is global
+	int width = 0, height = 0, channels = 0;
+	unsigned char* source = stbi_load_from_memory(data, (int)size, &width, &height, &channels, 0);
+	if (!source)
+		return false;
+
+	size_t pixelCount = (size_t)width * height;
+	if (channels == 4)
+	{
+		outImage.m_Pixels = source;
+		outImage.m_OwnedByStb = true;
+	}
+	else
+	{
+		outImage.m_Pixels = new uint8_t[pixelCount * 4];
+		if (channels == 3)
+			PixelKernels::ExpandRGBToRGBA(source, outImage.m_Pixels, pixelCount);
+		else
+			PixelKernels::ExpandGreyToRGBA(source, (uint32_t)channels, outImage.m_Pixels, pixelCount);
+		stbi_image_free(source);
+	}
+
+	outImage.m_Width = (uint32_t)width;
+	outImage.m_Height = (uint32_t)height;
+	outImage.m_Format = ImageFormat::RGBA;
+	outImage.m_BytesPerPixel = 4;
+
+	if (flipVertically)
+		PixelKernels::FlipVertical(outImage.m_Pixels, (size_t)width * 4, (uint32_t)height);
+
+	return true;
+}
+
+bool ImageDecoder::DecodeRGBA16FFromMemory(const uint8_t* data, size_t size, bool flipVertically, DecodedImage& outImage)
+{
+	// stbi_loadf fills alpha with 1 when asked for 4 channels
+	int width = 0, height = 0, channels = 0;
+	float* source = stbi_loadf_from_memory(data, (int)size, &width, &height, &channels, 4);
+	if (!source)
+		return false;
+
+	outImage.Allocate((uint32_t)width, (uint32_t)height, ImageFormat::RGBA16F);
+	PixelKernels::FloatToHalf(source, (uint16_t*)outImage.m_Pixels, (size_t)width * height * 4);
+	stbi_image_free(source);
+
+	if (flipVertically)
+		PixelKernels::FlipVertical(outImage.m_Pixels, (size_t)width * 8, (uint32_t)height);
+
+	return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+enum class ImageFormat;
+
+// Tightly packed RGBA pixels from ImageDecoder, 8 bit unorm or 16 bit float. Move only, frees itself.
+class DecodedImage
+{
+public:
+	DecodedImage() = default;
+	~DecodedImage();
+
+	DecodedImage(const DecodedImage&) = delete;
+	DecodedImage& operator=(const DecodedImage&) = delete;
+	DecodedImage(DecodedImage&& other) noexcept;
+	DecodedImage& operator=(DecodedImage&& other) noexcept;
+
+	bool IsValid() const { return m_Pixels != nullptr; }
+	uint32_t GetWidth() const { return m_Width; }
+	uint32_t GetHeight() const { return m_Height; }
+	// ImageFormat::RGBA or ImageFormat::RGBA16F, None when empty
+	ImageFormat GetFormat() const { return m_Format; }
+	uint32_t GetBytesPerPixel() const { return m_BytesPerPixel; }
+	const uint8_t* GetPixels() const { return m_Pixels; }
+	uint8_t* GetPixels() { return m_Pixels; }
+	size_t GetSize() const { return (size_t)m_Width * m_Height * m_BytesPerPixel; }
+
+	// Uninitialized width x height buffer owned by this image, RGBA8 unless a format is given
+	void Allocate(uint32_t width, uint32_t height);
+	void Allocate(uint32_t width, uint32_t height, ImageFormat format);
+	void Reset();
+
+private:
+	friend class ImageDecoder;
+
+	uint8_t* m_Pixels = nullptr;
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	ImageFormat m_Format{}; // ImageFormat::None
+	uint32_t m_BytesPerPixel = 0;
+	// 4 channel sources keep stb's buffer, expanded ones live in our own
+	bool m_OwnedByStb = false;
+};
+
+// stb_image front end for every raster source. Produces RGBA8, or RGBA16F for HDR sources, and does
+// the channel expansion, half conversion and vertical flip with PixelKernels, so stb's process wide
+// flip flag is never touched and decoding is safe from any thread.
+// Results are kept in the ImageCache under a hash of the source bytes, a warm decode is a mapped read
+// of the source to hash it plus a copy of the cached pixels, no inflate.
+class ImageDecoder
+{
+public:
+	// useCache false skips the ImageCache both ways, for sources only ever read to derive something
+	// smaller (thumbnails, tile pyramids) that has its own cache entry
+	static bool DecodeRGBA(const std::string& path, bool flipVertically, DecodedImage& outImage, bool useCache = true);
+
+	// Float decode (Radiance .hdr keeps its range, LDR files come back linearized) stored as half
+	// floats, half the size of RGBA32F and plenty for colour data
+	static bool DecodeRGBA16F(const std::string& path, bool flipVertically, DecodedImage& outImage);
+
+	// Picks DecodeRGBA16F for HDR sources and DecodeRGBA otherwise
+	static bool Decode(const std::string& path, bool flipVertically, DecodedImage& outImage);
+
+	static bool IsHdr(const std::string& path);
+
+	// Why the last decode on this thread failed
+	static const char* GetFailureReason();
+
+private:
+	// format ImageFormat::None picks by the source
+	static bool DecodeCached(const std::string& path, ImageFormat format, bool flipVertically, DecodedImage& outImage, bool useCache = true);
+	static bool DecodeRGBAFromMemory(const uint8_t* data, size_t size, bool flipVertically, DecodedImage& outImage);
+	static bool DecodeRGBA16FFromMemory(const uint8_t* data, size_t size, bool flipVertically, DecodedImage& outImage);
+};
@@ -0,0 +1,281 @@
+#include "Ktx2.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static const uint8_t g_Ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+namespace Utils {
+
+	struct DfdSample
+	{
+		uint32_t BitOffset;
+		uint32_t BitLength;
+		uint32_t Channel;
+		uint32_t Lower;
+		uint32_t Upper;
+	};
+
+	struct DfdLayout
+	{
+		uint32_t ColorModel = 0;
+		uint32_t BlockDimension = 1;
+		uint32_t BlockBytes = 0;
+		uint32_t TypeSize = 1;
+		std::vector<DfdSample> Samples;
+	};
+
+	// Khronos Data Format values used below
+	enum : uint32_t
+	{
+		KHR_DF_MODEL_RGBSDA = 1,
+		KHR_DF_MODEL_BC1A = 128,
+		KHR_DF_MODEL_BC3 = 130,
+		KHR_DF_MODEL_BC4 = 131,
+		KHR_DF_MODEL_BC5 = 132,
+		KHR_DF_MODEL_BC7 = 134,
+
+		KHR_DF_CHANNEL_RED = 0,
+		KHR_DF_CHANNEL_GREEN = 1,
+		KHR_DF_CHANNEL_BLUE = 2,
+		KHR_DF_CHANNEL_ALPHA = 15,
+		KHR_DF_CHANNEL_BC1A_ALPHAPRESENT = 1,
+
+		KHR_DF_SAMPLE_DATATYPE_SIGNED = 0x40,
+		KHR_DF_SAMPLE_DATATYPE_FLOAT = 0x80,
+
+		KHR_DF_PRIMARIES_BT709 = 1,
+		KHR_DF_TRANSFER_LINEAR = 1
+	};
+
+	static bool GetDfdLayout(VkFormat format, DfdLayout& layout)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			layout.ColorModel = KHR_DF_MODEL_RGBSDA;
+			layout.BlockBytes = 4;
+			layout.Samples = { { 0, 8, KHR_DF_CHANNEL_RED, 0, 255 }, { 8, 8, KHR_DF_CHANNEL_GREEN, 0, 255 }, { 16, 8, KHR_DF_CHANNEL_BLUE, 0, 255 }, { 24, 8, KHR_DF_CHANNEL_ALPHA, 0, 255 } };
+			return true;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+		{
+			const uint32_t type = KHR_DF_SAMPLE_DATATYPE_FLOAT | KHR_DF_SAMPLE_DATATYPE_SIGNED;
+			layout.ColorModel = KHR_DF_MODEL_RGBSDA;
+			layout.BlockBytes = 16;
+			layout.TypeSize = 4;
+			layout.Samples = { { 0, 32, KHR_DF_CHANNEL_RED | type, 0xBF800000, 0x3F800000 }, { 32, 32, KHR_DF_CHANNEL_GREEN | type, 0xBF800000, 0x3F800000 },
+				{ 64, 32, KHR_DF_CHANNEL_BLUE | type, 0xBF800000, 0x3F800000 }, { 96, 32, KHR_DF_CHANNEL_ALPHA | type, 0xBF800000, 0x3F800000 } };
+			return true;
+		}
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			layout.ColorModel = KHR_DF_MODEL_BC1A;
+			layout.BlockDimension = 4;
+			layout.BlockBytes = 8;
+			layout.Samples = { { 0, 64, KHR_DF_CHANNEL_BC1A_ALPHAPRESENT, 0, 0xFFFFFFFF } };
+			return true;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+			layout.ColorModel = KHR_DF_MODEL_BC3;
+			layout.BlockDimension = 4;
+			layout.BlockBytes = 16;
+			layout.Samples = { { 0, 64, KHR_DF_CHANNEL_ALPHA, 0, 0xFFFFFFFF }, { 64, 64, 0, 0, 0xFFFFFFFF } };
+			return true;
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			layout.ColorModel = KHR_DF_MODEL_BC4;
+			layout.BlockDimension = 4;
+			layout.BlockBytes = 8;
+			layout.Samples = { { 0, 64, KHR_DF_CHANNEL_RED, 0, 0xFFFFFFFF } };
+			return true;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			layout.ColorModel = KHR_DF_MODEL_BC5;
+			layout.BlockDimension = 4;
+			layout.BlockBytes = 16;
+			layout.Samples = { { 0, 64, KHR_DF_CHANNEL_RED, 0, 0xFFFFFFFF }, { 64, 64, KHR_DF_CHANNEL_GREEN, 0, 0xFFFFFFFF } };
+			return true;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+			layout.ColorModel = KHR_DF_MODEL_BC7;
+			layout.BlockDimension = 4;
+			layout.BlockBytes = 16;
+			layout.Samples = { { 0, 128, 0, 0, 0xFFFFFFFF } };
+			return true;
+		}
+		return false;
+	}
+
+	static std::vector<uint32_t> BuildDfd(const DfdLayout& layout)
+	{
+		uint32_t blockSize = 24 + 16 * (uint32_t)layout.Samples.size();
+		uint32_t dimension = layout.BlockDimension - 1;
+
+		std::vector<uint32_t> dfd;
+		dfd.push_back(4 + blockSize); // dfdTotalSize
+		dfd.push_back(0);             // vendorId = Khronos, descriptorType = basic
+		dfd.push_back(2 | (blockSize << 16));
+		dfd.push_back(layout.ColorModel | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16));
+		dfd.push_back(dimension | (dimension << 8));
+		dfd.push_back(layout.BlockBytes);
+		dfd.push_back(0);
+
+		for (const DfdSample& sample : layout.Samples)
+		{
+			dfd.push_back(sample.BitOffset | ((sample.BitLength - 1) << 16) | (sample.Channel << 24));
+			dfd.push_back(0); // sample position
+			dfd.push_back(sample.Lower);
+			dfd.push_back(sample.Upper);
+		}
+		return dfd;
+	}
+
+	template<typename T>
+	static void WriteValue(std::ofstream& stream, T value)
+	{
+		stream.write((const char*)&value, sizeof(T));
+	}
+
+	template<typename T>
+	static T ReadValue(const uint8_t* data, uint64_t offset)
+	{
+		T value;
+		memcpy(&value, data + offset, sizeof(T));
+		return value;
+	}
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+}
+
+bool Ktx2::Write(const std::string& path, const Ktx2Image& image)
+{
+	Utils::DfdLayout layout;
+	if (!Utils::GetDfdLayout(image.Format, layout) || image.Levels.empty())
+	{
+		std::cout << "Ktx2: unsupported format or empty image for " << path << "\n";
+		return false;
+	}
+
+	std::vector<uint32_t> dfd = Utils::BuildDfd(layout);
+	uint32_t levelCount = (uint32_t)image.Levels.size();
+
+	// Identifier, header, section index, then the level index
+	uint64_t headerSize = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+	uint64_t dfdOffset = headerSize + levelCount * 3 * 8;
+	uint64_t dataOffset = dfdOffset + dfd.size() * 4;
+
+	// Level data is stored smallest first, each level aligned to lcm(block size, 4)
+	uint64_t alignment = layout.BlockBytes % 4 == 0 ? layout.BlockBytes : layout.BlockBytes * 4;
+	std::vector<uint64_t> levelOffsets(levelCount);
+	uint64_t offset = dataOffset;
+	for (uint32_t level = levelCount; level-- > 0;)
+	{
+		offset = Utils::AlignUp(offset, alignment);
+		levelOffsets[level] = offset;
+		offset += image.Levels[level].size();
+	}
+
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cout << "Ktx2: could not open " << path << " for writing\n";
+		return false;
+	}
+
+	stream.write((const char*)g_Ktx2Identifier, sizeof(g_Ktx2Identifier));
+	Utils::WriteValue<uint32_t>(stream, (uint32_t)image.Format);
+	Utils::WriteValue<uint32_t>(stream, layout.TypeSize);
+	Utils::WriteValue<uint32_t>(stream, image.Width);
+	Utils::WriteValue<uint32_t>(stream, image.Height);
+	Utils::WriteValue<uint32_t>(stream, 0); // pixelDepth
+	Utils::WriteValue<uint32_t>(stream, image.LayerCount);
+	Utils::WriteValue<uint32_t>(stream, 1); // faceCount
+	Utils::WriteValue<uint32_t>(stream, levelCount);
+	Utils::WriteValue<uint32_t>(stream, 0); // supercompressionScheme
+
+	Utils::WriteValue<uint32_t>(stream, (uint32_t)dfdOffset);
+	Utils::WriteValue<uint32_t>(stream, (uint32_t)(dfd.size() * 4));
+	Utils::WriteValue<uint32_t>(stream, 0); // kvdByteOffset
+	Utils::WriteValue<uint32_t>(stream, 0); // kvdByteLength
+	Utils::WriteValue<uint64_t>(stream, 0); // sgdByteOffset
+	Utils::WriteValue<uint64_t>(stream, 0); // sgdByteLength
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		Utils::WriteValue<uint64_t>(stream, levelOffsets[level]);
+		Utils::WriteValue<uint64_t>(stream, image.Levels[level].size());
+		Utils::WriteValue<uint64_t>(stream, image.Levels[level].size());
+	}
+
+	stream.write((const char*)dfd.data(), dfd.size() * 4);
+
+	uint64_t position = dataOffset;
+	for (uint32_t level = levelCount; level-- > 0;)
+	{
+		static const char padding[16] = {};
+		stream.write(padding, levelOffsets[level] - position);
+		stream.write((const char*)image.Levels[level].data(), image.Levels[level].size());
+		position = levelOffsets[level] + image.Levels[level].size();
+	}
+
+	return (bool)stream;
+}
+
+bool Ktx2::Parse(const uint8_t* data, uint64_t size, Ktx2View& view)
+{
+	const uint64_t headerSize = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+	if (size < headerSize || memcmp(data, g_Ktx2Identifier, sizeof(g_Ktx2Identifier)) != 0)
+	{
+		std::cout << "Ktx2: not a KTX2 file\n";
+		return false;
+	}
+
+	VkFormat format = (VkFormat)Utils::ReadValue<uint32_t>(data, 12);
+	uint32_t width = Utils::ReadValue<uint32_t>(data, 20);
+	uint32_t height = Utils::ReadValue<uint32_t>(data, 24);
+	uint32_t depth = Utils::ReadValue<uint32_t>(data, 28);
+	uint32_t layerCount = Utils::ReadValue<uint32_t>(data, 32);
+	uint32_t faceCount = Utils::ReadValue<uint32_t>(data, 36);
+	uint32_t levelCount = Utils::ReadValue<uint32_t>(data, 40);
+	uint32_t supercompression = Utils::ReadValue<uint32_t>(data, 44);
+
+	if (format == VK_FORMAT_UNDEFINED || supercompression != 0)
+	{
+		std::cout << "Ktx2: Basis/supercompressed payloads are not supported\n";
+		return false;
+	}
+
+	if (width == 0 || height == 0 || depth > 1 || faceCount != 1)
+	{
+		std::cout << "Ktx2: only 2D textures and 2D arrays are supported\n";
+		return false;
+	}
+
+	// levelCount 0 asks the loader to generate mips, we just take the base level
+	uint32_t storedLevels = levelCount == 0 ? 1 : levelCount;
+	if (size < headerSize + storedLevels * 3 * 8)
+	{
+		std::cout << "Ktx2: truncated level index\n";
+		return false;
+	}
+
+	view.Format = format;
+	view.Width = width;
+	view.Height = height;
+	view.LayerCount = layerCount == 0 ? 1 : layerCount;
+	view.Levels.resize(storedLevels);
+
+	for (uint32_t level = 0; level < storedLevels; level++)
+	{
+		Ktx2Level& entry = view.Levels[level];
+		entry.Offset = Utils::ReadValue<uint64_t>(data, headerSize + level * 24);
+		entry.Length = Utils::ReadValue<uint64_t>(data, headerSize + level * 24 + 8);
+		if (entry.Length == 0 || entry.Offset > size || entry.Length > size - entry.Offset)
+		{
+			std::cout << "Ktx2: level " << level << " lies outside the file\n";
+			return false;
+		}
+	}
+
+	return true;
+}
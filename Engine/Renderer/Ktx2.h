@@ -0,0 +1,45 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Minimal KTX2 (Khronos texture container v2) support. Only what the texture cooker emits:
+// 2D images, optional array layers, no supercompression, no cube maps.
+struct Ktx2Image
+{
+	VkFormat Format = VK_FORMAT_UNDEFINED;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	// 0 for a plain 2D texture, as in the file header
+	uint32_t LayerCount = 0;
+	// Index 0 is the full size level, each entry holds every layer of that level back to back
+	std::vector<std::vector<uint8_t>> Levels;
+};
+
+struct Ktx2Level
+{
+	// Byte range of the level inside the file, every layer back to back
+	uint64_t Offset = 0;
+	uint64_t Length = 0;
+};
+
+// Parsed header of a KTX2 file that stays in memory (usually a MappedFile), no pixel data is copied
+struct Ktx2View
+{
+	VkFormat Format = VK_FORMAT_UNDEFINED;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	// At least 1, unlike the header field
+	uint32_t LayerCount = 1;
+	std::vector<Ktx2Level> Levels;
+};
+
+class Ktx2
+{
+public:
+	static bool Write(const std::string& path, const Ktx2Image& image);
+
+	// Validates the header and level index of an in memory file
+	static bool Parse(const uint8_t* data, uint64_t size, Ktx2View& view);
+};
@@ -0,0 +1,115 @@
+#include "MipGenerator.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MIPGENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+uint32_t MipGenerator::GetMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t largest = width > height ? width : height;
+	uint32_t levels = 1;
+	while (largest > 1)
+	{
+		largest >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+uint32_t MipGenerator::GetMipDimension(uint32_t baseDimension, uint32_t level)
+{
+	uint32_t dimension = baseDimension >> level;
+	return dimension > 0 ? dimension : 1;
+}
+
+uint64_t MipGenerator::GetMipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	uint64_t size = 0;
+	for (uint32_t level = 1; level < mipLevels; level++)
+	{
+		size += (uint64_t)GetMipDimension(width, level) * GetMipDimension(height, level) * 4;
+	}
+	return size;
+}
+
+static void DownsampleRowScalar(const uint8_t* row0, const uint8_t* row1, uint32_t srcWidth, uint32_t dstBegin, uint32_t dstEnd, uint8_t* dst)
+{
+	for (uint32_t x = dstBegin; x < dstEnd; x++)
+	{
+		uint32_t x0 = x * 2;
+		uint32_t x1 = x0 + 1 < srcWidth ? x0 + 1 : srcWidth - 1;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			uint32_t sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+			dst[x * 4 + c] = (uint8_t)((sum + 2) >> 2);
+		}
+	}
+}
+
+void MipGenerator::DownsampleRGBA8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst)
+{
+	uint32_t dstWidth = GetMipDimension(srcWidth, 1);
+	uint32_t dstHeight = GetMipDimension(srcHeight, 1);
+	uint32_t srcStride = srcWidth * 4;
+
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		uint32_t y0 = y * 2;
+		uint32_t y1 = y0 + 1 < srcHeight ? y0 + 1 : srcHeight - 1;
+		const uint8_t* row0 = src + (uint64_t)y0 * srcStride;
+		const uint8_t* row1 = src + (uint64_t)y1 * srcStride;
+		uint8_t* dstRow = dst + (uint64_t)y * dstWidth * 4;
+
+		uint32_t x = 0;
+#ifdef MIPGENERATOR_SSE2
+		// Single column sources need the clamped scalar path
+		if (srcWidth >= 2)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i two = _mm_set1_epi16(2);
+
+			// 8 source texels from each row -> 4 destination texels per iteration
+			for (; x + 4 <= dstWidth; x += 4)
+			{
+				__m128i a0 = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+				__m128i a1 = _mm_loadu_si128((const __m128i*)(row0 + x * 8 + 16));
+				__m128i b0 = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+				__m128i b1 = _mm_loadu_si128((const __m128i*)(row1 + x * 8 + 16));
+
+				// Vertical sums, two texels per register
+				__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+				__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+				__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+				__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+				// Horizontal pairs: [t0 + t1, t2 + t3] and [t4 + t5, t6 + t7]
+				__m128i d01 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+				__m128i d23 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+
+				d01 = _mm_srli_epi16(_mm_add_epi16(d01, two), 2);
+				d23 = _mm_srli_epi16(_mm_add_epi16(d23, two), 2);
+
+				_mm_storeu_si128((__m128i*)(dstRow + x * 4), _mm_packus_epi16(d01, d23));
+			}
+		}
+#endif
+		DownsampleRowScalar(row0, row1, srcWidth, x, dstWidth, dstRow);
+	}
+}
+
+void MipGenerator::GenerateMipChainRGBA8(const uint8_t* level0, uint32_t width, uint32_t height, uint32_t mipLevels, uint8_t* chain)
+{
+	const uint8_t* src = level0;
+	uint8_t* dst = chain;
+
+	for (uint32_t level = 1; level < mipLevels; level++)
+	{
+		uint32_t srcWidth = GetMipDimension(width, level - 1);
+		uint32_t srcHeight = GetMipDimension(height, level - 1);
+		DownsampleRGBA8(src, srcWidth, srcHeight, dst);
+
+		src = dst;
+		dst += (uint64_t)GetMipDimension(width, level) * GetMipDimension(height, level) * 4;
+	}
+}
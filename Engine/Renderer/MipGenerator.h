@@ -0,0 +1,20 @@
+#pragma once
+#include <stdint.h>
+
+class MipGenerator
+{
+public:
+	// floor(log2(max(width, height))) + 1
+	static uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+	static uint32_t GetMipDimension(uint32_t baseDimension, uint32_t level);
+
+	// Bytes of levels [1, mipLevels) for a 4 byte per texel format
+	static uint64_t GetMipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// 2x2 box filter of an RGBA8 image into a half sized one, SSE2 when available
+	static void DownsampleRGBA8(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst);
+
+	// Writes levels [1, mipLevels) of level0 tightly packed one after the other into chain
+	static void GenerateMipChainRGBA8(const uint8_t* level0, uint32_t width, uint32_t height, uint32_t mipLevels, uint8_t* chain);
+};
@@ -0,0 +1,226 @@
+#include "OneShotSubmitter.h"
+
+#include "GpuCompletionTracker.h"
+
+#include "../AstranEditorUI.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct ThreadCommandPool
+{
+	VkCommandPool pool = VK_NULL_HANDLE;
+	// Buffers whose batch retired, pushed by the render thread and reused by the owning thread
+	std::mutex mutex;
+	std::vector<VkCommandBuffer> freeCommandBuffers;
+};
+
+struct OneShotCommandBuffer
+{
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	ThreadCommandPool* owner = nullptr;
+};
+
+struct OneShotBatch
+{
+	uint64_t id = 0;
+	// GpuCompletionTracker value of the submit
+	uint64_t value = 0;
+	std::vector<OneShotCommandBuffer> commandBuffers;
+};
+
+static std::mutex                                      g_Mutex;
+static std::vector<std::unique_ptr<ThreadCommandPool>> g_Pools;
+static std::vector<OneShotCommandBuffer>               g_Pending;
+
+static std::deque<OneShotBatch>                        g_InFlightBatches;
+static uint64_t                                        g_NextBatchId = 1;
+static std::atomic<uint64_t>                           g_CompletedBatchId{ 0 };
+
+// Bumped by Initialize so pools cached by threads before a Shutdown are not reused
+static uint32_t                                        g_Generation = 0;
+static thread_local ThreadCommandPool*                 t_Pool = nullptr;
+static thread_local uint32_t                           t_Generation = 0;
+
+namespace Utils {
+
+	static ThreadCommandPool* GetThreadPool()
+	{
+		std::lock_guard<std::mutex> lock(g_Mutex);
+		if (t_Pool && t_Generation == g_Generation)
+			return t_Pool;
+
+		std::unique_ptr<ThreadCommandPool> pool = std::make_unique<ThreadCommandPool>();
+
+		// Reset per buffer so retired buffers go back to work without resetting the whole pool
+		VkCommandPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		pool_info.queueFamilyIndex = AstranEditorUI::GetQueueFamily();
+		VkResult err = vkCreateCommandPool(AstranEditorUI::GetDevice(), &pool_info, nullptr, &pool->pool);
+		check_vk_result(err);
+
+		t_Pool = pool.get();
+		t_Generation = g_Generation;
+		g_Pools.push_back(std::move(pool));
+		return t_Pool;
+	}
+
+}
+
+void OneShotSubmitter::Initialize()
+{
+	g_Generation++;
+	g_NextBatchId = 1;
+	g_CompletedBatchId = 0;
+}
+
+void OneShotSubmitter::Shutdown()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	Flush();
+	Wait(g_NextBatchId - 1);
+
+	// Frees every command buffer allocated from them
+	for (std::unique_ptr<ThreadCommandPool>& pool : g_Pools)
+	{
+		vkDestroyCommandPool(device, pool->pool, nullptr);
+	}
+	g_Pools.clear();
+}
+
+VkCommandBuffer OneShotSubmitter::Begin()
+{
+	ThreadCommandPool* pool = Utils::GetThreadPool();
+	VkResult err;
+
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		if (!pool->freeCommandBuffers.empty())
+		{
+			commandBuffer = pool->freeCommandBuffers.back();
+			pool->freeCommandBuffers.pop_back();
+		}
+	}
+
+	if (!commandBuffer)
+	{
+		VkCommandBufferAllocateInfo allocate_info = {};
+		allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocate_info.commandPool = pool->pool;
+		allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocate_info.commandBufferCount = 1;
+		err = vkAllocateCommandBuffers(AstranEditorUI::GetDevice(), &allocate_info, &commandBuffer);
+		check_vk_result(err);
+	}
+
+	// Implicitly resets a recycled buffer, the pool was created with RESET_COMMAND_BUFFER_BIT
+	VkCommandBufferBeginInfo begin_info = {};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	err = vkBeginCommandBuffer(commandBuffer, &begin_info);
+	check_vk_result(err);
+
+	return commandBuffer;
+}
+
+uint64_t OneShotSubmitter::End(VkCommandBuffer commandBuffer)
+{
+	VkResult err = vkEndCommandBuffer(commandBuffer);
+	check_vk_result(err);
+
+	ThreadCommandPool* pool = Utils::GetThreadPool();
+
+	std::lock_guard<std::mutex> lock(g_Mutex);
+	OneShotCommandBuffer pending;
+	pending.commandBuffer = commandBuffer;
+	pending.owner = pool;
+	g_Pending.push_back(pending);
+	return g_NextBatchId;
+}
+
+void OneShotSubmitter::SubmitFrame()
+{
+	Flush();
+	RetireCompletedBatches();
+}
+
+bool OneShotSubmitter::IsComplete(uint64_t token)
+{
+	if (token <= g_CompletedBatchId)
+		return true;
+
+	RetireCompletedBatches();
+	return token <= g_CompletedBatchId;
+}
+
+void OneShotSubmitter::Wait(uint64_t token)
+{
+	if (IsComplete(token))
+		return;
+
+	if (token >= g_NextBatchId)
+	{
+		Flush();
+	}
+
+	while (!g_InFlightBatches.empty() && g_InFlightBatches.front().id <= token)
+	{
+		GpuCompletionTracker::Wait(g_InFlightBatches.front().value);
+		RetireCompletedBatches();
+	}
+}
+
+void OneShotSubmitter::Flush()
+{
+	OneShotBatch batch;
+	{
+		std::lock_guard<std::mutex> lock(g_Mutex);
+		if (g_Pending.empty())
+			return;
+
+		batch.id = g_NextBatchId++;
+		batch.commandBuffers.swap(g_Pending);
+	}
+
+	std::vector<VkCommandBuffer> commandBuffers;
+	commandBuffers.reserve(batch.commandBuffers.size());
+	for (const OneShotCommandBuffer& pending : batch.commandBuffers)
+	{
+		commandBuffers.push_back(pending.commandBuffer);
+	}
+
+	// Recorded in the order End was called, which is the order they execute in
+	VkSubmitInfo submit_info = {};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = (uint32_t)commandBuffers.size();
+	submit_info.pCommandBuffers = commandBuffers.data();
+	batch.value = GpuCompletionTracker::Submit(AstranEditorUI::GetQueue(), submit_info);
+
+	g_InFlightBatches.push_back(std::move(batch));
+}
+
+void OneShotSubmitter::RetireCompletedBatches()
+{
+	// One queue, so batches finish in submission order
+	while (!g_InFlightBatches.empty())
+	{
+		OneShotBatch& batch = g_InFlightBatches.front();
+		if (!GpuCompletionTracker::IsComplete(batch.value))
+			break;
+
+		for (const OneShotCommandBuffer& done : batch.commandBuffers)
+		{
+			std::lock_guard<std::mutex> lock(done.owner->mutex);
+			done.owner->freeCommandBuffers.push_back(done.commandBuffer);
+		}
+
+		g_CompletedBatchId = batch.id;
+		g_InFlightBatches.pop_front();
+	}
+}
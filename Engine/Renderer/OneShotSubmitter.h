@@ -0,0 +1,34 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+// One-shot command buffers for work outside the frame's own command buffer (copies, layout changes).
+// Every thread records into its own transient pool and buffers are recycled once their batch retires.
+// Everything ended during a frame goes out in a single vkQueueSubmit from SubmitFrame, callers get
+// a token to poll or wait on instead of blocking. Completion comes from the GpuCompletionTracker.
+// Begin and End may be called from any thread, the rest is render thread only.
+class OneShotSubmitter
+{
+public:
+	static void Initialize();
+	// The device must be idle
+	static void Shutdown();
+
+	// A begun primary command buffer from the calling thread's pool
+	static VkCommandBuffer Begin();
+	// Ends commandBuffer and queues it for the next batch. Must be called on the thread that began it.
+	// Returns the token of that batch.
+	static uint64_t End(VkCommandBuffer commandBuffer);
+
+	// Call once per frame before the frame's own queue submit, after UploadManager::SubmitFrame
+	static void SubmitFrame();
+
+	// Token 0 is always complete
+	static bool IsComplete(uint64_t token);
+	// Submits the pending batch early if token belongs to it
+	static void Wait(uint64_t token);
+
+private:
+	static void Flush();
+	static void RetireCompletedBatches();
+};
@@ -0,0 +1,168 @@
+#include "PipelineCache.h"
+
+#include "../AstranEditorUI.h"
+#include "../Core/MappedFile.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static VkPipelineCache                       g_Cache = VK_NULL_HANDLE;
+static std::string                           g_Path;
+// Data last loaded or saved, saves are skipped while the cache still matches it
+static std::vector<uint8_t>                  g_SavedData;
+static std::chrono::steady_clock::time_point g_NextSave;
+
+namespace Utils {
+
+	static const std::chrono::seconds g_SaveInterval(30);
+
+	// VkPipelineCacheHeaderVersionOne, read field by field so struct packing never matters
+	static bool IsCompatible(const uint8_t* data, size_t size)
+	{
+		if (size < 16 + VK_UUID_SIZE)
+			return false;
+
+		uint32_t headerSize, headerVersion, vendorID, deviceID;
+		memcpy(&headerSize, data, 4);
+		memcpy(&headerVersion, data + 4, 4);
+		memcpy(&vendorID, data + 8, 4);
+		memcpy(&deviceID, data + 12, 4);
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(AstranEditorUI::GetPhysicalDevice(), &properties);
+
+		return headerSize >= 16 + VK_UUID_SIZE && headerSize <= size
+			&& headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& vendorID == properties.vendorID
+			&& deviceID == properties.deviceID
+			&& memcmp(data + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+}
+
+void PipelineCache::Initialize(const std::string& path)
+{
+	g_Path = path;
+	g_SavedData.clear();
+	g_NextSave = std::chrono::steady_clock::now() + Utils::g_SaveInterval;
+
+	MappedFile file;
+	const uint8_t* initialData = nullptr;
+	size_t initialSize = 0;
+	// Nothing saved yet on first launch
+	if (file.Open(g_Path, FileAccess::Sequential, false))
+	{
+		if (Utils::IsCompatible(file.GetData(), (size_t)file.GetSize()))
+		{
+			initialData = file.GetData();
+			initialSize = (size_t)file.GetSize();
+		}
+		else
+		{
+			// Other GPU or driver update, the next save replaces it
+			std::cout << "[pipeline cache] " << g_Path << " was written for another device or driver, starting empty\n";
+		}
+	}
+
+	VkPipelineCacheCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	info.initialDataSize = initialSize;
+	info.pInitialData = initialData;
+	VkResult err = vkCreatePipelineCache(AstranEditorUI::GetDevice(), &info, nullptr, &g_Cache);
+	if (err != VK_SUCCESS && initialData)
+	{
+		// Drivers may still reject data that passed the header check
+		info.initialDataSize = 0;
+		info.pInitialData = nullptr;
+		err = vkCreatePipelineCache(AstranEditorUI::GetDevice(), &info, nullptr, &g_Cache);
+		initialData = nullptr;
+		initialSize = 0;
+	}
+	check_vk_result(err);
+
+	if (initialData)
+	{
+		g_SavedData.assign(initialData, initialData + initialSize);
+		std::cout << "[pipeline cache] loaded " << initialSize << " bytes from " << g_Path << "\n";
+	}
+}
+
+void PipelineCache::Shutdown()
+{
+	if (!g_Cache)
+		return;
+
+	Save();
+	vkDestroyPipelineCache(AstranEditorUI::GetDevice(), g_Cache, nullptr);
+	g_Cache = VK_NULL_HANDLE;
+	g_SavedData = std::vector<uint8_t>();
+}
+
+void PipelineCache::Update()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now < g_NextSave)
+		return;
+
+	g_NextSave = now + Utils::g_SaveInterval;
+	Save();
+}
+
+void PipelineCache::Save()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	size_t size = 0;
+	VkResult err = vkGetPipelineCacheData(device, g_Cache, &size, nullptr);
+	check_vk_result(err);
+	if (size == 0)
+		return;
+
+	std::vector<uint8_t> data(size);
+	err = vkGetPipelineCacheData(device, g_Cache, &size, data.data());
+	check_vk_result(err);
+	data.resize(size);
+
+	// Nothing compiled since the last save
+	if (data == g_SavedData)
+		return;
+
+	std::error_code error;
+	std::filesystem::path path(g_Path);
+	if (path.has_parent_path())
+		std::filesystem::create_directories(path.parent_path(), error);
+
+	std::string temporaryPath = g_Path + ".tmp";
+	{
+		std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+		stream.write((const char*)data.data(), data.size());
+		if (!stream)
+		{
+			std::cout << "[pipeline cache] could not write " << temporaryPath << "\n";
+			stream.close();
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+	}
+
+	// A crash mid save leaves the previous file intact
+	std::filesystem::rename(temporaryPath, g_Path, error);
+	if (error)
+	{
+		std::cout << "[pipeline cache] could not replace " << g_Path << ": " << error.message() << "\n";
+		std::filesystem::remove(temporaryPath, error);
+		return;
+	}
+
+	g_SavedData.swap(data);
+	std::cout << "[pipeline cache] saved " << size << " bytes to " << g_Path << "\n";
+}
+
+VkPipelineCache PipelineCache::Get()
+{
+	return g_Cache;
+}
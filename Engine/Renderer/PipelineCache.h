@@ -0,0 +1,23 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+
+// The one VkPipelineCache every pipeline is created with, persisted to disk so later launches skip
+// shader compilation. The file is only used when its header matches this device and driver
+// (vendor, device id and pipelineCacheUUID), anything else starts an empty cache.
+// Render thread only.
+class PipelineCache
+{
+public:
+	// Loads path if it is valid for the device, defaults to ../Intermediate/PipelineCache.bin
+	static void Initialize(const std::string& path = "../Intermediate/PipelineCache.bin");
+	// Saves and destroys the cache, no pipeline may be created after this
+	static void Shutdown();
+
+	// Saves every 30 seconds when pipelines were added since the last save, call once per frame
+	static void Update();
+	// Writes the cache to disk if its contents changed since it was loaded or last saved
+	static void Save();
+
+	static VkPipelineCache Get();
+};
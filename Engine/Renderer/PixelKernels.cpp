@@ -0,0 +1,433 @@
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIXELKERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define PIXELKERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// MSVC compiles any intrinsic, GCC/Clang need the ISA enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define PIXELKERNELS_TARGET(isa) __attribute__((target(isa)))
+#else
+#define PIXELKERNELS_TARGET(isa)
+#endif
+
+using InstructionSet = PixelKernels::InstructionSet;
+
+static std::atomic<bool> g_ForceScalar{ false };
+
+namespace Utils {
+
+	static InstructionSet DetectInstructionSet()
+	{
+#if defined(PIXELKERNELS_X86)
+		uint32_t leaf1[4] = {};
+		uint32_t leaf7[4] = {};
+#ifdef _MSC_VER
+		__cpuid((int*)leaf1, 1);
+		__cpuidex((int*)leaf7, 7, 0);
+#else
+		__get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+		__get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+#endif
+		bool sse2 = (leaf1[3] & (1u << 26)) != 0;
+		bool ssse3 = (leaf1[2] & (1u << 9)) != 0;
+		bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+		bool avx = (leaf1[2] & (1u << 28)) != 0;
+		bool avx2 = (leaf7[1] & (1u << 5)) != 0;
+
+		// AVX registers are only usable when the OS saves them on context switches
+		bool osAvx = false;
+		if (osxsave && avx)
+		{
+#ifdef _MSC_VER
+			uint64_t xcr0 = _xgetbv(0);
+#else
+			uint32_t lo, hi;
+			__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+			uint64_t xcr0 = ((uint64_t)hi << 32) | lo;
+#endif
+			osAvx = (xcr0 & 6) == 6;
+		}
+
+		if (avx2 && osAvx)
+			return InstructionSet::AVX2;
+		if (ssse3)
+			return InstructionSet::SSSE3;
+		if (sse2)
+			return InstructionSet::SSE2;
+#elif defined(PIXELKERNELS_NEON)
+		return InstructionSet::NEON;
+#endif
+		return InstructionSet::Scalar;
+	}
+
+	// F16C is its own CPUID bit, it comes with every AVX2 part but is checked on its own
+	static bool DetectHardwareHalf()
+	{
+#if defined(PIXELKERNELS_X86)
+		uint32_t leaf1[4] = {};
+#ifdef _MSC_VER
+		__cpuid((int*)leaf1, 1);
+#else
+		__get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+#endif
+		bool f16c = (leaf1[2] & (1u << 29)) != 0;
+		// Same OS support requirement as AVX2, which GetInstructionSet already checked
+		return f16c && PixelKernels::GetInstructionSet() == InstructionSet::AVX2;
+#elif defined(PIXELKERNELS_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	static InstructionSet Active()
+	{
+		return g_ForceScalar.load() ? InstructionSet::Scalar : PixelKernels::GetInstructionSet();
+	}
+
+	// ---- RGB -> RGBA ----
+
+	static void ExpandRGBToRGBAScalar(const uint8_t* rgb, uint8_t* rgba, size_t begin, size_t count)
+	{
+		for (size_t i = begin; i < count; i++)
+		{
+			rgba[i * 4 + 0] = rgb[i * 3 + 0];
+			rgba[i * 4 + 1] = rgb[i * 3 + 1];
+			rgba[i * 4 + 2] = rgb[i * 3 + 2];
+			rgba[i * 4 + 3] = 255;
+		}
+	}
+
+#if defined(PIXELKERNELS_X86)
+	PIXELKERNELS_TARGET("ssse3")
+	static size_t ExpandRGBToRGBASSSE3(const uint8_t* rgb, uint8_t* rgba, size_t count)
+	{
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+		// 4 pixels per step, the 16 byte load reads 4 bytes past them so stop early
+		size_t i = 0;
+		for (; i + 6 <= count; i += 4)
+		{
+			__m128i source = _mm_loadu_si128((const __m128i*)(rgb + i * 3));
+			_mm_storeu_si128((__m128i*)(rgba + i * 4), _mm_or_si128(_mm_shuffle_epi8(source, shuffle), alpha));
+		}
+		return i;
+	}
+
+	PIXELKERNELS_TARGET("avx2")
+	static size_t ExpandRGBToRGBAAVX2(const uint8_t* rgb, uint8_t* rgba, size_t count)
+	{
+		const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+		// 8 pixels per step as two 12 byte groups, one per 128 bit lane
+		size_t i = 0;
+		for (; i + 10 <= count; i += 8)
+		{
+			__m128i lo = _mm_loadu_si128((const __m128i*)(rgb + i * 3));
+			__m128i hi = _mm_loadu_si128((const __m128i*)(rgb + i * 3 + 12));
+			__m256i source = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+			_mm256_storeu_si256((__m256i*)(rgba + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(source, shuffle), alpha));
+		}
+		return i;
+	}
+#endif
+
+	static void ExpandRGBToRGBA(InstructionSet set, const uint8_t* rgb, uint8_t* rgba, size_t count)
+	{
+		size_t done = 0;
+#if defined(PIXELKERNELS_X86)
+		if (set == InstructionSet::AVX2)
+			done = ExpandRGBToRGBAAVX2(rgb, rgba, count);
+		else if (set == InstructionSet::SSSE3)
+			done = ExpandRGBToRGBASSSE3(rgb, rgba, count);
+#elif defined(PIXELKERNELS_NEON)
+		if (set == InstructionSet::NEON)
+		{
+			for (; done + 16 <= count; done += 16)
+			{
+				uint8x16x3_t source = vld3q_u8(rgb + done * 3);
+				uint8x16x4_t result;
+				result.val[0] = source.val[0];
+				result.val[1] = source.val[1];
+				result.val[2] = source.val[2];
+				result.val[3] = vdupq_n_u8(255);
+				vst4q_u8(rgba + done * 4, result);
+			}
+		}
+#endif
+		ExpandRGBToRGBAScalar(rgb, rgba, done, count);
+	}
+
+	// ---- float <-> half ----
+
+	static uint16_t FloatToHalfScalar(float value)
+	{
+		const uint32_t infinity = 255u << 23;
+		const uint32_t halfOverflow = (127u + 16u) << 23;
+		const uint32_t denormalMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+		uint32_t bits;
+		memcpy(&bits, &value, 4);
+		uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+
+		uint32_t half;
+		if (bits >= halfOverflow)
+		{
+			// NaNs are quieted and keep the top of their payload, as F16C and NEON do
+			half = bits > infinity ? 0x7E00 | ((bits >> 13) & 0x3FF) : 0x7C00;
+		}
+		else if (bits < (113u << 23))
+		{
+			// Subnormal or zero, let the FPU do the rounding shift
+			float magic;
+			memcpy(&magic, &denormalMagic, 4);
+			float shifted;
+			memcpy(&shifted, &bits, 4);
+			shifted += magic;
+			memcpy(&bits, &shifted, 4);
+			half = bits - denormalMagic;
+		}
+		else
+		{
+			uint32_t mantissaOdd = (bits >> 13) & 1;
+			bits += ((uint32_t)(15 - 127) << 23) + 0xFFF + mantissaOdd;
+			half = bits >> 13;
+		}
+
+		return (uint16_t)(half | (sign >> 16));
+	}
+
+	static float HalfToFloatScalar(uint16_t half)
+	{
+		uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+		uint32_t exponent = (half >> 10) & 0x1F;
+		uint32_t mantissa = half & 0x3FF;
+
+		uint32_t bits;
+		if (exponent == 0)
+		{
+			float value = mantissa * (1.0f / 16777216.0f);
+			memcpy(&bits, &value, 4);
+			bits |= sign;
+		}
+		else if (exponent == 31)
+		{
+			bits = sign | 0x7F800000u | (mantissa << 13);
+		}
+		else
+		{
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		}
+
+		float value;
+		memcpy(&value, &bits, 4);
+		return value;
+	}
+
+#if defined(PIXELKERNELS_X86)
+	PIXELKERNELS_TARGET("avx,f16c")
+	static size_t FloatToHalfF16C(const float* source, uint16_t* destination, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+			_mm_storeu_si128((__m128i*)(destination + i), half);
+		}
+		return i;
+	}
+
+	PIXELKERNELS_TARGET("avx,f16c")
+	static size_t HalfToFloatF16C(const uint16_t* source, float* destination, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_ps(destination + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(source + i))));
+		}
+		return i;
+	}
+#endif
+
+	static void FloatToHalf(bool hardware, const float* source, uint16_t* destination, size_t count)
+	{
+		size_t done = 0;
+		if (hardware)
+		{
+#if defined(PIXELKERNELS_X86)
+			done = FloatToHalfF16C(source, destination, count);
+#elif defined(PIXELKERNELS_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+			for (; done + 4 <= count; done += 4)
+			{
+				vst1_u16(destination + done, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(source + done))));
+			}
+#endif
+		}
+
+		for (size_t i = done; i < count; i++)
+		{
+			destination[i] = FloatToHalfScalar(source[i]);
+		}
+	}
+
+	static void HalfToFloat(bool hardware, const uint16_t* source, float* destination, size_t count)
+	{
+		size_t done = 0;
+		if (hardware)
+		{
+#if defined(PIXELKERNELS_X86)
+			done = HalfToFloatF16C(source, destination, count);
+#elif defined(PIXELKERNELS_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+			for (; done + 4 <= count; done += 4)
+			{
+				vst1q_f32(destination + done, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(source + done))));
+			}
+#endif
+		}
+
+		for (size_t i = done; i < count; i++)
+		{
+			destination[i] = HalfToFloatScalar(source[i]);
+		}
+	}
+
+}
+
+PixelKernels::InstructionSet PixelKernels::GetInstructionSet()
+{
+	static const InstructionSet set = Utils::DetectInstructionSet();
+	return set;
+}
+
+const char* PixelKernels::GetInstructionSetName(InstructionSet set)
+{
+	switch (set)
+	{
+	case InstructionSet::Scalar: return "Scalar";
+	case InstructionSet::SSE2:   return "SSE2";
+	case InstructionSet::SSSE3:  return "SSSE3";
+	case InstructionSet::AVX2:   return "AVX2";
+	case InstructionSet::NEON:   return "NEON";
+	}
+	return "Unknown";
+}
+
+void PixelKernels::SetForceScalar(bool forceScalar)
+{
+	g_ForceScalar = forceScalar;
+}
+
+void PixelKernels::ExpandRGBToRGBA(const uint8_t* rgb, uint8_t* rgba, size_t pixelCount)
+{
+	Utils::ExpandRGBToRGBA(Utils::Active(), rgb, rgba, pixelCount);
+}
+
+void PixelKernels::ExpandGreyToRGBA(const uint8_t* grey, uint32_t channels, uint8_t* rgba, size_t pixelCount)
+{
+	// Rare in practice, plain loops the compiler vectorizes well enough
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		uint8_t value = grey[i * channels];
+		rgba[i * 4 + 0] = value;
+		rgba[i * 4 + 1] = value;
+		rgba[i * 4 + 2] = value;
+		rgba[i * 4 + 3] = channels == 2 ? grey[i * 2 + 1] : 255;
+	}
+}
+
+void PixelKernels::FlipVertical(uint8_t* pixels, size_t rowBytes, uint32_t rows)
+{
+	// memcpy is already vectorized, swapping through a small stack buffer avoids an allocation
+	uint8_t scratch[4096];
+	for (uint32_t row = 0; row < rows / 2; row++)
+	{
+		uint8_t* top = pixels + (size_t)row * rowBytes;
+		uint8_t* bottom = pixels + (size_t)(rows - 1 - row) * rowBytes;
+		for (size_t offset = 0; offset < rowBytes; offset += sizeof(scratch))
+		{
+			size_t bytes = std::min(sizeof(scratch), rowBytes - offset);
+			memcpy(scratch, top + offset, bytes);
+			memcpy(top + offset, bottom + offset, bytes);
+			memcpy(bottom + offset, scratch, bytes);
+		}
+	}
+}
+
+void PixelKernels::FloatToHalf(const float* source, uint16_t* destination, size_t count)
+{
+	Utils::FloatToHalf(HasHardwareHalf() && !g_ForceScalar.load(), source, destination, count);
+}
+
+void PixelKernels::HalfToFloat(const uint16_t* source, float* destination, size_t count)
+{
+	Utils::HalfToFloat(HasHardwareHalf() && !g_ForceScalar.load(), source, destination, count);
+}
+
+bool PixelKernels::HasHardwareHalf()
+{
+	static const bool hardware = Utils::DetectHardwareHalf();
+	return hardware;
+}
+
+std::vector<PixelKernels::BenchmarkResult> PixelKernels::Benchmark(size_t pixelCount)
+{
+	std::vector<uint8_t> rgb(pixelCount * 3);
+	std::vector<uint8_t> rgba(pixelCount * 4);
+	std::vector<float> values(pixelCount * 4);
+	std::vector<uint16_t> half(pixelCount * 4);
+	for (size_t i = 0; i < rgb.size(); i++)
+		rgb[i] = (uint8_t)(i * 2654435761u >> 13);
+	for (size_t i = 0; i < values.size(); i++)
+		values[i] = rgb[i % rgb.size()] / 255.0f;
+
+	InstructionSet simd = GetInstructionSet();
+
+	// Best of a few runs, reported in megapixels per second
+	auto measure = [&](const std::function<void(InstructionSet)>& kernel, InstructionSet set)
+	{
+		double best = 1e30;
+		for (int run = 0; run < 5; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			kernel(set);
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			best = std::min(best, seconds);
+		}
+		return pixelCount / best / 1e6;
+	};
+
+	std::vector<BenchmarkResult> results;
+	auto run = [&](const char* name, const std::function<void(InstructionSet)>& kernel)
+	{
+		BenchmarkResult result;
+		result.Kernel = name;
+		result.Simd = simd;
+		result.ScalarMPixels = measure(kernel, InstructionSet::Scalar);
+		result.SimdMPixels = measure(kernel, simd);
+		results.push_back(result);
+	};
+
+	run("RGB->RGBA", [&](InstructionSet set) { Utils::ExpandRGBToRGBA(set, rgb.data(), rgba.data(), pixelCount); });
+	run("float->half", [&](InstructionSet set) { Utils::FloatToHalf(set != InstructionSet::Scalar && HasHardwareHalf(), values.data(), half.data(), pixelCount * 4); });
+	return results;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Pixel format conversions used on every decoded image before it is uploaded.
+// Each kernel picks AVX2, SSE2/SSSE3 or NEON at runtime and falls back to scalar code.
+// All kernels are stateless and safe to call from any thread.
+class PixelKernels
+{
+public:
+	enum class InstructionSet
+	{
+		Scalar,
+		SSE2,
+		SSSE3,
+		AVX2,
+		NEON
+	};
+
+	// Best instruction set the kernels will use on this CPU
+	static InstructionSet GetInstructionSet();
+	static const char* GetInstructionSetName(InstructionSet set);
+
+	// Makes every kernel take its scalar path, for benchmarking and debugging
+	static void SetForceScalar(bool forceScalar);
+
+	// 3 -> 4 channels, alpha set to 255. src and dst must not overlap.
+	static void ExpandRGBToRGBA(const uint8_t* rgb, uint8_t* rgba, size_t pixelCount);
+	// 1 (grey) or 2 (grey, alpha) -> 4 channels
+	static void ExpandGreyToRGBA(const uint8_t* grey, uint32_t channels, uint8_t* rgba, size_t pixelCount);
+
+	// Swaps rows top to bottom in place
+	static void FlipVertical(uint8_t* pixels, size_t rowBytes, uint32_t rows);
+
+	// IEEE half <-> float, round to nearest even. Uses F16C or NEON when present.
+	// count is in values, not pixels.
+	static void FloatToHalf(const float* source, uint16_t* destination, size_t count);
+	static void HalfToFloat(const uint16_t* source, float* destination, size_t count);
+	static bool HasHardwareHalf();
+
+	struct BenchmarkResult
+	{
+		const char* Kernel = "";
+		InstructionSet Simd = InstructionSet::Scalar;
+		double ScalarMPixels = 0.0;
+		double SimdMPixels = 0.0;
+	};
+
+	// Times every SIMD kernel against its scalar path. Takes a few hundred ms, call it off the render thread.
+	static std::vector<BenchmarkResult> Benchmark(size_t pixelCount = 2048 * 2048);
+};
@@ -0,0 +1,155 @@
+#include "SamplerCache.h"
+
+#include "../AstranEditorUI.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+struct SamplerEntry
+{
+	VkSampler Sampler = VK_NULL_HANDLE;
+	uint32_t References = 0;
+};
+
+namespace Utils {
+
+	static inline uint64_t Mix(uint64_t hash, uint64_t value)
+	{
+		hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+
+	static inline uint64_t FloatBits(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	struct SamplerDescriptionHash
+	{
+		size_t operator()(const SamplerDescription& description) const
+		{
+			uint64_t hash = 0;
+			hash = Mix(hash, description.MagFilter);
+			hash = Mix(hash, description.MinFilter);
+			hash = Mix(hash, description.MipmapMode);
+			hash = Mix(hash, description.AddressModeU);
+			hash = Mix(hash, description.AddressModeV);
+			hash = Mix(hash, description.AddressModeW);
+			hash = Mix(hash, FloatBits(description.MipLodBias));
+			hash = Mix(hash, FloatBits(description.MaxAnisotropy));
+			hash = Mix(hash, description.CompareEnable);
+			hash = Mix(hash, description.CompareOp);
+			hash = Mix(hash, FloatBits(description.MinLod));
+			hash = Mix(hash, FloatBits(description.MaxLod));
+			hash = Mix(hash, description.BorderColor);
+			hash = Mix(hash, description.UnnormalizedCoordinates);
+			return (size_t)hash;
+		}
+	};
+
+}
+
+static std::mutex                                                                    g_Mutex;
+static std::unordered_map<SamplerDescription, SamplerEntry, Utils::SamplerDescriptionHash> g_Samplers;
+static std::unordered_map<VkSampler, SamplerDescription>                             g_Descriptions;
+
+VkSamplerCreateInfo SamplerDescription::ToCreateInfo() const
+{
+	VkSamplerCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	info.magFilter = MagFilter;
+	info.minFilter = MinFilter;
+	info.mipmapMode = MipmapMode;
+	info.addressModeU = AddressModeU;
+	info.addressModeV = AddressModeV;
+	info.addressModeW = AddressModeW;
+	info.mipLodBias = MipLodBias;
+	info.anisotropyEnable = MaxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+	info.maxAnisotropy = MaxAnisotropy;
+	info.compareEnable = CompareEnable ? VK_TRUE : VK_FALSE;
+	info.compareOp = CompareOp;
+	info.minLod = MinLod;
+	info.maxLod = MaxLod;
+	info.borderColor = BorderColor;
+	info.unnormalizedCoordinates = UnnormalizedCoordinates ? VK_TRUE : VK_FALSE;
+	return info;
+}
+
+bool SamplerDescription::operator==(const SamplerDescription& other) const
+{
+	return MagFilter == other.MagFilter && MinFilter == other.MinFilter && MipmapMode == other.MipmapMode
+		&& AddressModeU == other.AddressModeU && AddressModeV == other.AddressModeV && AddressModeW == other.AddressModeW
+		&& MipLodBias == other.MipLodBias && MaxAnisotropy == other.MaxAnisotropy
+		&& CompareEnable == other.CompareEnable && CompareOp == other.CompareOp
+		&& MinLod == other.MinLod && MaxLod == other.MaxLod
+		&& BorderColor == other.BorderColor && UnnormalizedCoordinates == other.UnnormalizedCoordinates;
+}
+
+VkSampler SamplerCache::Acquire(const SamplerDescription& description)
+{
+	std::lock_guard<std::mutex> lock(g_Mutex);
+
+	// Clamp before lookup so requests that end up identical on this device share a sampler
+	SamplerDescription key = description;
+	if (key.MaxAnisotropy > 1.0f)
+	{
+		VkPhysicalDevice physicalDevice = AstranEditorUI::GetPhysicalDevice();
+		VkPhysicalDeviceFeatures features;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		key.MaxAnisotropy = features.samplerAnisotropy ? std::min(key.MaxAnisotropy, properties.limits.maxSamplerAnisotropy) : 1.0f;
+	}
+
+	SamplerEntry& entry = g_Samplers[key];
+	if (!entry.Sampler)
+	{
+		VkSamplerCreateInfo info = key.ToCreateInfo();
+		VkResult err = vkCreateSampler(AstranEditorUI::GetDevice(), &info, nullptr, &entry.Sampler);
+		check_vk_result(err);
+		g_Descriptions[entry.Sampler] = key;
+	}
+	entry.References++;
+	return entry.Sampler;
+}
+
+void SamplerCache::Release(VkSampler sampler)
+{
+	if (!sampler)
+		return;
+
+	std::lock_guard<std::mutex> lock(g_Mutex);
+
+	auto description = g_Descriptions.find(sampler);
+	IM_ASSERT(description != g_Descriptions.end() && "SamplerCache: sampler was not acquired from the cache");
+	auto entry = g_Samplers.find(description->second);
+	if (--entry->second.References > 0)
+		return;
+
+	vkDestroySampler(AstranEditorUI::GetDevice(), sampler, nullptr);
+	g_Samplers.erase(entry);
+	g_Descriptions.erase(description);
+}
+
+void SamplerCache::Shutdown()
+{
+	std::lock_guard<std::mutex> lock(g_Mutex);
+
+	VkDevice device = AstranEditorUI::GetDevice();
+	for (auto& [description, entry] : g_Samplers)
+	{
+		vkDestroySampler(device, entry.Sampler, nullptr);
+	}
+	g_Samplers.clear();
+	g_Descriptions.clear();
+}
+
+uint32_t SamplerCache::GetSamplerCount()
+{
+	std::lock_guard<std::mutex> lock(g_Mutex);
+	return (uint32_t)g_Samplers.size();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+// Every field of VkSamplerCreateInfo that affects the sampler, defaults to trilinear + repeat.
+// MaxLod defaults to no clamp so textures with different mip counts share one sampler, sampling
+// never goes past the levels an image view actually has.
+struct SamplerDescription
+{
+	VkFilter MagFilter = VK_FILTER_LINEAR;
+	VkFilter MinFilter = VK_FILTER_LINEAR;
+	VkSamplerMipmapMode MipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	VkSamplerAddressMode AddressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	VkSamplerAddressMode AddressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	VkSamplerAddressMode AddressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	float MipLodBias = 0.0f;
+	// Anisotropic filtering is enabled above 1, clamped to the device limit
+	float MaxAnisotropy = 1.0f;
+	bool CompareEnable = false;
+	VkCompareOp CompareOp = VK_COMPARE_OP_NEVER;
+	float MinLod = 0.0f;
+	float MaxLod = VK_LOD_CLAMP_NONE;
+	VkBorderColor BorderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+	bool UnnormalizedCoordinates = false;
+
+	VkSamplerCreateInfo ToCreateInfo() const;
+
+	bool operator==(const SamplerDescription& other) const;
+	bool operator!=(const SamplerDescription& other) const { return !(*this == other); }
+};
+
+// Samplers are a limited device resource (maxSamplerAllocationCount, 4000 on many drivers), so
+// identical descriptions share one ref-counted VkSampler. Thread safe.
+class SamplerCache
+{
+public:
+	// Every Acquire needs a matching Release, the sampler is destroyed with its last reference
+	static VkSampler Acquire(const SamplerDescription& description);
+	static void Release(VkSampler sampler);
+
+	// Destroys whatever is left, call after every texture is gone
+	static void Shutdown();
+
+	// Live VkSampler objects, not references
+	static uint32_t GetSamplerCount();
+};
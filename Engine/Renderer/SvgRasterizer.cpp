@@ -0,0 +1,127 @@
+#include "SvgRasterizer.h"
+#include "ImageCache.h"
+#include "ImageDecoder.h"
+
+#include "../Core/JobSystem.h"
+#include "../Core/MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// The only translation unit that expands nanosvg, a second copy is what forced /FORCE:MULTIPLE before
+#define NANOSVG_ALL_COLOR_KEYWORDS
+#define NANOSVG_IMPLEMENTATION
+#include <nanosvg.h>
+#define NANOSVGRAST_IMPLEMENTATION
+#include <nanosvgrast.h>
+
+static const uint32_t g_TileSize = 256;
+// Bump when the rasterized output changes so old cache entries are ignored
+static const uint32_t g_RasterizerVersion = 1;
+
+namespace Utils {
+
+	// NSVGrasterizer keeps scratch buffers that grow to fit, one per thread is reused across tiles
+	struct ThreadRasterizer
+	{
+		NSVGrasterizer* Rasterizer = nullptr;
+
+		~ThreadRasterizer()
+		{
+			if (Rasterizer)
+				nsvgDeleteRasterizer(Rasterizer);
+		}
+	};
+
+	static NSVGrasterizer* GetThreadRasterizer()
+	{
+		thread_local ThreadRasterizer rasterizer;
+		if (!rasterizer.Rasterizer)
+			rasterizer.Rasterizer = nsvgCreateRasterizer();
+		return rasterizer.Rasterizer;
+	}
+
+}
+
+bool SvgRasterizer::Rasterize(const std::string& path, float scale, DecodedImage& outImage)
+{
+	outImage.Reset();
+
+	MappedFile file;
+	if (!file.Open(path, FileAccess::Sequential))
+	{
+		std::cout << "SvgRasterizer: could not open " << path << "\n";
+		return false;
+	}
+
+	uint32_t scaleBits;
+	memcpy(&scaleBits, &scale, sizeof(scaleBits));
+	uint64_t key = ImageCache::Hash(file.GetData(), file.GetSize());
+	key = ImageCache::HashCombine(key, ((uint64_t)g_RasterizerVersion << 32) | scaleBits);
+
+	if (ImageCache::Load(key, outImage))
+		return true;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// nsvgParse tokenizes in place and needs a terminator, the mapping is read only
+	std::string source((const char*)file.GetData(), (size_t)file.GetSize());
+	file.Close();
+
+	NSVGimage* image = nsvgParse(&source[0], "px", 96.0f);
+	if (!image)
+	{
+		std::cout << "SvgRasterizer: could not parse " << path << "\n";
+		return false;
+	}
+
+	uint32_t width = (uint32_t)std::ceil(image->width * scale);
+	uint32_t height = (uint32_t)std::ceil(image->height * scale);
+	if (width == 0 || height == 0)
+	{
+		std::cout << "SvgRasterizer: " << path << " has no size\n";
+		nsvgDelete(image);
+		return false;
+	}
+
+	outImage.Allocate(width, height);
+
+	uint32_t tilesX = (width + g_TileSize - 1) / g_TileSize;
+	uint32_t tilesY = (height + g_TileSize - 1) / g_TileSize;
+	uint8_t* pixels = outImage.GetPixels();
+
+	// Each tile shifts the document so its corner lands on the tile origin, nanosvg clips to w x h
+	auto rasterizeTile = [&](uint32_t tile)
+	{
+		uint32_t tileX = (tile % tilesX) * g_TileSize;
+		uint32_t tileY = (tile / tilesX) * g_TileSize;
+		uint32_t tileWidth = std::min(g_TileSize, width - tileX);
+		uint32_t tileHeight = std::min(g_TileSize, height - tileY);
+
+		uint8_t* destination = pixels + ((size_t)tileY * width + tileX) * 4;
+		nsvgRasterize(Utils::GetThreadRasterizer(), image, -(float)tileX, -(float)tileY, scale, destination, (int)tileWidth, (int)tileHeight, (int)(width * 4));
+	};
+
+	uint32_t tileCount = tilesX * tilesY;
+	if (tileCount == 1)
+		rasterizeTile(0);
+	else
+		JobSystem::ParallelFor(tileCount, rasterizeTile);
+
+	nsvgDelete(image);
+
+	ImageCache::Store(key, outImage);
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << "[svg] " << path << " at " << scale << "x -> " << width << "x" << height << ", " << tileCount << " tiles, " << milliseconds << " ms\n";
+
+	return true;
+}
+
+uint32_t SvgRasterizer::GetTileSize()
+{
+	return g_TileSize;
+}
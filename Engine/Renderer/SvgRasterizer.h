@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+class DecodedImage;
+
+// nanosvg front end. Large documents are split into tiles rasterized on the JobSystem, and every
+// result is kept in the ImageCache keyed by (file contents, scale), so coming back at a DPI that
+// was seen before costs a file read instead of a parse and rasterization.
+// Owns the only nanosvg implementation in the engine, include nanosvg.h nowhere else with
+// NANOSVG_IMPLEMENTATION defined.
+class SvgRasterizer
+{
+public:
+	// scale 1 is the document's own size in px at 96 DPI. Safe to call from any thread,
+	// including from inside a job.
+	static bool Rasterize(const std::string& path, float scale, DecodedImage& outImage);
+
+	// Edge length of the square tiles rasterized in parallel
+	static uint32_t GetTileSize();
+};
@@ -4,45 +4,55 @@
 #include <backends/imgui_impl_vulkan.h>
 
 #include "../AstranEditorUI.h"
+#include "UploadManager.h"
+#include "DeviceMemoryAllocator.h"
+#include "MipGenerator.h"
+#include "Ktx2.h"
+#include "ImageDecoder.h"
+#include "SvgRasterizer.h"
+
+#include "../Core/MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+// Dynamic textures with rectangles waiting for FlushPendingUpdates
+static std::vector<Texture*> g_DirtyTextures;
+// Streaming textures written since the last RecordStreamingCopies
+static std::vector<Texture*> g_StreamingTextures;
 
-//Teena - need to do this since nanosvg is fucked. use /FORCE:MULTIPLE in linker commandline section
-//#ifndef ALLOWSVG
-//#define ALLOWSVG
-//#ifdef ALLOWSVG
-//#define NANOSVG_ALL_COLOR_KEYWORDS	// Include full list of color keywords.
-//#define NANOSVG_IMPLEMENTATION		// Expands implementation
-//#include "nanosvg.h"
-//#define NANOSVGRAST_IMPLEMENTATION
-//#include "nanosvgrast.h"
-//#endif // ALLOWSVG
-//#endif
-
+static std::atomic<uint64_t> g_TotalResidentBytes{ 0 };
+static std::atomic<uint64_t> g_TotalStagingBytes{ 0 };
 
 namespace Utils {
 
-	static uint32_t GetVulkanMemoryType(VkMemoryPropertyFlags properties, uint32_t type_bits)
+	// Bytes per texel of the uncompressed formats, 0 for block compressed ones
+	static uint32_t BytesPerPixel(ImageFormat format)
 	{
-		VkPhysicalDeviceMemoryProperties prop;
-		vkGetPhysicalDeviceMemoryProperties(AstranEditorUI::GetPhysicalDevice(), &prop);
-		for (uint32_t i = 0; i < prop.memoryTypeCount; i++)
+		switch (format)
 		{
-			if ((prop.memoryTypes[i].propertyFlags & properties) == properties && type_bits & (1 << i))
-				return i;
+		case ImageFormat::RGBA:    return 4;
+		case ImageFormat::RGBA16F: return 8;
+		case ImageFormat::RGBA32F: return 16;
 		}
-
-		return 0xffffffff;
+		return 0;
 	}
 
-	static uint32_t BytesPerChannel(ImageFormat format)
+	// Bytes per 4x4 block, 0 for uncompressed formats
+	static uint32_t BytesPerBlock(ImageFormat format)
 	{
 		switch (format)
 		{
-		case ImageFormat::RGBA:    return 4;
-		case ImageFormat::RGBA32F: return 32;
+		case ImageFormat::BC1: return 8;
+		case ImageFormat::BC3: return 16;
+		case ImageFormat::BC4: return 8;
+		case ImageFormat::BC5: return 16;
+		case ImageFormat::BC7: return 16;
 		}
 		return 0;
 	}
@@ -53,10 +63,67 @@ namespace Utils {
 		{
 		case ImageFormat::RGBA:    return VK_FORMAT_R8G8B8A8_UNORM;
 		case ImageFormat::RGBA32F: return VK_FORMAT_R32G32B32A32_SFLOAT;
+		case ImageFormat::RGBA16F: return VK_FORMAT_R16G16B16A16_SFLOAT;
+		case ImageFormat::BC1:     return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case ImageFormat::BC3:     return VK_FORMAT_BC3_UNORM_BLOCK;
+		case ImageFormat::BC4:     return VK_FORMAT_BC4_UNORM_BLOCK;
+		case ImageFormat::BC5:     return VK_FORMAT_BC5_UNORM_BLOCK;
+		case ImageFormat::BC7:     return VK_FORMAT_BC7_UNORM_BLOCK;
 		}
 		return (VkFormat)0;
 	}
 
+	static void CopyRows(void* destination, size_t destinationPitch, const void* source, size_t sourcePitch, size_t rowBytes, uint32_t rows)
+	{
+		for (uint32_t row = 0; row < rows; row++)
+		{
+			memcpy((uint8_t*)destination + row * destinationPitch, (const uint8_t*)source + row * sourcePitch, rowBytes);
+		}
+	}
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static ImageFormat VulkanFormatToWalnutFormat(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:       return ImageFormat::RGBA;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:  return ImageFormat::RGBA32F;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:  return ImageFormat::RGBA16F;
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: return ImageFormat::BC1;
+		case VK_FORMAT_BC3_UNORM_BLOCK:      return ImageFormat::BC3;
+		case VK_FORMAT_BC4_UNORM_BLOCK:      return ImageFormat::BC4;
+		case VK_FORMAT_BC5_UNORM_BLOCK:      return ImageFormat::BC5;
+		case VK_FORMAT_BC7_UNORM_BLOCK:      return ImageFormat::BC7;
+		}
+		return ImageFormat::None;
+	}
+
+	static bool SupportsBlitMips(VkFormat format)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(AstranEditorUI::GetPhysicalDevice(), format, &properties);
+
+		VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		return (properties.optimalTilingFeatures & required) == required;
+	}
+
+	static TextureMips ResolveMips(TextureMips requested, ImageFormat format)
+	{
+		bool canBlit = SupportsBlitMips(WalnutFormatToVulkanFormat(format));
+		bool canCPU = format == ImageFormat::RGBA;
+
+		switch (requested)
+		{
+		case TextureMips::GPUBlit: return canBlit ? TextureMips::GPUBlit : canCPU ? TextureMips::CPU : TextureMips::None;
+		case TextureMips::CPU:     return canCPU ? TextureMips::CPU : canBlit ? TextureMips::GPUBlit : TextureMips::None;
+		}
+		return TextureMips::None;
+	}
+
 }
 
 
@@ -77,6 +144,10 @@ Texture::Texture(const char * path, TextureSourceType type, float inScale, bool
 	{
 		LoadVectorImage(path, inScale);
 	}
+	else if (type == TextureSourceType::KTX2)
+	{
+		LoadKtx2Image(path);
+	}
 }
 
 Texture::Texture(std::string& path, TextureSourceType type, float inScale, bool flipVertically)
@@ -84,238 +155,856 @@ Texture::Texture(std::string& path, TextureSourceType type, float inScale, bool
 {
 }
 
+Texture::Texture(uint32_t width, uint32_t height, ImageFormat format, const void* data)
+	: Texture(width, height, TextureSpecification{ format, TextureUsage::Static }, data)
+{
+}
+
+Texture::Texture(uint32_t width, uint32_t height, const TextureSpecification& specification, const void* data)
+{
+	m_width = (int)width;
+	m_height = (int)height;
+	m_Format = specification.Format;
+	m_Usage = specification.Usage;
+	m_SamplerDescription = specification.Sampler;
+	// A streamed copy is recorded inside the frame, there is no batch to hang a mip chain off
+	m_Mips = m_Usage == TextureUsage::Streaming ? TextureMips::None : Utils::ResolveMips(specification.Mips, m_Format);
+	if (m_Mips != TextureMips::None)
+	{
+		m_MipLevels = MipGenerator::GetMipLevelCount(width, height);
+	}
+
+	uint64_t size = GetImageSize(m_Format, width, height);
+	AllocateMemory(size);
+	if (m_Usage == TextureUsage::Dynamic)
+	{
+		// CPU generated levels travel through the upload buffer as well
+		if (m_Mips == TextureMips::CPU)
+			size += MipGenerator::GetMipChainSize(width, height, m_MipLevels);
+		AllocateUploadSlots(size);
+	}
+	else if (m_Usage == TextureUsage::Streaming)
+	{
+		AllocateStreamingSlots(size);
+	}
+
+	if (data)
+	{
+		SetData(data);
+	}
+}
+
+Texture::Texture(const Ktx2View& ktx2, const uint8_t* fileData)
+{
+	InitializeFromKtx2(ktx2, fileData);
+}
+
 Texture::~Texture()
 {
 	VkDevice device = AstranEditorUI::GetDevice();
 
-	vkDestroySampler(device, m_Sampler, nullptr);
+	// A queued copy still targets this image
+	UploadManager::WaitForBatch(m_UploadBatch);
+
+	if (!m_DirtyRects.IsEmpty())
+		g_DirtyTextures.erase(std::remove(g_DirtyTextures.begin(), g_DirtyTextures.end(), this), g_DirtyTextures.end());
+
+	// Frames still in flight may sample the image or read a slot
+	if (m_StreamPending)
+		g_StreamingTextures.erase(std::remove(g_StreamingTextures.begin(), g_StreamingTextures.end(), this), g_StreamingTextures.end());
+	for (VkFence fence : m_StreamSlotFences)
+	{
+		if (fence)
+			vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	}
+
+	// Hand the set back to ImGui's pool, thumbnails come and go far more often than the pool has sets
+	if (m_DescriptorSet)
+		vkFreeDescriptorSets(device, AstranEditorUI::GetDescriptorPool(), 1, &m_DescriptorSet);
+	SamplerCache::Release(m_Sampler);
 	vkDestroyImageView(device, m_ImageView, nullptr);
+	if (m_ArrayImageView)
+		vkDestroyImageView(device, m_ArrayImageView, nullptr);
 	vkDestroyImage(device, m_Image, nullptr);
-	vkFreeMemory(device, m_Memory, nullptr);
-	vkDestroyBuffer(device, m_StagingBuffer, nullptr);
-	vkFreeMemory(device, m_StagingBufferMemory, nullptr);
+	DeviceMemoryAllocator::Free(m_Allocation);
+
+	if (m_UploadBuffer)
+	{
+		vkDestroyBuffer(device, m_UploadBuffer, nullptr);
+		DeviceMemoryAllocator::Free(m_UploadAllocation);
+	}
+
+	g_TotalResidentBytes -= m_ResidentBytes;
+	g_TotalStagingBytes -= m_StagingBytes;
+}
+
+VkFormat Texture::GetVulkanFormat(ImageFormat format)
+{
+	return Utils::WalnutFormatToVulkanFormat(format);
+}
+
+ImageFormat Texture::GetImageFormat(VkFormat format)
+{
+	return Utils::VulkanFormatToWalnutFormat(format);
+}
+
+bool Texture::IsCompressed(ImageFormat format)
+{
+	return Utils::BytesPerBlock(format) != 0;
+}
+
+uint64_t Texture::GetImageSize(ImageFormat format, uint32_t width, uint32_t height)
+{
+	if (IsCompressed(format))
+	{
+		uint64_t blocksX = (width + 3) / 4;
+		uint64_t blocksY = (height + 3) / 4;
+		return blocksX * blocksY * Utils::BytesPerBlock(format);
+	}
+
+	return (uint64_t)width * height * Utils::BytesPerPixel(format);
+}
+
+bool Texture::IsFormatSupported(ImageFormat format)
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(AstranEditorUI::GetPhysicalDevice(), Utils::WalnutFormatToVulkanFormat(format), &properties);
+	return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+uint64_t Texture::GetTotalResidentBytes()
+{
+	return g_TotalResidentBytes.load();
+}
+
+uint64_t Texture::GetTotalStagingBytes()
+{
+	return g_TotalStagingBytes.load() + UploadManager::GetStagingBytesInUse();
 }
 
 void Texture::LoadRasterImage(const char * path, float inScale, bool flipVertically)
 {
-	// load image, create texture and generate mipmaps
-	stbi_set_flip_vertically_on_load(flipVertically);
-	unsigned char* data = stbi_load(path, &m_width, &m_height, &nrChannels, STBI_rgb_alpha); //0 - Auto or 4 - RGBA
+	DecodedImage image;
+	if (!ImageDecoder::Decode(path, flipVertically, image))
+	{
+		std::cout << "Failed to load texture " << path << ": " << ImageDecoder::GetFailureReason() << "\n";
+		return;
+	}
 
-	uint64_t size = m_width * m_height * 4;
-	m_Format = ImageFormat::RGBA;
+	m_width = (int)image.GetWidth();
+	m_height = (int)image.GetHeight();
+	nrChannels = 4;
+	m_Format = image.GetFormat();
 
-	std::cout << "m_width: " << m_width << "m_height: " + m_height;
+	std::cout << "m_width: " << m_width << " m_height: " << m_height << "\n";
 
-	AllocateMemory(size);
-	SetData(data);
-	stbi_image_free(data);
+	AllocateMemory(image.GetSize());
+	SetData(image.GetPixels());
 }
 
 void Texture::LoadVectorImage(const char * path, float inScale)
 {
-	/*
-	NSVGrasterizer *rast = NULL;
-	unsigned char* img = NULL;
+	DecodedImage image;
+	if (!SvgRasterizer::Rasterize(path, inScale, image))
+		return;
+
+	m_width = (int)image.GetWidth();
+	m_height = (int)image.GetHeight();
+	nrChannels = 4;
+	m_Format = ImageFormat::RGBA;
+
+	AllocateMemory(image.GetSize());
+	SetData(image.GetPixels());
+}
+
+void Texture::LoadKtx2Image(const char* path)
+{
+	MappedFile file;
+	if (!file.Open(path, FileAccess::Sequential))
+		return;
 
-	NSVGimage* image = nsvgParseFromFile(path, "px", 96.0f);
-	if (image == NULL)
+	Ktx2View ktx2;
+	if (!Ktx2::Parse(file.GetData(), file.GetSize(), ktx2))
 	{
-		printf("Could not open SVG image.\n");
-		goto error;
+		std::cout << "Failed to load " << path << "\n";
+		return;
 	}
 
-	m_width = (int)image->width*inScale;
-	m_height = (int)image->height*inScale;
+	InitializeFromKtx2(ktx2, file.GetData());
+}
 
-	rast = nsvgCreateRasterizer();
-	if (rast == NULL)
+bool Texture::InitializeFromKtx2(const Ktx2View& ktx2, const uint8_t* fileData)
+{
+	ImageFormat format = Utils::VulkanFormatToWalnutFormat(ktx2.Format);
+	if (format == ImageFormat::None)
 	{
-		printf("Could not init rasterizer.\n");
-		goto error;
+		std::cout << "KTX2 texture uses unsupported VkFormat " << (int)ktx2.Format << "\n";
+		return false;
 	}
 
-	img = (unsigned char*)malloc(m_width*m_height * 4);
-	if (img == NULL)
+	// Level sizes must match what the copy regions below will read
+	uint64_t total = 0;
+	for (uint32_t level = 0; level < (uint32_t)ktx2.Levels.size(); level++)
 	{
-		printf("Could not alloc image buffer.\n");
-		goto error;
+		uint64_t expected = GetImageSize(format, MipGenerator::GetMipDimension(ktx2.Width, level), MipGenerator::GetMipDimension(ktx2.Height, level)) * ktx2.LayerCount;
+		if (ktx2.Levels[level].Length != expected)
+		{
+			std::cout << "KTX2 level " << level << " has " << ktx2.Levels[level].Length << " bytes, expected " << expected << "\n";
+			return false;
+		}
+		total = Utils::AlignUp(total, 16) + expected;
 	}
 
-	nsvgRasterize(rast, image, 0, 0, inScale, img, m_width, m_height, m_width * 4);
+	m_width = (int)ktx2.Width;
+	m_height = (int)ktx2.Height;
+	m_Format = format;
+	m_Usage = TextureUsage::Static;
+	m_Mips = TextureMips::None;
+	m_MipLevels = (uint32_t)ktx2.Levels.size();
+	m_ArrayLayers = ktx2.LayerCount;
+
+	AllocateMemory(total);
+
+	// The only copy between disk and GPU: mapped file pages straight into the staging ring
+	StagingAllocation staging = UploadManager::AllocateStaging(total);
+	std::vector<VkBufferImageCopy> regions(m_MipLevels);
+	VkDeviceSize offset = 0;
+	for (uint32_t level = 0; level < m_MipLevels; level++)
+	{
+		offset = Utils::AlignUp(offset, 16);
+		memcpy((uint8_t*)staging.Data + offset, fileData + ktx2.Levels[level].Offset, ktx2.Levels[level].Length);
 
-	GenerateTexture(img);
+		VkBufferImageCopy& region = regions[level];
+		region = {};
+		region.bufferOffset = offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.layerCount = m_ArrayLayers;
+		region.imageExtent.width = MipGenerator::GetMipDimension(m_width, level);
+		region.imageExtent.height = MipGenerator::GetMipDimension(m_height, level);
+		region.imageExtent.depth = 1;
 
-	free((unsigned char*)img);
+		offset += ktx2.Levels[level].Length;
+	}
+	UploadManager::QueueImageUpload(m_Image, staging, regions.data(), m_MipLevels, m_MipLevels, m_ArrayLayers);
+	m_UploadBatch = UploadManager::GetCurrentBatch();
+	m_HasContents = true;
 
-error:
-	nsvgDeleteRasterizer(rast);
-	nsvgDelete(image);
-	*/
+	return true;
 }
 
 void Texture::AllocateMemory(uint64_t size)
 {
-	VkDevice device = AstranEditorUI::GetDevice();
+	// Create the Image
+	{
+		CreateImage(m_Image);
+		m_Allocation = DeviceMemoryAllocator::AllocateForImage(m_Image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		IM_ASSERT(m_Allocation && "Texture: out of device memory");
+		m_Allocation->Relocate = [this](VkDeviceMemory memory, VkDeviceSize offset, VkCommandBuffer commandBuffer, std::function<void()>& release)
+		{
+			return RelocateImage(memory, offset, commandBuffer, release);
+		};
 
-	VkResult err;
+		m_ResidentBytes = m_Allocation->Size;
+		g_TotalResidentBytes += m_ResidentBytes;
+	}
 
-	VkFormat vulkanFormat = Utils::WalnutFormatToVulkanFormat(m_Format);
+	// Create the Image View:
+	CreateImageViews();
 
-	// Create the Image
+	// Shared sampler:
+	m_Sampler = SamplerCache::Acquire(m_SamplerDescription);
+
+	// Create the Descriptor Set:
+	m_DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void Texture::CreateImage(VkImage& image)
+{
+	VkImageCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.format = Utils::WalnutFormatToVulkanFormat(m_Format);
+	info.extent.width = m_width;
+	info.extent.height = m_height;
+	info.extent.depth = 1;
+	info.mipLevels = m_MipLevels;
+	info.arrayLayers = m_ArrayLayers;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	// Transfer source for GPU mip blits and for copying the image out when it is relocated
+	info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkResult err = vkCreateImage(AstranEditorUI::GetDevice(), &info, nullptr, &image);
+	check_vk_result(err);
+}
+
+void Texture::CreateImageViews()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	VkImageViewCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	info.image = m_Image;
+	info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	info.format = Utils::WalnutFormatToVulkanFormat(m_Format);
+	info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	info.subresourceRange.levelCount = m_MipLevels;
+	info.subresourceRange.layerCount = 1;
+	VkResult err = vkCreateImageView(device, &info, nullptr, &m_ImageView);
+	check_vk_result(err);
+
+	if (m_ArrayLayers > 1)
 	{
-		VkImageCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		info.imageType = VK_IMAGE_TYPE_2D;
-		info.format = vulkanFormat;
-		info.extent.width = m_width;
-		info.extent.height = m_height;
-		info.extent.depth = 1;
-		info.mipLevels = 1;
-		info.arrayLayers = 1;
-		info.samples = VK_SAMPLE_COUNT_1_BIT;
-		info.tiling = VK_IMAGE_TILING_OPTIMAL;
-		info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		err = vkCreateImage(device, &info, nullptr, &m_Image);
-		check_vk_result(err);
-		VkMemoryRequirements req;
-		vkGetImageMemoryRequirements(device, m_Image, &req);
-		VkMemoryAllocateInfo alloc_info = {};
-		alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		alloc_info.allocationSize = req.size;
-		alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, req.memoryTypeBits);
-		err = vkAllocateMemory(device, &alloc_info, nullptr, &m_Memory);
-		check_vk_result(err);
-		err = vkBindImageMemory(device, m_Image, m_Memory, 0);
+		info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		info.subresourceRange.layerCount = m_ArrayLayers;
+		err = vkCreateImageView(device, &info, nullptr, &m_ArrayImageView);
 		check_vk_result(err);
 	}
+}
 
-	// Create the Image View:
+bool Texture::RelocateImage(VkDeviceMemory memory, VkDeviceSize offset, VkCommandBuffer commandBuffer, std::function<void()>& release)
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	// Copies still queued on the UploadManager target the old image
+	UploadManager::WaitForBatch(m_UploadBatch);
+
+	VkImage image;
+	CreateImage(image);
+	VkResult err = vkBindImageMemory(device, image, memory, offset);
+	check_vk_result(err);
+
+	if (m_HasContents)
 	{
-		VkImageViewCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		info.image = m_Image;
-		info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		info.format = vulkanFormat;
-		info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		info.subresourceRange.levelCount = 1;
-		info.subresourceRange.layerCount = 1;
-		err = vkCreateImageView(device, &info, nullptr, &m_ImageView);
-		check_vk_result(err);
+		VkImageMemoryBarrier barriers[2] = {};
+		for (VkImageMemoryBarrier& barrier : barriers)
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.levelCount = m_MipLevels;
+			barrier.subresourceRange.layerCount = m_ArrayLayers;
+		}
+		barriers[0].image = m_Image;
+		barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[1].image = image;
+		barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+		std::vector<VkImageCopy> regions(m_MipLevels);
+		for (uint32_t level = 0; level < m_MipLevels; level++)
+		{
+			VkImageCopy& region = regions[level];
+			region = {};
+			region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.srcSubresource.mipLevel = level;
+			region.srcSubresource.layerCount = m_ArrayLayers;
+			region.dstSubresource = region.srcSubresource;
+			region.extent.width = std::max(m_width >> level, 1);
+			region.extent.height = std::max(m_height >> level, 1);
+			region.extent.depth = 1;
+		}
+		vkCmdCopyImage(commandBuffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+		barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
 	}
 
-	// Create sampler:
-	{
-		VkSamplerCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		info.magFilter = VK_FILTER_LINEAR;
-		info.minFilter = VK_FILTER_LINEAR;
-		info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		info.minLod = -1000;
-		info.maxLod = 1000;
-		info.maxAnisotropy = 1.0f;
-		VkResult err = vkCreateSampler(device, &info, nullptr, &m_Sampler);
-		check_vk_result(err);
+	// The copy above still reads the old image, Defragment destroys it after waiting on the batch
+	VkImage oldImage = m_Image;
+	VkImageView oldImageView = m_ImageView;
+	VkImageView oldArrayImageView = m_ArrayImageView;
+	release = [device, oldImage, oldImageView, oldArrayImageView]()
+	{
+		vkDestroyImageView(device, oldImageView, nullptr);
+		if (oldArrayImageView)
+			vkDestroyImageView(device, oldArrayImageView, nullptr);
+		vkDestroyImage(device, oldImage, nullptr);
+	};
+	m_ArrayImageView = nullptr;
+
+	m_Image = image;
+	CreateImageViews();
+
+	// Repoint the descriptor set in place, ImTextureIDs handed out earlier stay valid
+	VkDescriptorImageInfo image_info = {};
+	image_info.sampler = m_Sampler;
+	image_info.imageView = m_ImageView;
+	image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = m_DescriptorSet;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &image_info;
+	vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+	return true;
+}
+
+std::unique_ptr<Texture> Texture::CreateReducedCopy(uint32_t maxSize, VkCommandBuffer commandBuffer)
+{
+	if (!m_HasContents || m_ArrayLayers > 1 || m_Usage == TextureUsage::Streaming)
+		return nullptr;
+
+	uint32_t level = 0;
+	while (level + 1 < m_MipLevels && (uint32_t)std::max(m_width >> level, m_height >> level) > maxSize)
+		level++;
+	uint32_t sourceWidth = (uint32_t)std::max(m_width >> level, 1);
+	uint32_t sourceHeight = (uint32_t)std::max(m_height >> level, 1);
+
+	uint32_t width = sourceWidth;
+	uint32_t height = sourceHeight;
+	bool blit = std::max(sourceWidth, sourceHeight) > maxSize;
+	if (blit)
+	{
+		if (IsCompressed(m_Format) || !Utils::SupportsBlitMips(Utils::WalnutFormatToVulkanFormat(m_Format)))
+			return nullptr;
+		float scale = (float)maxSize / (float)std::max(sourceWidth, sourceHeight);
+		width = std::max((uint32_t)(sourceWidth * scale), 1u);
+		height = std::max((uint32_t)(sourceHeight * scale), 1u);
+	}
+	else if (level == 0)
+	{
+		// Already small, a copy would save nothing
+		return nullptr;
 	}
 
-	// Create the Descriptor Set:
-	m_DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	TextureSpecification specification;
+	specification.Format = m_Format;
+	specification.Sampler = m_SamplerDescription;
+	std::unique_ptr<Texture> reduced = std::make_unique<Texture>(width, height, specification);
+
+	VkImageMemoryBarrier barriers[2] = {};
+	for (VkImageMemoryBarrier& barrier : barriers)
+	{
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = 1;
+	}
+	barriers[0].image = m_Image;
+	barriers[0].subresourceRange.baseMipLevel = level;
+	barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[1].image = reduced->m_Image;
+	barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	if (blit)
+	{
+		VkImageBlit region = {};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.mipLevel = level;
+		region.srcSubresource.layerCount = 1;
+		region.srcOffsets[1] = { (int32_t)sourceWidth, (int32_t)sourceHeight, 1 };
+		region.dstSubresource = region.srcSubresource;
+		region.dstSubresource.mipLevel = 0;
+		region.dstOffsets[1] = { (int32_t)width, (int32_t)height, 1 };
+		vkCmdBlitImage(commandBuffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, reduced->m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+	}
+	else
+	{
+		VkImageCopy region = {};
+		region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.srcSubresource.mipLevel = level;
+		region.srcSubresource.layerCount = 1;
+		region.dstSubresource = region.srcSubresource;
+		region.dstSubresource.mipLevel = 0;
+		region.extent = { width, height, 1 };
+		vkCmdCopyImage(commandBuffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, reduced->m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+
+	barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+	reduced->m_HasContents = true;
+	return reduced;
 }
 
-void Texture::SetData(const void* data)
+void Texture::AllocateUploadBuffer(uint64_t size)
 {
 	VkDevice device = AstranEditorUI::GetDevice();
 
-	size_t upload_size = m_width * m_height * Utils::BytesPerChannel(m_Format);
+	VkBufferCreateInfo buffer_info = {};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = size;
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VkResult err = vkCreateBuffer(device, &buffer_info, nullptr, &m_UploadBuffer);
+	check_vk_result(err);
+
+	// Coherent and mapped for the lifetime of the texture. Never relocated, m_UploadBufferData is held onto.
+	m_UploadAllocation = DeviceMemoryAllocator::AllocateForBuffer(m_UploadBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	IM_ASSERT(m_UploadAllocation && "Texture: out of host visible memory");
+	m_UploadBufferData = m_UploadAllocation->MappedData;
+
+	m_StagingBytes = m_UploadAllocation->Size;
+	g_TotalStagingBytes += m_StagingBytes;
+}
+
+void Texture::AllocateUploadSlots(uint64_t size)
+{
+	// Same count as streaming slots, a frame's updates go to a slot the frames in flight don't read
+	uint32_t slotCount = std::max(AstranEditorUI::GetFramesInFlight(), 2u);
+
+	m_UploadSlotSize = Utils::AlignUp(size, 16);
+	m_UploadSlotBatches.assign(slotCount, 0);
+	m_UploadSlotStaleRects.assign(slotCount, DirtyRectList());
+	AllocateUploadBuffer(m_UploadSlotSize * slotCount);
+}
+
+void Texture::SetData(const void* data)
+{
+	if (m_Usage == TextureUsage::Streaming)
+	{
+		WriteStreamingSlot(data);
+		return;
+	}
 
-	VkResult err;
+	size_t upload_size = GetImageSize(m_Format, m_width, m_height);
+	size_t chain_size = m_Mips == TextureMips::CPU ? MipGenerator::GetMipChainSize(m_width, m_height, m_MipLevels) : 0;
 
-	if (!m_StagingBuffer)
+	StagingAllocation staging;
+	if (m_Usage == TextureUsage::Static)
+	{
+		// Ring space is handed back as soon as the batch retires, nothing stays behind
+		staging = UploadManager::AllocateStaging(upload_size + chain_size);
+	}
+	else
 	{
-		// Create the Upload Buffer
+		staging.Data = AcquireUploadSlot(true);
+
+		// The whole image goes up, pending rectangles have nothing left to add
+		if (!m_DirtyRects.IsEmpty())
 		{
-			VkBufferCreateInfo buffer_info = {};
-			buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-			buffer_info.size = upload_size;
-			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-			buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			err = vkCreateBuffer(device, &buffer_info, nullptr, &m_StagingBuffer);
-			check_vk_result(err);
-			VkMemoryRequirements req;
-			vkGetBufferMemoryRequirements(device, m_StagingBuffer, &req);
-			m_AlignedSize = req.size;
-			VkMemoryAllocateInfo alloc_info = {};
-			alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-			alloc_info.allocationSize = req.size;
-			alloc_info.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, req.memoryTypeBits);
-			err = vkAllocateMemory(device, &alloc_info, nullptr, &m_StagingBufferMemory);
-			check_vk_result(err);
-			err = vkBindBufferMemory(device, m_StagingBuffer, m_StagingBufferMemory, 0);
-			check_vk_result(err);
+			m_DirtyRects.Clear();
+			g_DirtyTextures.erase(std::remove(g_DirtyTextures.begin(), g_DirtyTextures.end(), this), g_DirtyTextures.end());
 		}
 
+		staging.Buffer = m_UploadBuffer;
+		staging.Offset = m_UploadSlot * m_UploadSlotSize;
+		staging.Size = upload_size + chain_size;
 	}
 
-	// Upload to Buffer
+	memcpy(staging.Data, data, upload_size);
+
+	if (chain_size > 0)
 	{
-		char* map = NULL;
-		err = vkMapMemory(device, m_StagingBufferMemory, 0, m_AlignedSize, 0, (void**)(&map));
-		check_vk_result(err);
-		memcpy(map, data, upload_size);
-		VkMappedMemoryRange range[1] = {};
-		range[0].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-		range[0].memory = m_StagingBufferMemory;
-		range[0].size = m_AlignedSize;
-		err = vkFlushMappedMemoryRanges(device, 1, range);
-		check_vk_result(err);
-		vkUnmapMemory(device, m_StagingBufferMemory);
+		// Filter in cached memory, staging is write combined and slow to read back from
+		std::vector<uint8_t> chain(chain_size);
+		MipGenerator::GenerateMipChainRGBA8((const uint8_t*)data, m_width, m_height, m_MipLevels, chain.data());
+		memcpy((uint8_t*)staging.Data + upload_size, chain.data(), chain_size);
 	}
 
+	uint32_t regionCount = m_Mips == TextureMips::CPU ? m_MipLevels : 1;
+	std::vector<VkBufferImageCopy> regions(regionCount);
+	VkDeviceSize offset = 0;
+	for (uint32_t level = 0; level < regionCount; level++)
+	{
+		VkBufferImageCopy& region = regions[level];
+		region = {};
+		region.bufferOffset = offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent.width = MipGenerator::GetMipDimension(m_width, level);
+		region.imageExtent.height = MipGenerator::GetMipDimension(m_height, level);
+		region.imageExtent.depth = 1;
+		offset += GetImageSize(m_Format, region.imageExtent.width, region.imageExtent.height);
+	}
+	// Frames in flight may still sample the previous contents
+	UploadManager::QueueImageUpload(m_Image, staging, regions.data(), regionCount, m_MipLevels, 1, m_HasContents);
 
-	// Copy to Image
+	if (m_Mips == TextureMips::GPUBlit)
 	{
-		VkCommandBuffer command_buffer = AstranEditorUI::GetCommandBuffer(true);
+		UploadManager::QueueMipGeneration(m_Image, m_width, m_height, m_MipLevels);
+	}
 
-		VkImageMemoryBarrier copy_barrier = {};
-		copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		copy_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		copy_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		copy_barrier.image = m_Image;
-		copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		copy_barrier.subresourceRange.levelCount = 1;
-		copy_barrier.subresourceRange.layerCount = 1;
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &copy_barrier);
+	m_UploadBatch = UploadManager::GetCurrentBatch();
+	m_HasContents = true;
+	if (m_Usage == TextureUsage::Dynamic)
+	{
+		m_UploadSlotBatches[m_UploadSlot] = m_UploadBatch;
+		TextureRegion whole;
+		whole.Width = (uint32_t)m_width;
+		whole.Height = (uint32_t)m_height;
+		MarkOtherSlotsStale(whole);
+	}
+}
+
+void Texture::SetData(const TextureRegion& region, const void* data, uint32_t rowPitch)
+{
+	IM_ASSERT(!IsCompressed(m_Format) && "Region updates need an uncompressed format");
+	IM_ASSERT(m_Usage != TextureUsage::Streaming && "Streaming textures take whole images");
+	IM_ASSERT(region.X + region.Width <= (uint32_t)m_width && region.Y + region.Height <= (uint32_t)m_height);
+	if (region.Width == 0 || region.Height == 0)
+		return;
+
+	uint32_t texelBytes = Utils::BytesPerPixel(m_Format);
+	size_t rowBytes = (size_t)region.Width * texelBytes;
+	size_t sourcePitch = rowPitch ? rowPitch : rowBytes;
+
+	if (m_Usage == TextureUsage::Static)
+	{
+		// No upload buffer to gather in, the rows go to the ring packed
+		StagingAllocation staging = UploadManager::AllocateStaging(rowBytes * region.Height);
+		Utils::CopyRows(staging.Data, rowBytes, data, sourcePitch, rowBytes, region.Height);
+
+		VkBufferImageCopy copy = {};
+		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.imageSubresource.layerCount = 1;
+		copy.imageOffset.x = (int32_t)region.X;
+		copy.imageOffset.y = (int32_t)region.Y;
+		copy.imageExtent.width = region.Width;
+		copy.imageExtent.height = region.Height;
+		copy.imageExtent.depth = 1;
+		QueueRegionCopies(staging, &copy, 1);
+		return;
+	}
 
+	size_t imagePitch = (size_t)m_width * texelBytes;
+	uint8_t* destination = AcquireUploadSlot() + region.Y * imagePitch + region.X * texelBytes;
+	Utils::CopyRows(destination, imagePitch, data, sourcePitch, rowBytes, region.Height);
+	MarkOtherSlotsStale(region);
+
+	if (m_DirtyRects.IsEmpty())
+		g_DirtyTextures.push_back(this);
+	m_DirtyRects.Add(region);
+}
+
+void Texture::FlushPendingUpdates()
+{
+	for (Texture* texture : g_DirtyTextures)
+	{
+		texture->FlushDirtyRects();
+	}
+	g_DirtyTextures.clear();
+}
+
+void Texture::RecordStreamingCopies(VkCommandBuffer commandBuffer, VkFence frameFence)
+{
+	if (g_StreamingTextures.empty())
+		return;
+
+	std::vector<VkImageMemoryBarrier> barriers(g_StreamingTextures.size());
+	for (size_t i = 0; i < g_StreamingTextures.size(); i++)
+	{
+		Texture* texture = g_StreamingTextures[i];
+
+		VkImageMemoryBarrier& barrier = barriers[i];
+		barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		// Every texel is rewritten, so even sampled images can drop their contents
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = texture->m_Image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.layerCount = 1;
+	}
+	// Fragment shader reads of the previous frame come first, host writes are visible at submit
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, (uint32_t)barriers.size(), barriers.data());
+
+	for (Texture* texture : g_StreamingTextures)
+	{
 		VkBufferImageCopy region = {};
+		region.bufferOffset = texture->m_StreamWriteSlot * texture->m_StreamSlotSize;
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		region.imageSubresource.layerCount = 1;
-		region.imageExtent.width = m_width;
-		region.imageExtent.height = m_height;
+		region.imageExtent.width = texture->m_width;
+		region.imageExtent.height = texture->m_height;
 		region.imageExtent.depth = 1;
-		vkCmdCopyBufferToImage(command_buffer, m_StagingBuffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-		VkImageMemoryBarrier use_barrier = {};
-		use_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		use_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		use_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		use_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		use_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		use_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		use_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		use_barrier.image = m_Image;
-		use_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		use_barrier.subresourceRange.levelCount = 1;
-		use_barrier.subresourceRange.layerCount = 1;
-		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &use_barrier);
-
-		AstranEditorUI::FlushCommandBuffer(command_buffer);
+		vkCmdCopyBufferToImage(commandBuffer, texture->m_UploadBuffer, texture->m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		// The next write goes to the following slot while this frame reads the current one
+		texture->m_StreamSlotFences[texture->m_StreamWriteSlot] = frameFence;
+		texture->m_StreamWriteSlot = (texture->m_StreamWriteSlot + 1) % (uint32_t)texture->m_StreamSlotFences.size();
+		texture->m_StreamPending = false;
+		texture->m_HasContents = true;
+	}
+
+	for (VkImageMemoryBarrier& barrier : barriers)
+	{
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, (uint32_t)barriers.size(), barriers.data());
+
+	g_StreamingTextures.clear();
+}
+
+void Texture::AllocateStreamingSlots(uint64_t size)
+{
+	// One slot per frame the swapchain can have in flight, never fewer than two
+	uint32_t slotCount = std::max(AstranEditorUI::GetFramesInFlight(), 2u);
+
+	m_StreamSlotSize = Utils::AlignUp(size, 16);
+	m_StreamSlotFences.assign(slotCount, VK_NULL_HANDLE);
+	AllocateUploadBuffer(m_StreamSlotSize * slotCount);
+}
+
+void Texture::WriteStreamingSlot(const void* data)
+{
+	// Only waits when the CPU runs more frames ahead than there are slots. Frame fences are
+	// reset and resubmitted inside FrameRender, so one seen here is always signalled or pending.
+	VkFence fence = m_StreamSlotFences[m_StreamWriteSlot];
+	if (fence)
+	{
+		VkResult err = vkWaitForFences(AstranEditorUI::GetDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+		check_vk_result(err);
+		m_StreamSlotFences[m_StreamWriteSlot] = VK_NULL_HANDLE;
+	}
+
+	// Several writes in one frame land in the same slot, the last one is copied
+	memcpy((uint8_t*)m_UploadBufferData + m_StreamWriteSlot * m_StreamSlotSize, data, GetImageSize(m_Format, m_width, m_height));
+
+	if (!m_StreamPending)
+	{
+		g_StreamingTextures.push_back(this);
+		m_StreamPending = true;
+	}
+}
+
+void Texture::FlushDirtyRects()
+{
+	uint32_t texelBytes = Utils::BytesPerPixel(m_Format);
+	const std::vector<TextureRegion>& rects = m_DirtyRects.Coalesce();
+
+	// Copies read straight out of the current slot, which is laid out like level 0 and up to date
+	// everywhere, so merged bounding boxes only pick up texels the image already has
+	std::vector<VkBufferImageCopy> copies(rects.size());
+	VkDeviceSize bytes = 0;
+	for (size_t i = 0; i < rects.size(); i++)
+	{
+		const TextureRegion& rect = rects[i];
+		VkBufferImageCopy& copy = copies[i];
+		copy = {};
+		copy.bufferOffset = ((VkDeviceSize)rect.Y * m_width + rect.X) * texelBytes;
+		copy.bufferRowLength = (uint32_t)m_width;
+		copy.bufferImageHeight = (uint32_t)m_height;
+		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.imageSubresource.layerCount = 1;
+		copy.imageOffset.x = (int32_t)rect.X;
+		copy.imageOffset.y = (int32_t)rect.Y;
+		copy.imageExtent.width = rect.Width;
+		copy.imageExtent.height = rect.Height;
+		copy.imageExtent.depth = 1;
+		bytes += (VkDeviceSize)rect.Width * rect.Height * texelBytes;
+	}
+
+	StagingAllocation staging;
+	staging.Data = (uint8_t*)m_UploadBufferData + m_UploadSlot * m_UploadSlotSize;
+	staging.Buffer = m_UploadBuffer;
+	staging.Offset = m_UploadSlot * m_UploadSlotSize;
+	staging.Size = bytes;
+	QueueRegionCopies(staging, copies.data(), (uint32_t)copies.size());
+	m_UploadSlotBatches[m_UploadSlot] = m_UploadBatch;
+
+	m_DirtyRects.Clear();
+}
+
+void Texture::QueueRegionCopies(const StagingAllocation& staging, const VkBufferImageCopy* regions, uint32_t regionCount)
+{
+	// Before the first upload the image is still UNDEFINED and has nothing worth keeping
+	if (m_HasContents)
+		UploadManager::QueueImageUpdate(m_Image, staging, regions, regionCount, m_MipLevels);
+	else
+		UploadManager::QueueImageUpload(m_Image, staging, regions, regionCount, m_MipLevels);
+
+	if (m_Mips == TextureMips::GPUBlit)
+	{
+		UploadManager::QueueMipGeneration(m_Image, m_width, m_height, m_MipLevels);
+	}
+
+	m_UploadBatch = UploadManager::GetCurrentBatch();
+	m_HasContents = true;
+}
+
+uint8_t* Texture::AcquireUploadSlot(bool wholeImage)
+{
+	// Copies only queued so far simply pick up the newer contents. A slot a submitted copy may still
+	// read is left alone, the next one only has to be waited for when the CPU runs more frames ahead
+	// than there are slots.
+	uint64_t batch = m_UploadSlotBatches[m_UploadSlot];
+	if (batch && batch != UploadManager::GetCurrentBatch() && !UploadManager::IsComplete(batch))
+	{
+		if (!m_DirtyRects.IsEmpty())
+		{
+			// Pending rectangles live in this slot, only an early flush mid frame gets here
+			UploadManager::WaitForBatch(batch);
+		}
+		else
+		{
+			uint32_t previous = m_UploadSlot;
+			m_UploadSlot = (m_UploadSlot + 1) % (uint32_t)m_UploadSlotBatches.size();
+			batch = m_UploadSlotBatches[m_UploadSlot];
+			if (batch && !UploadManager::IsComplete(batch))
+				UploadManager::WaitForBatch(batch);
+
+			// Catch up on what was written while other slots were current. The previous slot is
+			// complete, so merged rectangles are fine to copy from it.
+			DirtyRectList& stale = m_UploadSlotStaleRects[m_UploadSlot];
+			if (!wholeImage)
+			{
+				uint32_t texelBytes = Utils::BytesPerPixel(m_Format);
+				size_t imagePitch = (size_t)m_width * texelBytes;
+				const uint8_t* source = (const uint8_t*)m_UploadBufferData + previous * m_UploadSlotSize;
+				uint8_t* destination = (uint8_t*)m_UploadBufferData + m_UploadSlot * m_UploadSlotSize;
+				for (const TextureRegion& rect : stale.Coalesce())
+				{
+					size_t offset = rect.Y * imagePitch + (size_t)rect.X * texelBytes;
+					Utils::CopyRows(destination + offset, imagePitch, source + offset, imagePitch, (size_t)rect.Width * texelBytes, rect.Height);
+				}
+			}
+			stale.Clear();
+		}
+	}
+
+	return (uint8_t*)m_UploadBufferData + m_UploadSlot * m_UploadSlotSize;
+}
+
+void Texture::MarkOtherSlotsStale(const TextureRegion& rect)
+{
+	for (uint32_t slot = 0; slot < (uint32_t)m_UploadSlotStaleRects.size(); slot++)
+	{
+		if (slot == m_UploadSlot)
+			continue;
+
+		DirtyRectList& stale = m_UploadSlotStaleRects[slot];
+		stale.Add(rect);
+		// Many small updates between rotations, keep the list short
+		if (stale.GetRects().size() > 64)
+			stale.Coalesce();
 	}
 }
@@ -1,14 +1,65 @@
 #pragma once
 #include <imgui.h>
 #include <vulkan/vulkan.h>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "DirtyRectList.h"
+#include "SamplerCache.h"
+
+struct Ktx2View;
+struct StagingAllocation;
+struct DeviceAllocation;
 
 enum class ImageFormat
 {
 	None = 0,
 	RGBA,
-	RGBA32F
+	RGBA32F,
+	// Half float, what HDR sources are decoded to. 8 bytes per texel against 16 for RGBA32F.
+	RGBA16F,
+
+	// Block compressed, 4x4 texel blocks. See TextureCompressor for the encoder.
+	BC1,  // RGB + 1 bit alpha, 8 bytes per block
+	BC3,  // RGBA, 16 bytes per block
+	BC4,  // R, 8 bytes per block
+	BC5,  // RG, 16 bytes per block
+	BC7   // RGBA high quality, 16 bytes per block
+};
+
+enum class TextureUsage
+{
+	// Uploaded once (or rarely) through the shared staging ring, no CPU side copy is kept
+	Static = 0,
+	// Keeps a persistently mapped upload slot per frame in flight for textures rewritten at runtime,
+	// so updates never wait on the copies of the previous frame
+	Dynamic,
+	// Rewritten every frame (previews, video, plots). One mapped upload slot per frame in flight,
+	// the copy is recorded into the frame's own command buffer, so writing frame N+1 never waits
+	// on the GPU reading frame N. Whole images only, no mips.
+	Streaming
+};
+
+enum class TextureMips
+{
+	// Single level, sampled as is
+	None = 0,
+	// Full chain blitted on the GPU from level 0 inside the upload batch
+	GPUBlit,
+	// Full chain box filtered on the CPU and uploaded with level 0, RGBA only
+	CPU
+};
+
+struct TextureSpecification
+{
+	ImageFormat Format = ImageFormat::RGBA;
+	TextureUsage Usage = TextureUsage::Static;
+	// Falls back to the other generator when the format can't use the requested one
+	TextureMips Mips = TextureMips::None;
+	// Shared through SamplerCache, textures with the same description use one VkSampler
+	SamplerDescription Sampler;
 };
 
 class Texture
@@ -24,35 +75,147 @@ public:
 	enum class TextureSourceType
 	{
 		VECTOR,
-		RASTER
+		RASTER,
+		// Cooked KTX2 container, mapped and copied straight into staging with its own mips/layers
+		KTX2
 	};
 
 	Texture(const char* path, float inScale = 1);
 	Texture(const char* path, TextureSourceType type, float inScale = 1, bool flipVertically = true);
 	Texture(std::string& path, TextureSourceType type, float inScale = 1, bool flipVertically = true);
+	Texture(uint32_t width, uint32_t height, ImageFormat format, const void* data = nullptr);
+	Texture(uint32_t width, uint32_t height, const TextureSpecification& specification, const void* data = nullptr);
+	// fileData is the whole KTX2 file the view was parsed from, it only has to live for the constructor
+	Texture(const Ktx2View& ktx2, const uint8_t* fileData);
 	~Texture();
 
+	// Queued on the UploadManager, lands before the next frame is rendered
 	void SetData(const void* data);
 
+	// Rewrites one rectangle of level 0 and keeps every other texel. rowPitch is the byte stride of
+	// data, 0 for tightly packed rows. Uncompressed formats only.
+	// Dynamic textures gather the rectangles of a frame and upload them as a few merged copies from
+	// FlushPendingUpdates; static ones copy each call through the staging ring right away.
+	// GPUBlit mips are regenerated, CPU mip chains keep their old contents.
+	void SetData(const TextureRegion& region, const void* data, uint32_t rowPitch = 0);
+
+	// Queues the merged dirty rectangles of every dynamic texture. Call once per frame on the
+	// render thread, before UploadManager::SubmitFrame.
+	static void FlushPendingUpdates();
+
+	// Records the copies of every streaming texture written since the last call into the frame's
+	// command buffer, outside a render pass. frameFence is signalled once that submit completes.
+	static void RecordStreamingCopies(VkCommandBuffer commandBuffer, VkFence frameFence);
+
+	// Records a copy of the first mip level no larger than maxSize on either side into a new static
+	// texture, blitting down from the smallest level above it when the chain doesn't reach that far.
+	// The copy is valid once commandBuffer has executed. nullptr when nothing smaller can be made
+	// (array textures, never uploaded ones, compressed images without a small enough level).
+	std::unique_ptr<Texture> CreateReducedCopy(uint32_t maxSize, VkCommandBuffer commandBuffer);
+
+	// Upload batch holding the most recent SetData, see UploadManager::IsComplete
+	uint64_t GetUploadBatch() const { return m_UploadBatch; }
+
 	VkDescriptorSet GetDescriptorSet() const { return m_DescriptorSet; }
 
+	TextureUsage GetUsage() const { return m_Usage; }
+	ImageFormat GetFormat() const { return m_Format; }
+
+	// False when a file source could not be loaded, nothing was created on the GPU
+	bool IsLoaded() const { return m_Image != nullptr; }
+
+	// Generator actually in use after format fallbacks
+	TextureMips GetMips() const { return m_Mips; }
+	const SamplerDescription& GetSamplerDescription() const { return m_SamplerDescription; }
+	uint32_t GetMipLevels() const { return m_MipLevels; }
+	uint32_t GetArrayLayers() const { return m_ArrayLayers; }
+
+	// ImGui draws layer 0 through the descriptor set, this view covers every layer
+	VkImageView GetArrayImageView() const { return m_ArrayImageView; }
+
+	// Device local bytes backing the image
+	uint64_t GetResidentBytes() const { return m_ResidentBytes; }
+	// Host visible bytes this texture keeps alive, only non zero for dynamic textures
+	uint64_t GetStagingBytes() const { return m_StagingBytes; }
+
+	static VkFormat GetVulkanFormat(ImageFormat format);
+	// ImageFormat::None for formats Texture can't create
+	static ImageFormat GetImageFormat(VkFormat format);
+	static bool IsCompressed(ImageFormat format);
+	// Tightly packed bytes of one width x height level, rounded up to whole blocks when compressed
+	static uint64_t GetImageSize(ImageFormat format, uint32_t width, uint32_t height);
+	// False when the device can't sample the format, e.g. BC without textureCompressionBC
+	static bool IsFormatSupported(ImageFormat format);
+
+	static uint64_t GetTotalResidentBytes();
+	// Persistent upload buffers of dynamic textures plus the staging ring space still in flight
+	static uint64_t GetTotalStagingBytes();
+
 private:
 	void LoadRasterImage(const char* path, float inScale = 1, bool flipVertically = true);
 	void LoadVectorImage(const char* path, float inScale = 1);
+	void LoadKtx2Image(const char* path);
+	bool InitializeFromKtx2(const Ktx2View& ktx2, const uint8_t* fileData);
 
 	void AllocateMemory(uint64_t size);
+	void AllocateUploadBuffer(uint64_t size);
+	void AllocateUploadSlots(uint64_t size);
+	void CreateImage(VkImage& image);
+	void CreateImageViews();
+	// DeviceMemoryAllocator::Defragment callback, moves the image to (memory, offset) and records the
+	// copy of its contents into commandBuffer. release destroys the old image once that executed.
+	bool RelocateImage(VkDeviceMemory memory, VkDeviceSize offset, VkCommandBuffer commandBuffer, std::function<void()>& release);
+
+	void AllocateStreamingSlots(uint64_t size);
+	void WriteStreamingSlot(const void* data);
+
+	void FlushDirtyRects();
+	void QueueRegionCopies(const StagingAllocation& staging, const VkBufferImageCopy* regions, uint32_t regionCount);
+	// Slot of the upload buffer that is safe to write now, see m_UploadSlotBatches. A slot rotated to
+	// is brought up to date first unless the caller is about to overwrite all of level 0.
+	uint8_t* AcquireUploadSlot(bool wholeImage = false);
+	// Marks the other slots as behind the current one inside rect
+	void MarkOtherSlotsStale(const TextureRegion& rect);
 
 	VkImage m_Image = nullptr;
 	VkImageView m_ImageView = nullptr;
-	VkDeviceMemory m_Memory = nullptr;
+	VkImageView m_ArrayImageView = nullptr;
+	DeviceAllocation* m_Allocation = nullptr;
 	VkSampler m_Sampler = nullptr;
+	SamplerDescription m_SamplerDescription;
 
 	ImageFormat m_Format = ImageFormat::None;
+	TextureUsage m_Usage = TextureUsage::Static;
+	TextureMips m_Mips = TextureMips::None;
+	uint32_t m_MipLevels = 1;
+	uint32_t m_ArrayLayers = 1;
+
+	// Dynamic textures only. Slot i starts at i * m_UploadSlotSize with level 0 laid out like the
+	// image, so region updates land where a copy of the same rectangle reads them back.
+	// m_UploadSlotBatches[i] is the upload batch that last copied from slot i. The current slot always
+	// holds all of level 0, m_UploadSlotStaleRects[i] is where slot i is behind it.
+	VkBuffer m_UploadBuffer = nullptr;
+	DeviceAllocation* m_UploadAllocation = nullptr;
+	void* m_UploadBufferData = nullptr;
+	DirtyRectList m_DirtyRects;
+	std::vector<uint64_t> m_UploadSlotBatches;
+	std::vector<DirtyRectList> m_UploadSlotStaleRects;
+	VkDeviceSize m_UploadSlotSize = 0;
+	uint32_t m_UploadSlot = 0;
+
+	// Streaming textures only. Slot i starts at i * m_StreamSlotSize in the upload buffer and may
+	// be rewritten once m_StreamSlotFences[i] (the frame that last copied from it) has signalled.
+	std::vector<VkFence> m_StreamSlotFences;
+	VkDeviceSize m_StreamSlotSize = 0;
+	uint32_t m_StreamWriteSlot = 0;
+	bool m_StreamPending = false;
 
-	VkBuffer m_StagingBuffer = nullptr;
-	VkDeviceMemory m_StagingBufferMemory = nullptr;
+	// Once something was uploaded the image sits in SHADER_READ_ONLY_OPTIMAL with valid texels
+	bool m_HasContents = false;
 
-	size_t m_AlignedSize = 0;
+	uint64_t m_UploadBatch = 0;
+	uint64_t m_ResidentBytes = 0;
+	uint64_t m_StagingBytes = 0;
 
 	VkDescriptorSet m_DescriptorSet = nullptr;
 };
@@ -0,0 +1,328 @@
+#include "TextureAtlas.h"
+#include "Texture.h"
+#include "TextureLoader.h"
+#include "ImageDecoder.h"
+
+#include "../Core/JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+
+struct TextureAtlas::PendingQueue
+{
+	std::mutex Mutex;
+	std::vector<PendingImage> Images;
+	std::atomic<uint32_t> Jobs{ 0 };
+};
+
+SkylinePacker::SkylinePacker(uint32_t width, uint32_t height)
+	: m_Width(width), m_Height(height)
+{
+	m_Skyline.push_back({ 0, 0, width });
+}
+
+int64_t SkylinePacker::Fit(size_t index, uint32_t width, uint32_t height) const
+{
+	uint32_t x = m_Skyline[index].X;
+	if (x + width > m_Width)
+		return -1;
+
+	uint32_t y = 0;
+	int64_t widthLeft = width;
+	for (size_t i = index; widthLeft > 0; i++)
+	{
+		y = std::max(y, m_Skyline[i].Y);
+		if (y + height > m_Height)
+			return -1;
+		widthLeft -= m_Skyline[i].Width;
+	}
+	return y;
+}
+
+bool SkylinePacker::Pack(uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY)
+{
+	size_t bestIndex = SIZE_MAX;
+	uint32_t bestBottom = UINT32_MAX;
+	uint32_t bestWidth = UINT32_MAX;
+
+	// Lowest top edge wins, ties go to the narrowest segment
+	for (size_t i = 0; i < m_Skyline.size(); i++)
+	{
+		int64_t y = Fit(i, width, height);
+		if (y < 0)
+			continue;
+
+		uint32_t bottom = (uint32_t)y + height;
+		if (bottom < bestBottom || (bottom == bestBottom && m_Skyline[i].Width < bestWidth))
+		{
+			bestIndex = i;
+			bestBottom = bottom;
+			bestWidth = m_Skyline[i].Width;
+			outX = m_Skyline[i].X;
+			outY = (uint32_t)y;
+		}
+	}
+
+	if (bestIndex == SIZE_MAX)
+		return false;
+
+	m_Skyline.insert(m_Skyline.begin() + bestIndex, { outX, outY + height, width });
+
+	// Trim the segments the new one now covers
+	for (size_t i = bestIndex + 1; i < m_Skyline.size();)
+	{
+		Node& previous = m_Skyline[i - 1];
+		Node& node = m_Skyline[i];
+		uint32_t previousEnd = previous.X + previous.Width;
+		if (node.X >= previousEnd)
+			break;
+
+		uint32_t shrink = previousEnd - node.X;
+		if (node.Width <= shrink)
+		{
+			m_Skyline.erase(m_Skyline.begin() + i);
+			continue;
+		}
+
+		node.X += shrink;
+		node.Width -= shrink;
+		break;
+	}
+
+	// Merge neighbours at the same height
+	for (size_t i = 0; i + 1 < m_Skyline.size();)
+	{
+		if (m_Skyline[i].Y == m_Skyline[i + 1].Y)
+		{
+			m_Skyline[i].Width += m_Skyline[i + 1].Width;
+			m_Skyline.erase(m_Skyline.begin() + i + 1);
+			continue;
+		}
+		i++;
+	}
+
+	return true;
+}
+
+TextureAtlas::TextureAtlas(uint32_t pageSize, uint32_t padding)
+	: m_PageSize(pageSize), m_Padding(padding), m_Pending(std::make_shared<PendingQueue>())
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+}
+
+void TextureAtlas::AddImage(const std::string& name, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+	PendingImage image;
+	image.Name = name;
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.assign(rgba, rgba + (size_t)width * height * 4);
+
+	std::lock_guard<std::mutex> lock(m_Pending->Mutex);
+	m_Pending->Images.push_back(std::move(image));
+}
+
+void TextureAtlas::AddDirectoryAsync(const std::string& directory, bool flipVertically)
+{
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ".png")
+			continue;
+
+		std::string name = entry.path().stem().string();
+		if (m_Regions.find(name) != m_Regions.end())
+			continue;
+
+		std::shared_ptr<PendingQueue> pending = m_Pending;
+		std::string path = entry.path().string();
+		pending->Jobs++;
+		JobSystem::Submit([pending, name, path, flipVertically]()
+		{
+			DecodedImage decoded;
+			if (ImageDecoder::DecodeRGBA(path, flipVertically, decoded))
+			{
+				PendingImage image;
+				image.Name = name;
+				image.Width = decoded.GetWidth();
+				image.Height = decoded.GetHeight();
+				image.Pixels.assign(decoded.GetPixels(), decoded.GetPixels() + decoded.GetSize());
+
+				std::lock_guard<std::mutex> lock(pending->Mutex);
+				pending->Images.push_back(std::move(image));
+			}
+			else
+			{
+				std::cout << "TextureAtlas: failed to load " << path << ": " << ImageDecoder::GetFailureReason() << "\n";
+			}
+
+			pending->Jobs--;
+		});
+	}
+
+	if (error)
+	{
+		std::cout << "TextureAtlas: could not read " << directory << ": " << error.message() << "\n";
+	}
+}
+
+void TextureAtlas::Update()
+{
+	std::vector<PendingImage> images;
+	{
+		std::lock_guard<std::mutex> lock(m_Pending->Mutex);
+		images.swap(m_Pending->Images);
+	}
+
+	if (!images.empty())
+	{
+		// Tallest first packs a skyline noticeably tighter
+		std::sort(images.begin(), images.end(), [](const PendingImage& a, const PendingImage& b) { return a.Height > b.Height; });
+		for (PendingImage& image : images)
+		{
+			Insert(image);
+		}
+	}
+}
+
+void TextureAtlas::Insert(PendingImage& image)
+{
+	if (image.Width == 0 || image.Height == 0 || m_Regions.find(image.Name) != m_Regions.end())
+		return;
+
+	uint32_t paddedWidth = image.Width + m_Padding * 2;
+	uint32_t paddedHeight = image.Height + m_Padding * 2;
+
+	uint32_t pageIndex = 0;
+	uint32_t x = 0, y = 0;
+	bool packed = false;
+	for (; pageIndex < (uint32_t)m_Pages.size(); pageIndex++)
+	{
+		if (m_Pages[pageIndex]->Packer.Pack(paddedWidth, paddedHeight, x, y))
+		{
+			packed = true;
+			break;
+		}
+	}
+
+	if (!packed)
+	{
+		// Oversized images get a page of their own
+		uint32_t size = std::max(m_PageSize, std::max(paddedWidth, paddedHeight));
+		pageIndex = (uint32_t)m_Pages.size();
+		CreatePage(size).Packer.Pack(paddedWidth, paddedHeight, x, y);
+	}
+
+	Page& page = *m_Pages[pageIndex];
+	uint32_t stride = paddedWidth * 4;
+
+	// Copy with the border extruded into the padding so linear filtering never picks up a neighbour
+	std::vector<uint8_t> padded((size_t)stride * paddedHeight);
+	for (uint32_t row = 0; row < paddedHeight; row++)
+	{
+		uint32_t sourceRow = (uint32_t)std::min<int64_t>(std::max<int64_t>((int64_t)row - m_Padding, 0), image.Height - 1);
+		const uint8_t* source = image.Pixels.data() + (size_t)sourceRow * image.Width * 4;
+		uint8_t* destination = padded.data() + (size_t)row * stride;
+
+		for (uint32_t column = 0; column < m_Padding; column++)
+		{
+			memcpy(destination + column * 4, source, 4);
+			memcpy(destination + (m_Padding + image.Width + column) * 4, source + (image.Width - 1) * 4, 4);
+		}
+		memcpy(destination + m_Padding * 4, source, (size_t)image.Width * 4);
+	}
+
+	TextureRegion rect;
+	rect.X = x;
+	rect.Y = y;
+	rect.Width = paddedWidth;
+	rect.Height = paddedHeight;
+	page.PageTexture->SetData(rect, padded.data());
+
+	AtlasRegion region;
+	region.Page = pageIndex;
+	region.Width = image.Width;
+	region.Height = image.Height;
+	region.UV0 = ImVec2((float)(x + m_Padding) / page.Size, (float)(y + m_Padding) / page.Size);
+	region.UV1 = ImVec2((float)(x + m_Padding + image.Width) / page.Size, (float)(y + m_Padding + image.Height) / page.Size);
+	m_Regions[image.Name] = region;
+}
+
+TextureAtlas::Page& TextureAtlas::CreatePage(uint32_t size)
+{
+	std::unique_ptr<Page> page = std::make_unique<Page>();
+	page->Size = size;
+	page->Packer = SkylinePacker(size, size);
+
+	// Rewritten whenever icons are added, so it keeps its own upload buffer. Starts cleared,
+	// later rectangle updates preserve whatever is around them.
+	TextureSpecification specification;
+	specification.Format = ImageFormat::RGBA;
+	specification.Usage = TextureUsage::Dynamic;
+	// Icons are sampled as sub rectangles, wrapping around would bleed the opposite edge in
+	specification.Sampler.AddressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	specification.Sampler.AddressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	std::vector<uint8_t> clear((size_t)size * size * 4, 0);
+	page->PageTexture = std::make_unique<Texture>(size, size, specification, clear.data());
+
+	m_Pages.push_back(std::move(page));
+	return *m_Pages.back();
+}
+
+const AtlasRegion* TextureAtlas::Find(const std::string& name) const
+{
+	auto it = m_Regions.find(name);
+	return it != m_Regions.end() ? &it->second : nullptr;
+}
+
+ImVec2 TextureAtlas::GetSize(const std::string& name) const
+{
+	const AtlasRegion* region = Find(name);
+	return region ? ImVec2((float)region->Width, (float)region->Height) : ImVec2(0, 0);
+}
+
+bool TextureAtlas::Image(const std::string& name, const ImVec2& size, const ImVec4& tint) const
+{
+	const AtlasRegion* region = Find(name);
+	if (!region)
+	{
+		ImGui::Image((ImTextureID)TextureLoader::GetPlaceholderDescriptorSet(), size);
+		return false;
+	}
+
+	ImGui::Image((ImTextureID)GetDescriptorSet(region->Page), size, region->UV0, region->UV1, tint);
+	return true;
+}
+
+bool TextureAtlas::ImageButton(const std::string& name, const ImVec2& size, int framePadding, const ImVec4& background, const ImVec4& tint) const
+{
+	// ImageButton derives its id from the texture, which every icon on a page shares
+	ImGui::PushID(name.c_str());
+
+	bool pressed;
+	const AtlasRegion* region = Find(name);
+	if (region)
+		pressed = ImGui::ImageButton((ImTextureID)GetDescriptorSet(region->Page), size, region->UV0, region->UV1, framePadding, background, tint);
+	else
+		pressed = ImGui::ImageButton((ImTextureID)TextureLoader::GetPlaceholderDescriptorSet(), size, ImVec2(0, 0), ImVec2(1, 1), framePadding, background, tint);
+
+	ImGui::PopID();
+	return pressed;
+}
+
+VkDescriptorSet TextureAtlas::GetDescriptorSet(uint32_t page) const
+{
+	return page < m_Pages.size() ? m_Pages[page]->PageTexture->GetDescriptorSet() : VK_NULL_HANDLE;
+}
+
+bool TextureAtlas::IsLoading() const
+{
+	return m_Pending->Jobs.load() > 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <imgui.h>
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Texture;
+
+struct AtlasRegion
+{
+	uint32_t Page = 0;
+	ImVec2 UV0;
+	ImVec2 UV1;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+};
+
+// Bottom-left skyline rectangle packer
+class SkylinePacker
+{
+public:
+	SkylinePacker(uint32_t width = 0, uint32_t height = 0);
+
+	bool Pack(uint32_t width, uint32_t height, uint32_t& outX, uint32_t& outY);
+
+private:
+	struct Node
+	{
+		uint32_t X;
+		uint32_t Y;
+		uint32_t Width;
+	};
+
+	// Lowest y a width x height rect can sit at when its left edge is at node index, -1 if it doesn't fit
+	int64_t Fit(size_t index, uint32_t width, uint32_t height) const;
+
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	std::vector<Node> m_Skyline;
+};
+
+// Packs many small RGBA images (editor icons) into a few shared pages so everything drawn from
+// one page shares a descriptor set and ImGui can merge the draw commands.
+// Images can be added at any time; existing regions never move, only the rectangles of new
+// images are uploaded. Render thread only, except for the decode jobs AddDirectoryAsync starts.
+class TextureAtlas
+{
+public:
+	TextureAtlas(uint32_t pageSize = 1024, uint32_t padding = 1);
+	~TextureAtlas();
+
+	// Copies the pixels, they are packed and uploaded on the next Update
+	void AddImage(const std::string& name, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+	// Decodes every .png in directory on the job system. Images are named by file stem,
+	// names already in the atlas are skipped.
+	void AddDirectoryAsync(const std::string& directory, bool flipVertically = false);
+
+	// Packs everything added or decoded since the last call and queues their rectangles.
+	// Call once per frame before ImGui::NewFrame.
+	void Update();
+
+	// nullptr until the image has been packed
+	const AtlasRegion* Find(const std::string& name) const;
+
+	// Size of the image in pixels, zero while it is still loading
+	ImVec2 GetSize(const std::string& name) const;
+
+	// ImGui::Image / ImageButton with the region's UVs. Draws the loader placeholder until the
+	// image is packed; returns false in that case (or the button's pressed state).
+	bool Image(const std::string& name, const ImVec2& size, const ImVec4& tint = ImVec4(1, 1, 1, 1)) const;
+	bool ImageButton(const std::string& name, const ImVec2& size, int framePadding = -1, const ImVec4& background = ImVec4(0, 0, 0, 0), const ImVec4& tint = ImVec4(1, 1, 1, 1)) const;
+
+	uint32_t GetPageCount() const { return (uint32_t)m_Pages.size(); }
+	VkDescriptorSet GetDescriptorSet(uint32_t page) const;
+
+	// Decode jobs still running
+	bool IsLoading() const;
+
+private:
+	struct PendingImage
+	{
+		std::string Name;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		std::vector<uint8_t> Pixels;
+	};
+
+	// Shared with decode jobs so they can finish safely after the atlas is gone
+	struct PendingQueue;
+
+	struct Page
+	{
+		uint32_t Size = 0;
+		SkylinePacker Packer;
+		// Dynamic, new icons go up as rectangle updates that keep the rest of the page
+		std::unique_ptr<Texture> PageTexture;
+	};
+
+	void Insert(PendingImage& image);
+	Page& CreatePage(uint32_t size);
+
+	uint32_t m_PageSize = 1024;
+	uint32_t m_Padding = 1;
+
+	std::vector<std::unique_ptr<Page>> m_Pages;
+	std::unordered_map<std::string, AtlasRegion> m_Regions;
+	std::shared_ptr<PendingQueue> m_Pending;
+};
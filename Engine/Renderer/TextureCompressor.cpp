@@ -0,0 +1,437 @@
+#include "TextureCompressor.h"
+#include "MipGenerator.h"
+#include "Ktx2.h"
+#include "ImageDecoder.h"
+
+#include "../Core/JobSystem.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TEXTURECOMPRESSOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Utils {
+
+	// Gathers a 4x4 RGBA block, clamping at the right and bottom edges
+	static void FetchBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t block[64])
+	{
+		uint32_t x0 = blockX * 4;
+		uint32_t y0 = blockY * 4;
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			uint32_t sy = std::min(y0 + y, height - 1);
+			const uint8_t* row = rgba + (uint64_t)sy * width * 4;
+			if (x0 + 4 <= width)
+			{
+				memcpy(block + y * 16, row + x0 * 4, 16);
+				continue;
+			}
+
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				uint32_t sx = std::min(x0 + x, width - 1);
+				memcpy(block + y * 16 + x * 4, row + sx * 4, 4);
+			}
+		}
+	}
+
+	static void GetBlockMinMax(const uint8_t block[64], uint8_t outMin[4], uint8_t outMax[4])
+	{
+#ifdef TEXTURECOMPRESSOR_SSE2
+		__m128i minimum = _mm_loadu_si128((const __m128i*)block);
+		__m128i maximum = minimum;
+		for (uint32_t i = 1; i < 4; i++)
+		{
+			__m128i texels = _mm_loadu_si128((const __m128i*)(block + i * 16));
+			minimum = _mm_min_epu8(minimum, texels);
+			maximum = _mm_max_epu8(maximum, texels);
+		}
+
+		// Fold the four texels of each register down to one
+		minimum = _mm_min_epu8(minimum, _mm_srli_si128(minimum, 8));
+		minimum = _mm_min_epu8(minimum, _mm_srli_si128(minimum, 4));
+		maximum = _mm_max_epu8(maximum, _mm_srli_si128(maximum, 8));
+		maximum = _mm_max_epu8(maximum, _mm_srli_si128(maximum, 4));
+
+		int32_t packedMin = _mm_cvtsi128_si32(minimum);
+		int32_t packedMax = _mm_cvtsi128_si32(maximum);
+		memcpy(outMin, &packedMin, 4);
+		memcpy(outMax, &packedMax, 4);
+#else
+		memcpy(outMin, block, 4);
+		memcpy(outMax, block, 4);
+		for (uint32_t i = 1; i < 16; i++)
+		{
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				outMin[c] = std::min(outMin[c], block[i * 4 + c]);
+				outMax[c] = std::max(outMax[c], block[i * 4 + c]);
+			}
+		}
+#endif
+	}
+
+	// dot(texel - base, axis) for all 16 texels of a block
+	static void ProjectBlock(const uint8_t block[64], const int16_t base[4], const int16_t axis[4], int32_t out[16])
+	{
+#ifdef TEXTURECOMPRESSOR_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i baseVector = _mm_setr_epi16(base[0], base[1], base[2], base[3], base[0], base[1], base[2], base[3]);
+		const __m128i axisVector = _mm_setr_epi16(axis[0], axis[1], axis[2], axis[3], axis[0], axis[1], axis[2], axis[3]);
+
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			__m128i texels = _mm_loadu_si128((const __m128i*)(block + i * 16));
+			__m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(texels, zero), baseVector);
+			__m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(texels, zero), baseVector);
+
+			// [rg, ba] partial sums per texel, then add the pairs
+			__m128i productLo = _mm_madd_epi16(lo, axisVector);
+			__m128i productHi = _mm_madd_epi16(hi, axisVector);
+			productLo = _mm_add_epi32(productLo, _mm_shuffle_epi32(productLo, _MM_SHUFFLE(2, 3, 0, 1)));
+			productHi = _mm_add_epi32(productHi, _mm_shuffle_epi32(productHi, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			__m128 dots = _mm_shuffle_ps(_mm_castsi128_ps(productLo), _mm_castsi128_ps(productHi), _MM_SHUFFLE(2, 0, 2, 0));
+			_mm_storeu_si128((__m128i*)(out + i * 4), _mm_castps_si128(dots));
+		}
+#else
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			int32_t dot = 0;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				dot += (block[i * 4 + c] - base[c]) * axis[c];
+			}
+			out[i] = dot;
+		}
+#endif
+	}
+
+	// round(dot * steps / length2), clamped to [0, steps]
+	static uint32_t QuantizeProjection(int32_t dot, int32_t length2, int32_t steps)
+	{
+		if (dot <= 0 || length2 == 0)
+			return 0;
+
+		int32_t step = (dot * steps * 2 + length2) / (length2 * 2);
+		return (uint32_t)std::min(step, steps);
+	}
+
+	static uint16_t To565(const uint8_t color[4])
+	{
+		return (uint16_t)(((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+	}
+
+	static void From565(uint16_t packed, int16_t color[4])
+	{
+		uint32_t r = (packed >> 11) & 31;
+		uint32_t g = (packed >> 5) & 63;
+		uint32_t b = packed & 31;
+		color[0] = (int16_t)((r << 3) | (r >> 2));
+		color[1] = (int16_t)((g << 2) | (g >> 4));
+		color[2] = (int16_t)((b << 3) | (b >> 2));
+		color[3] = 0;
+	}
+
+	// Colour half of BC1/BC3. With allowTransparency, texels with alpha < 128 switch the block
+	// to BC1's three colour mode and use the transparent index.
+	static void EncodeColorBlock(const uint8_t block[64], bool allowTransparency, uint8_t out[8])
+	{
+		uint8_t minimum[4], maximum[4];
+		GetBlockMinMax(block, minimum, maximum);
+
+		bool transparent = allowTransparency && minimum[3] < 128;
+
+		// Pull the box in slightly, the extremes are rarely the best endpoints
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint8_t inset = (uint8_t)((maximum[c] - minimum[c]) >> 4);
+			minimum[c] += inset;
+			maximum[c] -= inset;
+		}
+
+		// Four colour mode needs c0 > c1, three colour mode c0 <= c1
+		uint16_t c0 = transparent ? To565(minimum) : To565(maximum);
+		uint16_t c1 = transparent ? To565(maximum) : To565(minimum);
+
+		uint32_t indices = 0;
+		if (c0 != c1 || transparent)
+		{
+			int16_t e0[4], e1[4], axis[4];
+			From565(c0, e0);
+			From565(c1, e1);
+			int32_t length2 = 0;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				axis[c] = e1[c] - e0[c];
+				length2 += axis[c] * axis[c];
+			}
+
+			int32_t dots[16];
+			ProjectBlock(block, e0, axis, dots);
+
+			// Palette order along the c0 -> c1 line
+			static const uint32_t order4[4] = { 0, 2, 3, 1 };
+			static const uint32_t order3[3] = { 0, 2, 1 };
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t index;
+				if (transparent)
+					index = block[i * 4 + 3] < 128 ? 3 : order3[QuantizeProjection(dots[i], length2, 2)];
+				else
+					index = order4[QuantizeProjection(dots[i], length2, 3)];
+				indices |= index << (i * 2);
+			}
+		}
+
+		out[0] = (uint8_t)(c0 & 0xFF);
+		out[1] = (uint8_t)(c0 >> 8);
+		out[2] = (uint8_t)(c1 & 0xFF);
+		out[3] = (uint8_t)(c1 >> 8);
+		memcpy(out + 4, &indices, 4);
+	}
+
+	// BC4 block from one channel of an RGBA block, also the alpha half of BC3
+	static void EncodeChannelBlock(const uint8_t block[64], uint32_t channel, uint8_t out[8])
+	{
+		uint8_t minimum = 255, maximum = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			minimum = std::min(minimum, block[i * 4 + channel]);
+			maximum = std::max(maximum, block[i * 4 + channel]);
+		}
+
+		// a0 > a1 selects the eight value ramp
+		out[0] = maximum;
+		out[1] = minimum;
+
+		uint64_t indices = 0;
+		int32_t range = maximum - minimum;
+		if (range > 0)
+		{
+			static const uint64_t order[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				int32_t distance = maximum - block[i * 4 + channel];
+				indices |= order[QuantizeProjection(distance, range, 7)] << (i * 3);
+			}
+		}
+
+		for (uint32_t i = 0; i < 6; i++)
+		{
+			out[2 + i] = (uint8_t)(indices >> (i * 8));
+		}
+	}
+
+	struct BlockBitWriter
+	{
+		uint8_t* Data;
+		uint32_t Bit = 0;
+
+		void Write(uint32_t value, uint32_t count)
+		{
+			for (uint32_t i = 0; i < count; i++, Bit++)
+			{
+				if ((value >> i) & 1)
+					Data[Bit >> 3] |= (uint8_t)(1 << (Bit & 7));
+			}
+		}
+	};
+
+	// Picks the shared p-bit that reconstructs an RGBA endpoint best from 7 bit channels
+	static void QuantizeBC7Endpoint(const uint8_t color[4], uint8_t quantized[4], uint32_t& pBit)
+	{
+		int32_t bestError = INT32_MAX;
+		for (uint32_t p = 0; p < 2; p++)
+		{
+			uint8_t candidate[4];
+			int32_t error = 0;
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				int32_t q = std::min(std::max((color[c] - (int32_t)p + 1) >> 1, 0), 127);
+				candidate[c] = (uint8_t)q;
+				error += std::abs(((q << 1) | (int32_t)p) - color[c]);
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				pBit = p;
+				memcpy(quantized, candidate, 4);
+			}
+		}
+	}
+
+	// BC7 mode 6: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4 bit indices
+	static void EncodeBC7Block(const uint8_t block[64], uint8_t out[16])
+	{
+		uint8_t minimum[4], maximum[4];
+		GetBlockMinMax(block, minimum, maximum);
+
+		uint8_t q0[4], q1[4];
+		uint32_t p0 = 0, p1 = 0;
+		QuantizeBC7Endpoint(minimum, q0, p0);
+		QuantizeBC7Endpoint(maximum, q1, p1);
+
+		int16_t e0[4], axis[4];
+		int32_t length2 = 0;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			e0[c] = (int16_t)((q0[c] << 1) | p0);
+			axis[c] = (int16_t)(((q1[c] << 1) | p1) - e0[c]);
+			length2 += axis[c] * axis[c];
+		}
+
+		int32_t dots[16];
+		ProjectBlock(block, e0, axis, dots);
+
+		uint32_t indices[16];
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			indices[i] = QuantizeProjection(dots[i], length2, 15);
+		}
+
+		// The anchor index is stored with its top bit implied zero
+		if (indices[0] & 8)
+		{
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				indices[i] = 15 - indices[i];
+			}
+		}
+
+		memset(out, 0, 16);
+		BlockBitWriter writer{ out };
+		writer.Write(1 << 6, 7);
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			writer.Write(q0[c], 7);
+			writer.Write(q1[c], 7);
+		}
+		writer.Write(p0, 1);
+		writer.Write(p1, 1);
+		writer.Write(indices[0], 3);
+		for (uint32_t i = 1; i < 16; i++)
+		{
+			writer.Write(indices[i], 4);
+		}
+	}
+
+	static void EncodeBlock(ImageFormat format, const uint8_t block[64], uint8_t* out)
+	{
+		switch (format)
+		{
+		case ImageFormat::BC1:
+			EncodeColorBlock(block, true, out);
+			break;
+		case ImageFormat::BC3:
+			EncodeChannelBlock(block, 3, out);
+			EncodeColorBlock(block, false, out + 8);
+			break;
+		case ImageFormat::BC4:
+			EncodeChannelBlock(block, 0, out);
+			break;
+		case ImageFormat::BC5:
+			EncodeChannelBlock(block, 0, out);
+			EncodeChannelBlock(block, 1, out + 8);
+			break;
+		case ImageFormat::BC7:
+			EncodeBC7Block(block, out);
+			break;
+		}
+	}
+
+}
+
+bool TextureCompressor::Compress(ImageFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output)
+{
+	if (!Texture::IsCompressed(format) || width == 0 || height == 0)
+		return false;
+
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	uint64_t blockBytes = Texture::GetImageSize(format, 4, 4);
+
+	// One job per row of blocks
+	JobSystem::ParallelFor(blocksY, [&](uint32_t blockY)
+	{
+		uint8_t block[64];
+		uint8_t* rowOutput = output + (uint64_t)blockY * blocksX * blockBytes;
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+		{
+			Utils::FetchBlock(rgba, width, height, blockX, blockY, block);
+			Utils::EncodeBlock(format, block, rowOutput + blockX * blockBytes);
+		}
+	});
+
+	return true;
+}
+
+bool TextureCompressor::CookTexture(const std::string& sourcePath, const std::string& outputPath, ImageFormat format, bool generateMips, bool flipVertically)
+{
+	if (format != ImageFormat::RGBA && !Texture::IsCompressed(format))
+	{
+		std::cout << "CookTexture: unsupported target format for " << sourcePath << "\n";
+		return false;
+	}
+
+	DecodedImage decoded;
+	if (!ImageDecoder::DecodeRGBA(sourcePath, flipVertically, decoded))
+	{
+		std::cout << "CookTexture: failed to load " << sourcePath << ": " << ImageDecoder::GetFailureReason() << "\n";
+		return false;
+	}
+
+	const uint8_t* pixels = decoded.GetPixels();
+	uint32_t width = decoded.GetWidth();
+	uint32_t height = decoded.GetHeight();
+
+	uint32_t mipLevels = generateMips ? MipGenerator::GetMipLevelCount(width, height) : 1;
+	std::vector<uint8_t> chain(MipGenerator::GetMipChainSize(width, height, mipLevels));
+	MipGenerator::GenerateMipChainRGBA8(pixels, width, height, mipLevels, chain.data());
+
+	Ktx2Image image;
+	image.Format = Texture::GetVulkanFormat(format);
+	image.Width = width;
+	image.Height = height;
+	image.Levels.resize(mipLevels);
+
+	uint64_t sourceBytes = 0;
+	const uint8_t* source = pixels;
+	for (uint32_t level = 0; level < mipLevels; level++)
+	{
+		uint32_t levelWidth = MipGenerator::GetMipDimension(width, level);
+		uint32_t levelHeight = MipGenerator::GetMipDimension(height, level);
+		uint64_t levelSourceBytes = (uint64_t)levelWidth * levelHeight * 4;
+
+		std::vector<uint8_t>& payload = image.Levels[level];
+		payload.resize(Texture::GetImageSize(format, levelWidth, levelHeight));
+		if (Texture::IsCompressed(format))
+			Compress(format, source, levelWidth, levelHeight, payload.data());
+		else
+			memcpy(payload.data(), source, levelSourceBytes);
+
+		sourceBytes += levelSourceBytes;
+		source = level == 0 ? chain.data() : source + levelSourceBytes;
+	}
+
+	decoded.Reset();
+
+	uint64_t cookedBytes = 0;
+	for (const std::vector<uint8_t>& payload : image.Levels)
+	{
+		cookedBytes += payload.size();
+	}
+	std::cout << "[cook] " << sourcePath << " -> " << outputPath << ", " << mipLevels << " levels, " << sourceBytes << " -> " << cookedBytes << " bytes\n";
+
+	return Ktx2::Write(outputPath, image);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "Texture.h"
+#include <stdint.h>
+#include <string>
+
+// CPU block compressor for the BC formats in ImageFormat. Encoding is split across the
+// JobSystem by rows of blocks; the per block math uses SSE2 where it is available.
+// Quality is tuned for speed (bounding box endpoints, projected indices), which is plenty
+// for editor icons and UI art.
+class TextureCompressor
+{
+public:
+	// Encodes a tightly packed RGBA8 image. output must hold Texture::GetImageSize(format, width, height) bytes.
+	// BC4 takes the red channel, BC5 red and green.
+	static bool Compress(ImageFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* output);
+
+	// Offline cook step: decodes sourcePath with stb_image, optionally builds a box filtered mip
+	// chain, compresses every level and writes the result as a KTX2 file.
+	static bool CookTexture(const std::string& sourcePath, const std::string& outputPath, ImageFormat format, bool generateMips = true, bool flipVertically = false);
+};
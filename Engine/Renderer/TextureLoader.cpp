@@ -0,0 +1,261 @@
+#include "TextureLoader.h"
+#include "Texture.h"
+#include "UploadManager.h"
+#include "Ktx2.h"
+#include "ImageDecoder.h"
+#include "SvgRasterizer.h"
+#include "TextureResidency.h"
+#include "TextureRegistry.h"
+
+#include "../AstranEditorUI.h"
+#include "../Core/JobSystem.h"
+#include "../Core/MappedFile.h"
+
+#include <mutex>
+#include <vector>
+
+static Texture*                                    g_Placeholder = nullptr;
+static std::vector<std::shared_ptr<AsyncTexture>>  g_UploadingTextures;
+
+static std::mutex                                  g_DecodedMutex;
+static std::vector<std::shared_ptr<AsyncTexture>>  g_DecodedTextures;
+
+namespace Utils {
+
+	static bool HasExtension(const std::string& path, const std::string& extension)
+	{
+		return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+	}
+
+	static bool IsKtx2Path(const std::string& path)
+	{
+		return HasExtension(path, ".ktx2");
+	}
+
+	static bool IsSvgPath(const std::string& path)
+	{
+		return HasExtension(path, ".svg");
+	}
+
+}
+
+AsyncTexture::~AsyncTexture()
+{
+	// The last handle may go on any thread, and frames in flight may still sample the images
+	TextureResidency::Retire(std::move(m_Texture));
+	TextureResidency::Retire(std::move(m_Fallback));
+}
+
+VkDescriptorSet AsyncTexture::GetDescriptorSet() const
+{
+	if (IsReady())
+	{
+		return m_Texture->GetDescriptorSet();
+	}
+
+	if (m_Fallback)
+	{
+		return m_Fallback->GetDescriptorSet();
+	}
+
+	if (m_State.load() == State::Evicted)
+	{
+		m_RestreamRequested = true;
+	}
+
+	return TextureLoader::GetPlaceholderDescriptorSet();
+}
+
+void TextureLoader::Initialize()
+{
+	// Fully transparent so icons simply pop in once they are resident
+	const uint32_t placeholderPixel = 0x00000000;
+	g_Placeholder = new Texture(1, 1, ImageFormat::RGBA, &placeholderPixel);
+}
+
+void TextureLoader::Shutdown()
+{
+	g_UploadingTextures.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(g_DecodedMutex);
+		g_DecodedTextures.clear();
+	}
+
+	delete g_Placeholder;
+	g_Placeholder = nullptr;
+}
+
+std::shared_ptr<AsyncTexture> TextureLoader::LoadAsync(const std::string& path, bool flipVertically)
+{
+	return LoadAsync(path, flipVertically, TextureMips::None);
+}
+
+std::shared_ptr<AsyncTexture> TextureLoader::LoadAsync(const std::string& path, bool flipVertically, TextureMips mips)
+{
+	return LoadAsync(path, flipVertically, mips, 1.0f);
+}
+
+std::shared_ptr<AsyncTexture> TextureLoader::LoadAsync(const std::string& path, bool flipVertically, TextureMips mips, float vectorScale)
+{
+	TextureLoadParams params;
+	params.FlipVertically = flipVertically;
+	params.Mips = mips;
+	params.VectorScale = vectorScale;
+	return TextureRegistry::Load(path, params);
+}
+
+std::shared_ptr<AsyncTexture> TextureLoader::StartLoad(const std::string& path, bool flipVertically, TextureMips mips, float vectorScale)
+{
+	std::shared_ptr<AsyncTexture> texture = std::make_shared<AsyncTexture>();
+	texture->m_Path = path;
+	texture->m_FlipVertically = flipVertically;
+	texture->m_Mips = mips;
+	texture->m_Scale = vectorScale;
+
+	SubmitDecode(texture);
+	return texture;
+}
+
+void TextureLoader::Restream(const std::shared_ptr<AsyncTexture>& texture)
+{
+	IM_ASSERT(texture->IsEvicted());
+
+	texture->m_State = AsyncTexture::State::Decoding;
+	SubmitDecode(texture);
+}
+
+void TextureLoader::SubmitDecode(const std::shared_ptr<AsyncTexture>& texture)
+{
+	if (Utils::IsKtx2Path(texture->m_Path))
+	{
+		JobSystem::Submit([texture]()
+		{
+			texture->m_File = std::make_unique<MappedFile>();
+			texture->m_Ktx2 = std::make_unique<Ktx2View>();
+			if (!texture->m_File->Open(texture->m_Path, FileAccess::Sequential) || !Ktx2::Parse(texture->m_File->GetData(), texture->m_File->GetSize(), *texture->m_Ktx2))
+			{
+				std::cout << "Failed to load texture " << texture->m_Path << "\n";
+				texture->m_File.reset();
+				texture->m_State = AsyncTexture::State::Failed;
+				return;
+			}
+
+			texture->m_Width = (int)texture->m_Ktx2->Width;
+			texture->m_Height = (int)texture->m_Ktx2->Height;
+			texture->m_State = AsyncTexture::State::Decoded;
+
+			std::lock_guard<std::mutex> lock(g_DecodedMutex);
+			g_DecodedTextures.push_back(texture);
+		});
+
+		return;
+	}
+
+	JobSystem::Submit([texture]()
+	{
+		texture->m_Image = std::make_unique<DecodedImage>();
+		if (Utils::IsSvgPath(texture->m_Path))
+		{
+			if (!SvgRasterizer::Rasterize(texture->m_Path, texture->m_Scale, *texture->m_Image))
+			{
+				std::cout << "Failed to load texture " << texture->m_Path << "\n";
+				texture->m_Image.reset();
+				texture->m_State = AsyncTexture::State::Failed;
+				return;
+			}
+		}
+		else if (!ImageDecoder::Decode(texture->m_Path, texture->m_FlipVertically, *texture->m_Image))
+		{
+			std::cout << "Failed to load texture " << texture->m_Path << ": " << ImageDecoder::GetFailureReason() << "\n";
+			texture->m_Image.reset();
+			texture->m_State = AsyncTexture::State::Failed;
+			return;
+		}
+
+		texture->m_Width = (int)texture->m_Image->GetWidth();
+		texture->m_Height = (int)texture->m_Image->GetHeight();
+		texture->m_State = AsyncTexture::State::Decoded;
+
+		std::lock_guard<std::mutex> lock(g_DecodedMutex);
+		g_DecodedTextures.push_back(texture);
+	});
+}
+
+void TextureLoader::Update()
+{
+	// Swap in textures whose upload batch retired, never wait on the GPU here
+	for (size_t i = 0; i < g_UploadingTextures.size();)
+	{
+		std::shared_ptr<AsyncTexture>& texture = g_UploadingTextures[i];
+		if (!UploadManager::IsComplete(texture->m_UploadBatch))
+		{
+			i++;
+			continue;
+		}
+
+		texture->m_State = AsyncTexture::State::Ready;
+		// A restreamed texture's small copy may still be sampled by a frame in flight
+		TextureResidency::Retire(std::move(texture->m_Fallback));
+		TextureResidency::Track(texture);
+
+		g_UploadingTextures[i] = std::move(g_UploadingTextures.back());
+		g_UploadingTextures.pop_back();
+	}
+
+	std::vector<std::shared_ptr<AsyncTexture>> decoded;
+	{
+		std::lock_guard<std::mutex> lock(g_DecodedMutex);
+		decoded.swap(g_DecodedTextures);
+	}
+
+	// Everything decoded since last frame joins this frame's upload batch. Nothing samples these
+	// before the batch completes, so they can take the transfer queue.
+	UploadManager::BeginAsyncUploads();
+	for (std::shared_ptr<AsyncTexture>& texture : decoded)
+	{
+		if (texture->m_File)
+		{
+			// e.g. BC payloads on a device without textureCompressionBC
+			ImageFormat format = Texture::GetImageFormat(texture->m_Ktx2->Format);
+			if (format == ImageFormat::None || !Texture::IsFormatSupported(format))
+			{
+				std::cout << "Texture format of " << texture->m_Path << " is not supported on this device\n";
+				texture->m_File.reset();
+				texture->m_State = AsyncTexture::State::Failed;
+				continue;
+			}
+
+			texture->m_Texture = std::make_unique<Texture>(*texture->m_Ktx2, texture->m_File->GetData());
+			texture->m_File.reset();
+			if (!texture->m_Texture->IsLoaded())
+			{
+				texture->m_Texture.reset();
+				texture->m_State = AsyncTexture::State::Failed;
+				continue;
+			}
+
+			texture->m_UploadBatch = texture->m_Texture->GetUploadBatch();
+			texture->m_State = AsyncTexture::State::Uploading;
+			g_UploadingTextures.push_back(texture);
+			continue;
+		}
+
+		TextureSpecification specification;
+		specification.Format = texture->m_Image->GetFormat();
+		specification.Mips = texture->m_Mips;
+
+		texture->m_Texture = std::make_unique<Texture>((uint32_t)texture->m_Width.load(), (uint32_t)texture->m_Height.load(), specification, texture->m_Image->GetPixels());
+		texture->m_UploadBatch = texture->m_Texture->GetUploadBatch();
+		texture->m_Image.reset();
+
+		texture->m_State = AsyncTexture::State::Uploading;
+		g_UploadingTextures.push_back(texture);
+	}
+	UploadManager::EndAsyncUploads();
+}
+
+VkDescriptorSet TextureLoader::GetPlaceholderDescriptorSet()
+{
+	return g_Placeholder ? g_Placeholder->GetDescriptorSet() : VK_NULL_HANDLE;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+class Texture;
+class MappedFile;
+class DecodedImage;
+struct Ktx2View;
+enum class TextureMips;
+
+// Handle returned by TextureLoader::LoadAsync. Safe to draw with from the first frame:
+// until the image is resident on the GPU it hands out the loader's 1x1 placeholder.
+// TextureResidency may evict it again later, fetch the descriptor set every frame.
+class AsyncTexture
+{
+public:
+	~AsyncTexture();
+
+	bool IsReady() const { return m_State.load() == State::Ready; }
+	bool HasFailed() const { return m_State.load() == State::Failed; }
+	// Full image freed to stay inside the memory budget, drawing it streams it back in
+	bool IsEvicted() const { return m_State.load() == State::Evicted; }
+
+	VkDescriptorSet GetDescriptorSet() const;
+
+	// 0 until the image has been decoded
+	int GetWidth() const { return m_Width.load(); }
+	int GetHeight() const { return m_Height.load(); }
+
+	const std::string& GetPath() const { return m_Path; }
+
+	// nullptr until IsReady(), don't hold on to it across frames
+	Texture* GetTexture() const { return IsReady() ? m_Texture.get() : nullptr; }
+
+private:
+	friend class TextureLoader;
+	friend class TextureResidency;
+
+	enum class State
+	{
+		Decoding,
+		Decoded,
+		Uploading,
+		Ready,
+		Failed,
+		Evicted
+	};
+
+	std::string m_Path;
+	bool m_FlipVertically = true;
+	float m_Scale = 1.0f;
+	TextureMips m_Mips{}; // TextureMips::None
+
+	std::atomic<State> m_State{ State::Decoding };
+	std::atomic<int> m_Width{ 0 };
+	std::atomic<int> m_Height{ 0 };
+
+	std::unique_ptr<DecodedImage> m_Image;
+	// .ktx2 sources stay mapped until their levels are copied into staging
+	std::unique_ptr<MappedFile> m_File;
+	std::unique_ptr<Ktx2View> m_Ktx2;
+	std::unique_ptr<Texture> m_Texture;
+	uint64_t m_UploadBatch = 0;
+
+	// Small copy drawn while evicted and until the restreamed image is ready
+	std::unique_ptr<Texture> m_Fallback;
+	// Asked for while evicted without a small copy, nothing in the draw data points back at it
+	mutable std::atomic<bool> m_RestreamRequested{ false };
+};
+
+class TextureLoader
+{
+public:
+	static void Initialize();
+	static void Shutdown();
+
+	// Decodes on the job system and uploads through the UploadManager without blocking the caller.
+	// .ktx2 files are mapped and validated on the job system instead, their stored mips and layers
+	// are used as is and flipVertically/mips are ignored.
+	// .svg files go through SvgRasterizer at vectorScale (1 = document size at 96 DPI), flipVertically is ignored.
+	// Goes through TextureRegistry::Load, a path that is already loaded (or loading) with the same
+	// parameters hands out the existing texture. Handles may be dropped on any thread, the GPU image is
+	// destroyed once no frame in flight samples it anymore (see TextureResidency::Retire).
+	static std::shared_ptr<AsyncTexture> LoadAsync(const std::string& path, bool flipVertically = true);
+	static std::shared_ptr<AsyncTexture> LoadAsync(const std::string& path, bool flipVertically, TextureMips mips);
+	static std::shared_ptr<AsyncTexture> LoadAsync(const std::string& path, bool flipVertically, TextureMips mips, float vectorScale);
+
+	// Decodes and uploads an evicted texture again, see TextureResidency
+	static void Restream(const std::shared_ptr<AsyncTexture>& texture);
+
+	// Call once per frame on the render thread, before ImGui::NewFrame
+	static void Update();
+
+	static VkDescriptorSet GetPlaceholderDescriptorSet();
+
+private:
+	friend class TextureRegistry;
+
+	// Always starts a new load, for the registry
+	static std::shared_ptr<AsyncTexture> StartLoad(const std::string& path, bool flipVertically, TextureMips mips, float vectorScale);
+	static void SubmitDecode(const std::shared_ptr<AsyncTexture>& texture);
+};
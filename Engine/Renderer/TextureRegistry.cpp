@@ -0,0 +1,183 @@
+#include "TextureRegistry.h"
+#include "TiledImage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+struct TextureKey
+{
+	std::string Path;
+	bool FlipVertically = true;
+	TextureMips Mips = TextureMips::None;
+	float VectorScale = 1.0f;
+
+	bool operator==(const TextureKey& other) const
+	{
+		return Path == other.Path && FlipVertically == other.FlipVertically && Mips == other.Mips && VectorScale == other.VectorScale;
+	}
+};
+
+struct TextureKeyHash
+{
+	size_t operator()(const TextureKey& key) const
+	{
+		size_t hash = std::hash<std::string>()(key.Path);
+		hash ^= ((size_t)key.FlipVertically | ((size_t)key.Mips << 1)) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+		hash ^= std::hash<float>()(key.VectorScale) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+};
+
+static std::shared_mutex                                                              g_RegistryMutex;
+static std::unordered_map<TextureKey, std::weak_ptr<AsyncTexture>, TextureKeyHash>  g_Textures;
+static uint32_t                                                                       g_InsertsSinceSweep = 0;
+// Render thread only, keyed by normalized path and cache size
+static std::unordered_map<std::string, std::weak_ptr<TiledImage>>                    g_TiledImages;
+
+static std::atomic<uint64_t> g_Hits{ 0 };
+static std::atomic<uint64_t> g_Misses{ 0 };
+
+namespace Utils {
+
+	static TextureKey MakeKey(const std::string& path, const TextureLoadParams& params)
+	{
+		TextureKey key;
+		key.Path = TextureRegistry::NormalizePath(path);
+		key.FlipVertically = params.FlipVertically;
+		key.Mips = params.Mips;
+		key.VectorScale = params.VectorScale;
+		return key;
+	}
+
+	static TextureHandle FindLocked(const TextureKey& key)
+	{
+		auto it = g_Textures.find(key);
+		return it != g_Textures.end() ? it->second.lock() : nullptr;
+	}
+
+	// Drops entries whose textures died, caller holds the exclusive lock
+	template<typename Map>
+	static void SweepExpired(Map& entries)
+	{
+		for (auto it = entries.begin(); it != entries.end();)
+		{
+			if (it->second.expired())
+				it = entries.erase(it);
+			else
+				++it;
+		}
+	}
+
+}
+
+TextureHandle TextureRegistry::Load(const std::string& path, const TextureLoadParams& params)
+{
+	TextureKey key = Utils::MakeKey(path, params);
+
+	{
+		std::shared_lock<std::shared_mutex> lock(g_RegistryMutex);
+		if (TextureHandle texture = Utils::FindLocked(key))
+		{
+			g_Hits++;
+			return texture;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> lock(g_RegistryMutex);
+
+	// Another thread may have started the same load between the two locks
+	if (TextureHandle texture = Utils::FindLocked(key))
+	{
+		g_Hits++;
+		return texture;
+	}
+
+	TextureHandle texture = TextureLoader::StartLoad(path, params.FlipVertically, params.Mips, params.VectorScale);
+	g_Textures[key] = texture;
+	g_Misses++;
+
+	if (++g_InsertsSinceSweep >= 64)
+	{
+		Utils::SweepExpired(g_Textures);
+		g_InsertsSinceSweep = 0;
+	}
+
+	return texture;
+}
+
+std::shared_ptr<TiledImage> TextureRegistry::LoadTiled(const std::string& path, uint32_t slotsPerSide)
+{
+	std::string key = NormalizePath(path) + "|" + std::to_string(slotsPerSide);
+	if (std::shared_ptr<TiledImage> image = g_TiledImages[key].lock())
+	{
+		g_Hits++;
+		return image;
+	}
+
+	// Few are ever open, sweeping on every miss is cheap
+	Utils::SweepExpired(g_TiledImages);
+
+	std::shared_ptr<TiledImage> image = std::make_shared<TiledImage>(path, slotsPerSide);
+	g_TiledImages[key] = image;
+	g_Misses++;
+	return image;
+}
+
+TextureHandle TextureRegistry::Find(const std::string& path, const TextureLoadParams& params)
+{
+	TextureKey key = Utils::MakeKey(path, params);
+
+	std::shared_lock<std::shared_mutex> lock(g_RegistryMutex);
+	return Utils::FindLocked(key);
+}
+
+std::string TextureRegistry::NormalizePath(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::path absolute = std::filesystem::absolute(path, error);
+	std::string normalized = (error ? std::filesystem::path(path) : absolute).lexically_normal().generic_string();
+
+#ifdef _WIN32
+	// NTFS is case insensitive, "Icons/UE4.png" and "icons/ue4.png" are the same file
+	std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+#endif
+
+	return normalized;
+}
+
+void TextureRegistry::Clear()
+{
+	std::unique_lock<std::shared_mutex> lock(g_RegistryMutex);
+	g_Textures.clear();
+	g_InsertsSinceSweep = 0;
+	g_TiledImages.clear();
+}
+
+uint32_t TextureRegistry::GetLiveCount()
+{
+	std::shared_lock<std::shared_mutex> lock(g_RegistryMutex);
+
+	uint32_t count = 0;
+	for (const auto& entry : g_Textures)
+	{
+		if (!entry.second.expired())
+			count++;
+	}
+	return count;
+}
+
+uint64_t TextureRegistry::GetHitCount()
+{
+	return g_Hits.load();
+}
+
+uint64_t TextureRegistry::GetMissCount()
+{
+	return g_Misses.load();
+}
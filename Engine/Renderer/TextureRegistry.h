@@ -0,0 +1,48 @@
+#pragma once
+#include "TextureLoader.h"
+#include "Texture.h"
+#include <memory>
+#include <string>
+
+class TiledImage;
+
+// Copies share one texture, the GPU image goes away with the last handle. Handles may be dropped
+// on any thread, the image is retired through TextureResidency like evicted ones.
+using TextureHandle = std::shared_ptr<AsyncTexture>;
+
+struct TextureLoadParams
+{
+	bool FlipVertically = true;
+	TextureMips Mips = TextureMips::None;
+	// .svg sources only, e.g. the monitor's content scale
+	float VectorScale = 1.0f;
+};
+
+// Path keyed cache in front of TextureLoader. Every path + load parameter combination is decoded
+// and uploaded once for as long as someone holds a handle to it; asking again costs a hash lookup.
+// Only weak references are kept. TextureLoader::LoadAsync goes through Load.
+// Load and Find are safe from any thread.
+class TextureRegistry
+{
+public:
+	static TextureHandle Load(const std::string& path, const TextureLoadParams& params = TextureLoadParams());
+
+	// Already loaded (or loading) texture, nullptr otherwise. Never starts a load.
+	static TextureHandle Find(const std::string& path, const TextureLoadParams& params = TextureLoadParams());
+
+	// Same for tiled images, opening a path that is already open shares its pyramid and tile cache.
+	// Render thread only, TiledImage is.
+	static std::shared_ptr<TiledImage> LoadTiled(const std::string& path, uint32_t slotsPerSide = 16);
+
+	// Absolute, lexically normalized, '/' separated and lower case on Windows
+	static std::string NormalizePath(const std::string& path);
+
+	// Forgets every entry. Outstanding handles stay valid but are no longer shared with new loads.
+	static void Clear();
+
+	// Entries whose texture is still alive
+	static uint32_t GetLiveCount();
+
+	static uint64_t GetHitCount();
+	static uint64_t GetMissCount();
+};
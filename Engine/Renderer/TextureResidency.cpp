@@ -0,0 +1,329 @@
+#include "TextureResidency.h"
+#include "TextureLoader.h"
+#include "Texture.h"
+#include "DeviceMemoryAllocator.h"
+#include "OneShotSubmitter.h"
+
+#include "../AstranEditorUI.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct ResidentTexture
+{
+	std::weak_ptr<AsyncTexture> Handle;
+	uint64_t LastUsedFrame = 0;
+};
+
+struct RetiredTexture
+{
+	std::unique_ptr<Texture> Image;
+	uint64_t Frame = 0;
+	// OneShotSubmitter token of copies still reading the image
+	uint64_t Token = 0;
+};
+
+static std::unordered_map<AsyncTexture*, ResidentTexture> g_Textures;
+// Retire is called from any thread, e.g. by the last AsyncTexture handle going away on a job
+static std::mutex                                         g_RetiredMutex;
+static std::vector<RetiredTexture>                        g_Retired;
+static bool                                               g_Initialized = false;
+
+static PFN_vkGetPhysicalDeviceMemoryProperties2KHR        g_GetMemoryProperties2 = nullptr;
+
+static std::atomic<uint64_t>                              g_Frame{ 0 };
+// Freed memory only shows up in the numbers once the retired textures are destroyed
+static uint64_t                                           g_NextEvaluationFrame = 0;
+static float                                              g_BudgetFraction = 0.8f;
+static uint32_t                                           g_EvictedSize = 64;
+static bool                                               g_LogEvictions = false;
+
+static ResidencyStats                                     g_Stats;
+
+namespace Utils {
+
+	// A frame recorded now has retired once this many more frames were submitted
+	static uint64_t GetRetireDelay()
+	{
+		return (uint64_t)std::max(AstranEditorUI::GetFramesInFlight(), 1u) + 1;
+	}
+
+	// Usage and budget over the device local heaps. Bytes our allocator holds in its blocks but has
+	// not handed out count as free, they are ours to reuse.
+	static void QueryBudget(uint64_t& usage, uint64_t& budget, bool& fromMemoryBudget)
+	{
+		VkPhysicalDevice physicalDevice = AstranEditorUI::GetPhysicalDevice();
+
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+
+		fromMemoryBudget = g_GetMemoryProperties2 != nullptr;
+		if (fromMemoryBudget)
+		{
+			properties2.pNext = &budgetProperties;
+			g_GetMemoryProperties2(physicalDevice, &properties2);
+		}
+		else
+		{
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties2.memoryProperties);
+		}
+		const VkPhysicalDeviceMemoryProperties& properties = properties2.memoryProperties;
+
+		usage = 0;
+		budget = 0;
+		uint64_t allocated = 0;
+		uint64_t unused = 0;
+		for (uint32_t heap = 0; heap < properties.memoryHeapCount; heap++)
+		{
+			if (!(properties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+				continue;
+
+			if (fromMemoryBudget)
+			{
+				usage += budgetProperties.heapUsage[heap];
+				budget += budgetProperties.heapBudget[heap];
+			}
+			else
+			{
+				// The whole heap, the budget fraction leaves room for other processes and the driver
+				budget += properties.memoryHeaps[heap].size;
+			}
+
+			for (uint32_t type = 0; type < properties.memoryTypeCount; type++)
+			{
+				if (properties.memoryTypes[type].heapIndex != heap)
+					continue;
+				DeviceMemoryStats stats = DeviceMemoryAllocator::GetStats(type);
+				allocated += stats.UsedBytes;
+				unused += stats.BlockBytes - stats.UsedBytes;
+			}
+		}
+
+		usage = fromMemoryBudget ? usage - std::min(usage, unused) : allocated;
+	}
+
+}
+
+void TextureResidency::Initialize()
+{
+	g_GetMemoryProperties2 = nullptr;
+	if (AstranEditorUI::HasMemoryBudget())
+	{
+		g_GetMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(AstranEditorUI::GetInstance(), "vkGetPhysicalDeviceMemoryProperties2KHR");
+	}
+
+	g_Frame = 0;
+	g_NextEvaluationFrame = 0;
+	g_Stats = ResidencyStats();
+
+	std::lock_guard<std::mutex> lock(g_RetiredMutex);
+	g_Initialized = true;
+}
+
+void TextureResidency::Shutdown()
+{
+	std::vector<RetiredTexture> retired;
+	{
+		std::lock_guard<std::mutex> lock(g_RetiredMutex);
+		g_Initialized = false;
+		retired.swap(g_Retired);
+	}
+	retired.clear();
+	g_Textures.clear();
+}
+
+void TextureResidency::Track(const std::shared_ptr<AsyncTexture>& texture)
+{
+	// Counts as used now so a texture isn't evicted before anyone had the chance to draw it
+	ResidentTexture& entry = g_Textures[texture.get()];
+	entry.Handle = texture;
+	entry.LastUsedFrame = g_Frame;
+}
+
+void TextureResidency::Update()
+{
+	g_Frame++;
+	uint64_t retireDelay = Utils::GetRetireDelay();
+
+	{
+		// Destroyed outside the lock, a Texture may wait on its upload batch
+		std::vector<RetiredTexture> destroyed;
+		{
+			std::lock_guard<std::mutex> lock(g_RetiredMutex);
+			for (size_t i = 0; i < g_Retired.size();)
+			{
+				if (g_Frame - g_Retired[i].Frame < retireDelay || !OneShotSubmitter::IsComplete(g_Retired[i].Token))
+				{
+					i++;
+					continue;
+				}
+				destroyed.push_back(std::move(g_Retired[i]));
+				g_Retired[i] = std::move(g_Retired.back());
+				g_Retired.pop_back();
+			}
+		}
+	}
+
+	// What each tracked texture is currently drawn with. Evicted ones are drawn with their small copy
+	// (or the shared placeholder, see AsyncTexture::GetDescriptorSet).
+	std::unordered_map<VkDescriptorSet, ResidentTexture*> descriptors;
+	std::vector<std::shared_ptr<AsyncTexture>> textures;
+	textures.reserve(g_Textures.size());
+	for (auto it = g_Textures.begin(); it != g_Textures.end();)
+	{
+		std::shared_ptr<AsyncTexture> texture = it->second.Handle.lock();
+		if (!texture)
+		{
+			it = g_Textures.erase(it);
+			continue;
+		}
+
+		if (texture->IsReady())
+			descriptors[texture->m_Texture->GetDescriptorSet()] = &it->second;
+		else if (texture->m_Fallback)
+			descriptors[texture->m_Fallback->GetDescriptorSet()] = &it->second;
+		textures.push_back(std::move(texture));
+		++it;
+	}
+
+	// Every viewport's draw lists, so textures in torn off windows count as well
+	ImGuiPlatformIO& platform_io = ImGui::GetPlatformIO();
+	for (ImGuiViewport* viewport : platform_io.Viewports)
+	{
+		ImDrawData* drawData = viewport->DrawData;
+		if (!drawData)
+			continue;
+
+		for (int list = 0; list < drawData->CmdListsCount; list++)
+		{
+			for (const ImDrawCmd& command : drawData->CmdLists[list]->CmdBuffer)
+			{
+				auto found = descriptors.find((VkDescriptorSet)command.TextureId);
+				if (found != descriptors.end())
+					found->second->LastUsedFrame = g_Frame;
+			}
+		}
+	}
+
+	g_Stats.Tracked = (uint32_t)textures.size();
+	g_Stats.Evicted = 0;
+	for (std::shared_ptr<AsyncTexture>& texture : textures)
+	{
+		if (texture->m_State.load() != AsyncTexture::State::Evicted)
+			continue;
+
+		ResidentTexture& entry = g_Textures[texture.get()];
+		if (entry.LastUsedFrame == g_Frame || texture->m_RestreamRequested.exchange(false))
+		{
+			TextureLoader::Restream(texture);
+			g_Stats.TotalRestreams++;
+			continue;
+		}
+		g_Stats.Evicted++;
+	}
+
+	if (g_Frame < g_NextEvaluationFrame)
+		return;
+
+	Utils::QueryBudget(g_Stats.Usage, g_Stats.Budget, g_Stats.FromMemoryBudget);
+	uint64_t target = (uint64_t)((double)g_Stats.Budget * g_BudgetFraction);
+	if (g_Stats.Usage <= target)
+		return;
+
+	// Least recently drawn first, never anything a frame in flight may still sample
+	std::vector<std::pair<uint64_t, AsyncTexture*>> candidates;
+	for (std::shared_ptr<AsyncTexture>& texture : textures)
+	{
+		uint64_t lastUsed = g_Textures[texture.get()].LastUsedFrame;
+		if (texture->IsReady() && lastUsed + retireDelay < g_Frame)
+			candidates.push_back({ lastUsed, texture.get() });
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	uint64_t excess = g_Stats.Usage - target;
+	uint64_t freed = 0;
+	std::vector<AsyncTexture*> evicted;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	for (const auto& candidate : candidates)
+	{
+		if (freed >= excess)
+			break;
+
+		AsyncTexture* texture = candidate.second;
+		if (!commandBuffer)
+			commandBuffer = OneShotSubmitter::Begin();
+
+		texture->m_Fallback = texture->m_Texture->CreateReducedCopy(g_EvictedSize, commandBuffer);
+		uint64_t kept = texture->m_Fallback ? texture->m_Fallback->GetResidentBytes() : 0;
+		freed += texture->m_Texture->GetResidentBytes() - std::min(texture->m_Texture->GetResidentBytes(), kept);
+		evicted.push_back(texture);
+	}
+
+	// The copies go out with this frame's one-shot batch, ahead of the frame that draws the fallbacks.
+	// They read the full images, which are only destroyed once the batch completed.
+	uint64_t copies = commandBuffer ? OneShotSubmitter::End(commandBuffer) : 0;
+
+	for (AsyncTexture* texture : evicted)
+	{
+		texture->m_State = AsyncTexture::State::Evicted;
+		Retire(std::move(texture->m_Texture), copies);
+	}
+
+	g_Stats.Evicted += (uint32_t)evicted.size();
+	g_Stats.TotalEvictions += evicted.size();
+	g_NextEvaluationFrame = g_Frame + retireDelay + 1;
+
+	if (g_LogEvictions && !evicted.empty())
+	{
+		std::cout << "[residency] " << (g_Stats.Usage >> 20) << " of " << (g_Stats.Budget >> 20) << " MiB in use, evicted "
+			<< evicted.size() << " textures (" << (freed >> 20) << " MiB)\n";
+	}
+}
+
+void TextureResidency::Retire(std::unique_ptr<Texture> texture, uint64_t token)
+{
+	if (!texture)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(g_RetiredMutex);
+		if (g_Initialized)
+		{
+			RetiredTexture retired;
+			retired.Image = std::move(texture);
+			retired.Frame = g_Frame;
+			retired.Token = token;
+			g_Retired.push_back(std::move(retired));
+			return;
+		}
+	}
+
+	// Shut down, the device is idle and nothing samples it anymore
+	texture.reset();
+}
+
+void TextureResidency::SetBudgetFraction(float fraction)
+{
+	g_BudgetFraction = std::min(std::max(fraction, 0.05f), 1.0f);
+}
+
+void TextureResidency::SetLogEvictions(bool log)
+{
+	g_LogEvictions = log;
+}
+
+void TextureResidency::SetEvictedSize(uint32_t maxSize)
+{
+	g_EvictedSize = std::max(maxSize, 1u);
+}
+
+ResidencyStats TextureResidency::GetStats()
+{
+	return g_Stats;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+
+class AsyncTexture;
+class Texture;
+
+struct ResidencyStats
+{
+	// Device local bytes across all device local heaps
+	uint64_t Budget = 0;
+	uint64_t Usage = 0;
+	// VK_EXT_memory_budget numbers, the heap sizes otherwise
+	bool FromMemoryBudget = false;
+
+	uint32_t Tracked = 0;
+	uint32_t Evicted = 0;
+	uint64_t TotalEvictions = 0;
+	uint64_t TotalRestreams = 0;
+};
+
+// Keeps loaded textures inside the device local memory budget. Every frame it records which
+// textures ImGui actually drew, and when usage goes over the budget the least recently drawn ones
+// are swapped for a small copy of themselves (or the placeholder) and their full image is freed.
+// Drawing an evicted texture streams it back in through the TextureLoader.
+// Render thread only, except Retire.
+class TextureResidency
+{
+public:
+	static void Initialize();
+	// Destroys retired textures, call once the device is idle and before TextureLoader::Shutdown
+	static void Shutdown();
+
+	// Called by the TextureLoader whenever a texture becomes ready
+	static void Track(const std::shared_ptr<AsyncTexture>& texture);
+
+	// Call once per frame after ImGui::Render, before the frame's command buffer is recorded
+	static void Update();
+
+	// Destroys texture once no frame in flight can sample it anymore and the OneShotSubmitter
+	// batch of token (copies reading it) completed. Safe from any thread, the texture is always
+	// destroyed on the render thread. After Shutdown it is destroyed right away.
+	static void Retire(std::unique_ptr<Texture> texture, uint64_t token = 0);
+
+	// Share of the reported budget textures may grow into before eviction starts, 0.8 by default
+	static void SetBudgetFraction(float fraction);
+	// Longest side of the copy an evicted texture keeps, 64 by default
+	static void SetEvictedSize(uint32_t maxSize);
+	// Prints a line for every round of evictions, off by default, see GetStats
+	static void SetLogEvictions(bool log);
+
+	static ResidencyStats GetStats();
+};
@@ -0,0 +1,482 @@
+#include "ThumbnailService.h"
+#include "Texture.h"
+#include "TextureLoader.h"
+#include "ImageCache.h"
+#include "ImageDecoder.h"
+#include "MipGenerator.h"
+
+#include "../AstranEditorUI.h"
+#include "../Core/JobSystem.h"
+#include "../Core/MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Bump when the generated thumbnails change so old cache entries are ignored
+static const uint32_t g_ThumbnailVersion = 1;
+static const uint32_t g_MaxUploadsPerFrame = 32;
+// Queued thumbnails not asked for again within this many frames were scrolled past
+static const uint64_t g_RequestLifetime = 2;
+
+struct GeneratedThumbnail
+{
+	std::string Path;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	// (Width + 2) x (Height + 2), the edge repeated once all round
+	std::vector<uint8_t> Pixels;
+	bool Failed = false;
+	bool CacheHit = false;
+};
+
+// Shared with the jobs so they can finish safely after Shutdown
+struct ThumbnailQueue
+{
+	std::atomic<bool> Cancelled{ false };
+	std::atomic<uint32_t> InFlight{ 0 };
+
+	std::mutex Mutex;
+	std::vector<GeneratedThumbnail> Completed;
+};
+
+enum class ThumbnailState
+{
+	Queued,
+	InFlight,
+	Resident,
+	Failed
+};
+
+struct ThumbnailEntry
+{
+	ThumbnailState State = ThumbnailState::Queued;
+	uint32_t Slot = ~0u;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint64_t LastRequestFrame = 0;
+};
+
+struct ThumbnailSlot
+{
+	// Empty when free
+	std::string Path;
+	uint64_t LastUsedFrame = 0;
+};
+
+static uint32_t                                         g_ThumbnailSize = 128;
+static uint32_t                                         g_SlotsPerSide = 16;
+static std::unique_ptr<Texture>                         g_Atlas;
+static std::vector<ThumbnailSlot>                       g_Slots;
+
+static std::unordered_map<std::string, ThumbnailEntry> g_Entries;
+static std::vector<std::string>                         g_Requests;
+static std::shared_ptr<ThumbnailQueue>                  g_Queue;
+
+static uint64_t                                         g_Frame = 0;
+static ThumbnailStats                                   g_Stats;
+
+namespace Utils {
+
+	static uint32_t GetSlotStride()
+	{
+		return g_ThumbnailSize + 2;
+	}
+
+	// Bytes hashed at each end of the file, headers and trailers (PNG IEND, JPEG EOI) change with any edit
+	static const uint64_t g_KeySampleSize = 64 * 1024;
+
+	// Path, size and time plus a hash of the first and last g_KeySampleSize bytes. Hashing whole files
+	// would cost more than decoding the ones on screen, the samples catch edits that keep size and time
+	// (copies with preserved timestamps, coarse file system clocks).
+	static bool GetThumbnailKey(const std::string& path, uint32_t thumbnailSize, uint64_t& outKey)
+	{
+		std::error_code error;
+		uint64_t size = std::filesystem::file_size(path, error);
+		if (error)
+			return false;
+		uint64_t time = (uint64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+		if (error)
+			return false;
+
+		std::string absolutePath = std::filesystem::absolute(path, error).string();
+		outKey = ImageCache::Hash(absolutePath.data(), absolutePath.size(), 0x424D4854); // "THMB"
+		outKey = ImageCache::HashCombine(outKey, size);
+		outKey = ImageCache::HashCombine(outKey, time);
+		outKey = ImageCache::HashCombine(outKey, ((uint64_t)g_ThumbnailVersion << 32) | thumbnailSize);
+
+		MappedFile file;
+		if (!file.Open(path, FileAccess::Random))
+			return false;
+		uint64_t head = std::min(file.GetSize(), g_KeySampleSize);
+		uint64_t tailOffset = std::max(file.GetSize() - std::min(file.GetSize(), g_KeySampleSize), head);
+		outKey = ImageCache::Hash(file.GetData(), (size_t)head, outKey);
+		outKey = ImageCache::Hash(file.GetData() + tailOffset, (size_t)(file.GetSize() - tailOffset), outKey);
+		return true;
+	}
+
+	// Area weighted resize of one axis, count lines of stride apart. Only ever shrinks by less than 2x
+	// here, the halving before it does the heavy lifting.
+	static void ResampleAxis(const float* source, uint32_t sourceLength, float* destination, uint32_t length,
+		uint32_t lines, size_t sourceStep, size_t step, size_t sourceLineStride, size_t lineStride)
+	{
+		float scale = (float)sourceLength / (float)length;
+		for (uint32_t line = 0; line < lines; line++)
+		{
+			const float* sourceLine = source + line * sourceLineStride;
+			float* destinationLine = destination + line * lineStride;
+			for (uint32_t i = 0; i < length; i++)
+			{
+				float begin = i * scale;
+				float end = begin + scale;
+				float sum[4] = {};
+				for (uint32_t j = (uint32_t)begin; j < sourceLength && (float)j < end; j++)
+				{
+					float weight = std::min(end, (float)(j + 1)) - std::max(begin, (float)j);
+					const float* texel = sourceLine + j * sourceStep;
+					for (int c = 0; c < 4; c++)
+						sum[c] += texel[c] * weight;
+				}
+				float* texel = destinationLine + i * step;
+				for (int c = 0; c < 4; c++)
+					texel[c] = sum[c] / scale;
+			}
+		}
+	}
+
+	static void ResampleRGBA8(const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint8_t* destination, uint32_t width, uint32_t height)
+	{
+		std::vector<float> input((size_t)sourceWidth * sourceHeight * 4);
+		for (size_t i = 0; i < input.size(); i++)
+			input[i] = source[i];
+
+		// Rows first, then columns of the narrowed image
+		std::vector<float> rows((size_t)width * sourceHeight * 4);
+		ResampleAxis(input.data(), sourceWidth, rows.data(), width, sourceHeight, 4, 4, (size_t)sourceWidth * 4, (size_t)width * 4);
+		std::vector<float> output((size_t)width * height * 4);
+		ResampleAxis(rows.data(), sourceHeight, output.data(), height, width, (size_t)width * 4, (size_t)width * 4, 4, 4);
+
+		for (size_t i = 0; i < output.size(); i++)
+			destination[i] = (uint8_t)std::min(std::max(output[i] + 0.5f, 0.0f), 255.0f);
+	}
+
+	static void AddBorder(const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& outPixels)
+	{
+		uint32_t paddedWidth = width + 2;
+		outPixels.resize((size_t)paddedWidth * (height + 2) * 4);
+		for (uint32_t y = 0; y < height + 2; y++)
+		{
+			uint32_t sourceY = std::min(std::max(y, 1u) - 1, height - 1);
+			const uint8_t* sourceRow = pixels + (size_t)sourceY * width * 4;
+			uint8_t* row = outPixels.data() + (size_t)y * paddedWidth * 4;
+			memcpy(row, sourceRow, 4);
+			memcpy(row + 4, sourceRow, (size_t)width * 4);
+			memcpy(row + (size_t)(width + 1) * 4, sourceRow + (size_t)(width - 1) * 4, 4);
+		}
+	}
+
+	static bool GenerateThumbnail(const std::string& path, uint32_t thumbnailSize, DecodedImage& outImage)
+	{
+		DecodedImage image;
+		if (!ImageDecoder::DecodeRGBA(path, false, image, false))
+			return false;
+
+		uint32_t width = image.GetWidth();
+		uint32_t height = image.GetHeight();
+		uint32_t longest = std::max(width, height);
+		uint32_t targetWidth = width;
+		uint32_t targetHeight = height;
+		if (longest > thumbnailSize)
+		{
+			targetWidth = std::max(1u, (uint32_t)std::lround((double)width * thumbnailSize / longest));
+			targetHeight = std::max(1u, (uint32_t)std::lround((double)height * thumbnailSize / longest));
+		}
+
+		// SIMD 2x2 halving while at least twice the target, it touches every source texel
+		while (width >= targetWidth * 2 && height >= targetHeight * 2)
+		{
+			DecodedImage half;
+			half.Allocate(MipGenerator::GetMipDimension(width, 1), MipGenerator::GetMipDimension(height, 1));
+			MipGenerator::DownsampleRGBA8(image.GetPixels(), width, height, half.GetPixels());
+			image = std::move(half);
+			width = image.GetWidth();
+			height = image.GetHeight();
+		}
+
+		if (width == targetWidth && height == targetHeight)
+		{
+			outImage = std::move(image);
+			return true;
+		}
+
+		outImage.Allocate(targetWidth, targetHeight);
+		ResampleRGBA8(image.GetPixels(), width, height, outImage.GetPixels(), targetWidth, targetHeight);
+		return true;
+	}
+
+	static void RunThumbnailJob(const std::shared_ptr<ThumbnailQueue>& queue, const std::string& path, uint32_t thumbnailSize)
+	{
+		GeneratedThumbnail result;
+		result.Path = path;
+
+		if (!queue->Cancelled.load())
+		{
+			uint64_t key = 0;
+			DecodedImage thumbnail;
+			if (!GetThumbnailKey(path, thumbnailSize, key))
+			{
+				result.Failed = true;
+			}
+			else if (ImageCache::Load(key, thumbnail))
+			{
+				result.CacheHit = true;
+			}
+			else if (GenerateThumbnail(path, thumbnailSize, thumbnail))
+			{
+				ImageCache::Store(key, thumbnail);
+			}
+			else
+			{
+				std::cout << "[thumbnail] could not load " << path << ": " << ImageDecoder::GetFailureReason() << "\n";
+				result.Failed = true;
+			}
+
+			if (!result.Failed)
+			{
+				result.Width = thumbnail.GetWidth();
+				result.Height = thumbnail.GetHeight();
+				AddBorder(thumbnail.GetPixels(), result.Width, result.Height, result.Pixels);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(queue->Mutex);
+		queue->Completed.push_back(std::move(result));
+		queue->InFlight--;
+	}
+
+	// Least recently drawn slot no frame in flight can still be sampling, ~0u when every slot is in use
+	static uint32_t AcquireSlot()
+	{
+		uint64_t retireDelay = (uint64_t)std::max(AstranEditorUI::GetFramesInFlight(), 1u) + 1;
+
+		uint32_t best = ~0u;
+		for (uint32_t slot = 0; slot < (uint32_t)g_Slots.size(); slot++)
+		{
+			const ThumbnailSlot& candidate = g_Slots[slot];
+			if (candidate.Path.empty())
+				return slot;
+			if (candidate.LastUsedFrame + retireDelay >= g_Frame)
+				continue;
+			if (best == ~0u || candidate.LastUsedFrame < g_Slots[best].LastUsedFrame)
+				best = slot;
+		}
+
+		if (best != ~0u)
+		{
+			g_Entries.erase(g_Slots[best].Path);
+			g_Slots[best].Path.clear();
+		}
+		return best;
+	}
+
+}
+
+void ThumbnailService::Initialize(uint32_t thumbnailSize, uint32_t slotsPerSide)
+{
+	g_ThumbnailSize = std::max(thumbnailSize, 8u);
+	g_SlotsPerSide = std::max(slotsPerSide, 2u);
+	g_Slots.assign((size_t)g_SlotsPerSide * g_SlotsPerSide, ThumbnailSlot());
+	g_Entries.clear();
+	g_Requests.clear();
+	g_Queue = std::make_shared<ThumbnailQueue>();
+	g_Frame = 0;
+	g_Stats = ThumbnailStats();
+	g_Stats.Slots = (uint32_t)g_Slots.size();
+
+	// Slots are filled by region copies, the first one starts the image out from UNDEFINED
+	TextureSpecification specification;
+	specification.Format = ImageFormat::RGBA;
+	specification.Usage = TextureUsage::Static;
+	specification.Sampler.AddressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	specification.Sampler.AddressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	uint32_t size = g_SlotsPerSide * Utils::GetSlotStride();
+	g_Atlas = std::make_unique<Texture>(size, size, specification);
+}
+
+void ThumbnailService::Shutdown()
+{
+	if (g_Queue)
+		g_Queue->Cancelled = true;
+	g_Queue.reset();
+
+	g_Atlas.reset();
+	g_Slots.clear();
+	g_Entries.clear();
+	g_Requests.clear();
+}
+
+void ThumbnailService::Update()
+{
+	g_Frame++;
+
+	std::vector<GeneratedThumbnail> completed;
+	{
+		std::lock_guard<std::mutex> lock(g_Queue->Mutex);
+		completed.swap(g_Queue->Completed);
+	}
+
+	uint32_t uploads = 0;
+	for (size_t i = 0; i < completed.size(); i++)
+	{
+		GeneratedThumbnail& result = completed[i];
+		auto found = g_Entries.find(result.Path);
+		if (found == g_Entries.end())
+			continue;
+
+		ThumbnailEntry& entry = found->second;
+		if (result.Failed)
+		{
+			// Kept so the file isn't retried every frame
+			entry.State = ThumbnailState::Failed;
+			continue;
+		}
+
+		uint32_t slot = uploads < g_MaxUploadsPerFrame ? Utils::AcquireSlot() : ~0u;
+		if (slot == ~0u)
+		{
+			std::lock_guard<std::mutex> lock(g_Queue->Mutex);
+			g_Queue->Completed.insert(g_Queue->Completed.begin(), std::make_move_iterator(completed.begin() + i), std::make_move_iterator(completed.end()));
+			break;
+		}
+
+		uint32_t stride = Utils::GetSlotStride();
+		TextureRegion region;
+		region.X = (slot % g_SlotsPerSide) * stride;
+		region.Y = (slot / g_SlotsPerSide) * stride;
+		region.Width = result.Width + 2;
+		region.Height = result.Height + 2;
+		g_Atlas->SetData(region, result.Pixels.data());
+
+		g_Slots[slot].Path = result.Path;
+		g_Slots[slot].LastUsedFrame = g_Frame;
+		entry.State = ThumbnailState::Resident;
+		entry.Slot = slot;
+		entry.Width = result.Width;
+		entry.Height = result.Height;
+
+		uploads++;
+		g_Stats.Generated += result.CacheHit ? 0 : 1;
+		g_Stats.CacheHits += result.CacheHit ? 1 : 0;
+	}
+
+	// Drop what was scrolled past before it reached a worker, start the rest in request order
+	uint32_t maxInFlight = std::max(JobSystem::GetWorkerCount() * 2, 2u);
+	size_t kept = 0;
+	for (size_t i = 0; i < g_Requests.size(); i++)
+	{
+		auto found = g_Entries.find(g_Requests[i]);
+		if (found == g_Entries.end() || found->second.State != ThumbnailState::Queued)
+			continue;
+
+		ThumbnailEntry& entry = found->second;
+		if (entry.LastRequestFrame + g_RequestLifetime < g_Frame)
+		{
+			g_Entries.erase(found);
+			continue;
+		}
+
+		if (g_Queue->InFlight.load() < maxInFlight)
+		{
+			entry.State = ThumbnailState::InFlight;
+			g_Queue->InFlight++;
+
+			std::shared_ptr<ThumbnailQueue> queue = g_Queue;
+			std::string path = g_Requests[i];
+			uint32_t thumbnailSize = g_ThumbnailSize;
+			JobSystem::Submit([queue, path, thumbnailSize]()
+			{
+				Utils::RunThumbnailJob(queue, path, thumbnailSize);
+			});
+			continue;
+		}
+
+		g_Requests[kept++] = std::move(g_Requests[i]);
+	}
+	g_Requests.resize(kept);
+
+	g_Stats.Resident = 0;
+	for (const ThumbnailSlot& slot : g_Slots)
+		g_Stats.Resident += slot.Path.empty() ? 0 : 1;
+	g_Stats.Queued = (uint32_t)g_Requests.size();
+	g_Stats.InFlight = g_Queue->InFlight.load();
+}
+
+Thumbnail ThumbnailService::Get(const std::string& path)
+{
+	Thumbnail thumbnail;
+	thumbnail.Texture = (ImTextureID)TextureLoader::GetPlaceholderDescriptorSet();
+
+	auto inserted = g_Entries.emplace(path, ThumbnailEntry());
+	ThumbnailEntry& entry = inserted.first->second;
+	entry.LastRequestFrame = g_Frame;
+	if (inserted.second)
+		g_Requests.push_back(path);
+
+	if (entry.State == ThumbnailState::Failed)
+	{
+		thumbnail.Failed = true;
+		return thumbnail;
+	}
+	if (entry.State != ThumbnailState::Resident)
+		return thumbnail;
+
+	g_Slots[entry.Slot].LastUsedFrame = g_Frame;
+
+	// Inside the slot's border
+	float atlasSize = (float)(g_SlotsPerSide * Utils::GetSlotStride());
+	float x = (float)((entry.Slot % g_SlotsPerSide) * Utils::GetSlotStride() + 1);
+	float y = (float)((entry.Slot / g_SlotsPerSide) * Utils::GetSlotStride() + 1);
+	thumbnail.Texture = (ImTextureID)g_Atlas->GetDescriptorSet();
+	thumbnail.UV0 = ImVec2(x / atlasSize, y / atlasSize);
+	thumbnail.UV1 = ImVec2((x + entry.Width) / atlasSize, (y + entry.Height) / atlasSize);
+	thumbnail.Width = entry.Width;
+	thumbnail.Height = entry.Height;
+	thumbnail.Ready = true;
+	return thumbnail;
+}
+
+bool ThumbnailService::Image(const std::string& path, const ImVec2& size)
+{
+	Thumbnail thumbnail = Get(path);
+	if (!thumbnail.Ready)
+	{
+		ImGui::Image(thumbnail.Texture, size);
+		return false;
+	}
+
+	float scale = std::min(size.x / thumbnail.Width, size.y / thumbnail.Height);
+	ImVec2 fitted = ImVec2(thumbnail.Width * scale, thumbnail.Height * scale);
+	ImVec2 position = ImGui::GetCursorScreenPos();
+	ImVec2 min = ImVec2(position.x + (size.x - fitted.x) * 0.5f, position.y + (size.y - fitted.y) * 0.5f);
+
+	ImGui::Dummy(size);
+	ImGui::GetWindowDrawList()->AddImage(thumbnail.Texture, min, ImVec2(min.x + fitted.x, min.y + fitted.y), thumbnail.UV0, thumbnail.UV1);
+	return true;
+}
+
+uint32_t ThumbnailService::GetThumbnailSize()
+{
+	return g_ThumbnailSize;
+}
+
+ThumbnailStats ThumbnailService::GetStats()
+{
+	return g_Stats;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <imgui.h>
+#include <stdint.h>
+#include <string>
+
+struct Thumbnail
+{
+	// Placeholder until Ready
+	ImTextureID Texture = nullptr;
+	ImVec2 UV0 = ImVec2(0, 0);
+	ImVec2 UV1 = ImVec2(1, 1);
+	// Fits inside the thumbnail size with the source's aspect ratio, zero until Ready
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	bool Ready = false;
+	bool Failed = false;
+};
+
+struct ThumbnailStats
+{
+	uint32_t Slots = 0;
+	uint32_t Resident = 0;
+	uint32_t Queued = 0;
+	uint32_t InFlight = 0;
+	uint64_t Generated = 0;
+	uint64_t CacheHits = 0;
+};
+
+// Small previews of image files for browsers that list thousands of them. Thumbnails are made on
+// the job system (decode, SIMD halving, final box filter to the thumbnail size), stored in the
+// ImageCache under path + write time + size, and drawn from one shared atlas texture with a fixed
+// number of slots. Only thumbnails asked for in the last couple of frames are generated and the
+// least recently drawn slot is reused, so memory stays at the atlas size however large the folder.
+// Render thread only.
+class ThumbnailService
+{
+public:
+	// thumbnailSize is the longest side, the atlas holds slotsPerSide^2 thumbnails
+	static void Initialize(uint32_t thumbnailSize = 128, uint32_t slotsPerSide = 16);
+	static void Shutdown();
+
+	// Uploads finished thumbnails and starts jobs for the ones still wanted. Once per frame before ImGui::NewFrame.
+	static void Update();
+
+	// Requests the thumbnail for this frame, call it every frame the thumbnail is visible
+	static Thumbnail Get(const std::string& path);
+
+	// ImGui::Image of the thumbnail fitted and centred in size, the placeholder until it is ready.
+	// False while not ready.
+	static bool Image(const std::string& path, const ImVec2& size);
+
+	static uint32_t GetThumbnailSize();
+	static ThumbnailStats GetStats();
+};
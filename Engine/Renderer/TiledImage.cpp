@@ -0,0 +1,595 @@
+#include "TiledImage.h"
+#include "Texture.h"
+#include "ImageCache.h"
+#include "ImageDecoder.h"
+#include "MipGenerator.h"
+#include "TextureResidency.h"
+
+#include "../AstranEditorUI.h"
+#include "../Core/JobSystem.h"
+#include "../Core/MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+static const uint32_t g_PyramidMagic = 0x31525950; // "PYR1"
+static const uint32_t g_PyramidVersion = 1;
+
+// Tiles in flight on the job system and uploaded per frame, keeps a fast pan from flooding either
+static const uint32_t g_MaxPendingTiles = 8;
+static const uint32_t g_MaxUploadsPerFrame = 16;
+
+struct PyramidHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Key;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t TileSize;
+	uint32_t TileBorder;
+	uint32_t LevelCount;
+	uint32_t Reserved;
+};
+
+struct PyramidLevel
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	uint32_t TilesX = 0;
+	uint32_t TilesY = 0;
+	// Index of the level's first tile in the file
+	uint64_t FirstTile = 0;
+};
+
+struct LoadedTile
+{
+	uint64_t Key = 0;
+	std::vector<uint8_t> Pixels;
+};
+
+// Everything the jobs touch, kept alive by them when the TiledImage goes away first
+struct TiledImageSource
+{
+	enum class State
+	{
+		Building,
+		Ready,
+		Failed
+	};
+
+	std::string Path;
+	std::atomic<State> Status{ State::Building };
+	std::atomic<bool> Cancelled{ false };
+
+	// Written by the build job before Status turns Ready, read only after
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	std::vector<PyramidLevel> Levels;
+	MappedFile File;
+
+	std::mutex Mutex;
+	std::vector<LoadedTile> Completed;
+};
+
+namespace Utils {
+
+	static const uint32_t g_StoredTileSize = TiledImage::TileSize + TiledImage::TileBorder * 2;
+	static const uint64_t g_StoredTileBytes = (uint64_t)g_StoredTileSize * g_StoredTileSize * 4;
+
+	static uint64_t MakeTileKey(uint32_t level, uint32_t x, uint32_t y)
+	{
+		return ((uint64_t)level << 48) | ((uint64_t)y << 24) | x;
+	}
+
+	static void SplitTileKey(uint64_t key, uint32_t& level, uint32_t& x, uint32_t& y)
+	{
+		level = (uint32_t)(key >> 48);
+		y = (uint32_t)(key >> 24) & 0xFFFFFF;
+		x = (uint32_t)key & 0xFFFFFF;
+	}
+
+	// Halves until the whole level fits one tile, that level is always resident
+	static std::vector<PyramidLevel> GetLevels(uint32_t width, uint32_t height)
+	{
+		std::vector<PyramidLevel> levels;
+		uint64_t firstTile = 0;
+		for (uint32_t level = 0;; level++)
+		{
+			PyramidLevel info;
+			info.Width = MipGenerator::GetMipDimension(width, level);
+			info.Height = MipGenerator::GetMipDimension(height, level);
+			info.TilesX = (info.Width + TiledImage::TileSize - 1) / TiledImage::TileSize;
+			info.TilesY = (info.Height + TiledImage::TileSize - 1) / TiledImage::TileSize;
+			info.FirstTile = firstTile;
+			levels.push_back(info);
+
+			firstTile += (uint64_t)info.TilesX * info.TilesY;
+			if (info.TilesX == 1 && info.TilesY == 1)
+				break;
+		}
+		return levels;
+	}
+
+	// Same path, size and write time means the same pixels, without hashing gigabytes of source
+	static uint64_t GetPyramidKey(const std::string& path)
+	{
+		std::error_code error;
+		uint64_t size = std::filesystem::file_size(path, error);
+		if (error)
+			return 0;
+		uint64_t time = (uint64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+
+		std::string absolutePath = std::filesystem::absolute(path, error).string();
+		uint64_t key = ImageCache::Hash(absolutePath.data(), absolutePath.size(), g_PyramidMagic);
+		key = ImageCache::HashCombine(key, size);
+		key = ImageCache::HashCombine(key, time);
+		return ImageCache::HashCombine(key, g_PyramidVersion);
+	}
+
+	static std::string GetPyramidPath(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.pyr", (unsigned long long)key);
+		return (std::filesystem::path(ImageCache::GetDirectory()) / name).string();
+	}
+
+	// One stored tile of level, texels outside the level repeat its edge
+	static void ExtractTile(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t tileX, uint32_t tileY, uint8_t* tile)
+	{
+		int32_t originX = (int32_t)(tileX * TiledImage::TileSize) - (int32_t)TiledImage::TileBorder;
+		int32_t originY = (int32_t)(tileY * TiledImage::TileSize) - (int32_t)TiledImage::TileBorder;
+
+		for (uint32_t y = 0; y < g_StoredTileSize; y++)
+		{
+			int32_t sourceY = std::min(std::max(originY + (int32_t)y, 0), (int32_t)height - 1);
+			const uint8_t* sourceRow = pixels + (uint64_t)sourceY * width * 4;
+			uint8_t* row = tile + (uint64_t)y * g_StoredTileSize * 4;
+
+			// Inner run in one copy, only the clamped ends go texel by texel
+			int32_t begin = std::max(originX, 0);
+			int32_t end = std::min(originX + (int32_t)g_StoredTileSize, (int32_t)width);
+			for (int32_t x = originX; x < begin; x++)
+				memcpy(row + (x - originX) * 4, sourceRow, 4);
+			if (end > begin)
+				memcpy(row + (begin - originX) * 4, sourceRow + begin * 4, (size_t)(end - begin) * 4);
+			for (int32_t x = std::max(end, begin); x < originX + (int32_t)g_StoredTileSize; x++)
+				memcpy(row + (x - originX) * 4, sourceRow + ((uint64_t)width - 1) * 4, 4);
+		}
+	}
+
+	// Decodes the source once and writes every level tile by tile. Peak memory is level 0 plus level 1,
+	// the decoder has no way to hand out part of an image.
+	static bool BuildPyramid(const std::string& source, uint64_t key, const std::string& path)
+	{
+		DecodedImage image;
+		if (!ImageDecoder::DecodeRGBA(source, false, image, false))
+		{
+			std::cout << "[tiled] could not decode " << source << ": " << ImageDecoder::GetFailureReason() << "\n";
+			return false;
+		}
+
+		std::vector<PyramidLevel> levels = GetLevels(image.GetWidth(), image.GetHeight());
+
+		std::error_code error;
+		std::filesystem::create_directories(ImageCache::GetDirectory(), error);
+		std::string temporaryPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+		{
+			std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!stream)
+			{
+				std::cout << "[tiled] could not write " << temporaryPath << "\n";
+				return false;
+			}
+
+			PyramidHeader header = { g_PyramidMagic, g_PyramidVersion, key, image.GetWidth(), image.GetHeight(), TiledImage::TileSize, TiledImage::TileBorder, (uint32_t)levels.size(), 0 };
+			stream.write((const char*)&header, sizeof(header));
+
+			std::vector<uint8_t> tile(g_StoredTileBytes);
+			DecodedImage next;
+			for (size_t level = 0; level < levels.size() && stream; level++)
+			{
+				const PyramidLevel& info = levels[level];
+				for (uint32_t tileY = 0; tileY < info.TilesY; tileY++)
+				{
+					for (uint32_t tileX = 0; tileX < info.TilesX; tileX++)
+					{
+						ExtractTile(image.GetPixels(), info.Width, info.Height, tileX, tileY, tile.data());
+						stream.write((const char*)tile.data(), tile.size());
+					}
+				}
+
+				if (level + 1 < levels.size())
+				{
+					next.Allocate(levels[level + 1].Width, levels[level + 1].Height);
+					MipGenerator::DownsampleRGBA8(image.GetPixels(), info.Width, info.Height, next.GetPixels());
+					image = std::move(next);
+				}
+			}
+
+			if (!stream)
+			{
+				std::cout << "[tiled] could not write " << temporaryPath << "\n";
+				stream.close();
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporaryPath, path, error);
+		if (error)
+		{
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	static bool OpenPyramid(TiledImageSource& source, uint64_t key, const std::string& path)
+	{
+		if (!source.File.Open(path, FileAccess::Random) || source.File.GetSize() < sizeof(PyramidHeader))
+			return false;
+
+		PyramidHeader header;
+		memcpy(&header, source.File.GetData(), sizeof(header));
+		if (header.Magic != g_PyramidMagic || header.Version != g_PyramidVersion || header.Key != key
+			|| header.TileSize != TiledImage::TileSize || header.TileBorder != TiledImage::TileBorder || header.Width == 0 || header.Height == 0)
+		{
+			source.File.Close();
+			return false;
+		}
+
+		std::vector<PyramidLevel> levels = GetLevels(header.Width, header.Height);
+		const PyramidLevel& last = levels.back();
+		uint64_t tileCount = last.FirstTile + (uint64_t)last.TilesX * last.TilesY;
+		if (levels.size() != header.LevelCount || source.File.GetSize() != sizeof(PyramidHeader) + tileCount * g_StoredTileBytes)
+		{
+			// Truncated, rebuilt and renamed over
+			source.File.Close();
+			return false;
+		}
+
+		source.Width = header.Width;
+		source.Height = header.Height;
+		source.Levels = std::move(levels);
+		return true;
+	}
+
+	static void LoadTile(const std::shared_ptr<TiledImageSource>& source, uint64_t key)
+	{
+		if (source->Cancelled.load())
+			return;
+
+		uint32_t level, x, y;
+		SplitTileKey(key, level, x, y);
+		const PyramidLevel& info = source->Levels[level];
+		uint64_t index = info.FirstTile + (uint64_t)y * info.TilesX + x;
+
+		// The copy is what faults the pages in, off the render thread
+		LoadedTile tile;
+		tile.Key = key;
+		const uint8_t* data = source->File.GetData() + sizeof(PyramidHeader) + index * g_StoredTileBytes;
+		tile.Pixels.assign(data, data + g_StoredTileBytes);
+
+		std::lock_guard<std::mutex> lock(source->Mutex);
+		source->Completed.push_back(std::move(tile));
+	}
+
+}
+
+TiledImage::TiledImage(const std::string& path, uint32_t slotsPerSide)
+	: m_Path(path)
+{
+	m_SlotsPerSide = std::max(slotsPerSide, 2u);
+	m_Slots.resize((size_t)m_SlotsPerSide * m_SlotsPerSide);
+	m_Stats.CacheSlots = (uint32_t)m_Slots.size();
+
+	m_Source = std::make_shared<TiledImageSource>();
+	m_Source->Path = path;
+
+	std::shared_ptr<TiledImageSource> source = m_Source;
+	JobSystem::Submit([source]()
+	{
+		uint64_t key = Utils::GetPyramidKey(source->Path);
+		if (key == 0)
+		{
+			std::cout << "[tiled] could not open " << source->Path << "\n";
+			source->Status = TiledImageSource::State::Failed;
+			return;
+		}
+
+		std::string pyramidPath = Utils::GetPyramidPath(key);
+		if (!Utils::OpenPyramid(*source, key, pyramidPath))
+		{
+			if (source->Cancelled.load() || !Utils::BuildPyramid(source->Path, key, pyramidPath) || !Utils::OpenPyramid(*source, key, pyramidPath))
+			{
+				source->Status = TiledImageSource::State::Failed;
+				return;
+			}
+			std::cout << "[tiled] built " << source->Levels.size() << " levels for " << source->Path << "\n";
+		}
+		source->Status = TiledImageSource::State::Ready;
+	});
+}
+
+TiledImage::~TiledImage()
+{
+	// Jobs still queued see this and return, the ones running finish into the source they keep alive
+	m_Source->Cancelled = true;
+
+	// Frames in flight may still sample the cache
+	TextureResidency::Retire(std::move(m_Cache));
+}
+
+bool TiledImage::IsReady() const
+{
+	return m_Source->Status.load() == TiledImageSource::State::Ready;
+}
+
+bool TiledImage::HasFailed() const
+{
+	return m_Source->Status.load() == TiledImageSource::State::Failed;
+}
+
+uint32_t TiledImage::GetWidth() const
+{
+	return IsReady() ? m_Source->Width : 0;
+}
+
+uint32_t TiledImage::GetHeight() const
+{
+	return IsReady() ? m_Source->Height : 0;
+}
+
+uint32_t TiledImage::GetLevelCount() const
+{
+	return IsReady() ? (uint32_t)m_Source->Levels.size() : 0;
+}
+
+void TiledImage::Update()
+{
+	m_Frame++;
+	if (!IsReady())
+		return;
+
+	if (!m_Cache)
+	{
+		// No initial data, the first tile's region copy starts the image out from UNDEFINED
+		TextureSpecification specification;
+		specification.Format = ImageFormat::RGBA;
+		specification.Usage = TextureUsage::Static;
+		specification.Sampler.AddressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		specification.Sampler.AddressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		uint32_t size = m_SlotsPerSide * Utils::g_StoredTileSize;
+		m_Cache = std::make_unique<Texture>(size, size, specification);
+	}
+
+	std::vector<LoadedTile> completed;
+	{
+		std::lock_guard<std::mutex> lock(m_Source->Mutex);
+		completed.swap(m_Source->Completed);
+	}
+
+	uint32_t uploads = 0;
+	for (size_t i = 0; i < completed.size(); i++)
+	{
+		LoadedTile& tile = completed[i];
+		uint32_t slot = 0;
+		if (IsResident(tile.Key, slot))
+		{
+			m_Pending.erase(tile.Key);
+			continue;
+		}
+
+		slot = uploads < g_MaxUploadsPerFrame ? AcquireSlot() : ~0u;
+		if (slot == ~0u)
+		{
+			// Next frame, ahead of anything that finishes meanwhile
+			std::lock_guard<std::mutex> lock(m_Source->Mutex);
+			m_Source->Completed.insert(m_Source->Completed.begin(), std::make_move_iterator(completed.begin() + i), std::make_move_iterator(completed.end()));
+			break;
+		}
+
+		TextureRegion region;
+		region.X = (slot % m_SlotsPerSide) * Utils::g_StoredTileSize;
+		region.Y = (slot / m_SlotsPerSide) * Utils::g_StoredTileSize;
+		region.Width = Utils::g_StoredTileSize;
+		region.Height = Utils::g_StoredTileSize;
+		m_Cache->SetData(region, tile.Pixels.data());
+
+		m_Slots[slot].Key = tile.Key;
+		m_Slots[slot].LastUsedFrame = m_Frame;
+		m_Resident[tile.Key] = slot;
+		m_Pending.erase(tile.Key);
+
+		uploads++;
+		m_Stats.TilesStreamed++;
+	}
+
+	m_Stats.ResidentTiles = (uint32_t)m_Resident.size();
+	m_Stats.PendingTiles = (uint32_t)m_Pending.size();
+}
+
+void TiledImage::Draw(ImDrawList* drawList, const ImVec2& origin, float zoom, const ImVec2& clipMin, const ImVec2& clipMax)
+{
+	m_Stats.VisibleTiles = 0;
+	if (!IsReady() || !m_Cache || zoom <= 0.0f)
+		return;
+
+	const std::vector<PyramidLevel>& levels = m_Source->Levels;
+	uint32_t topLevel = (uint32_t)levels.size() - 1;
+
+	// Coarsest level that still has at least one texel per screen pixel
+	float levelFloat = std::floor(std::log2(1.0f / zoom));
+	uint32_t level = (uint32_t)std::min(std::max(levelFloat, 0.0f), (float)topLevel);
+	m_Stats.Level = level;
+
+	const PyramidLevel& info = levels[level];
+	// Screen pixels per level texel, exact per axis since odd sizes round down
+	float scaleX = zoom * (float)m_Source->Width / (float)info.Width;
+	float scaleY = zoom * (float)m_Source->Height / (float)info.Height;
+
+	ImVec2 visibleMin = ImVec2(std::max(clipMin.x, origin.x), std::max(clipMin.y, origin.y));
+	ImVec2 visibleMax = ImVec2(std::min(clipMax.x, origin.x + info.Width * scaleX), std::min(clipMax.y, origin.y + info.Height * scaleY));
+
+	std::vector<uint64_t> requests;
+	uint32_t topSlot = 0;
+	bool needsTop = !IsResident(Utils::MakeTileKey(topLevel, 0, 0), topSlot);
+	if (needsTop)
+		requests.push_back(Utils::MakeTileKey(topLevel, 0, 0));
+
+	if (visibleMin.x < visibleMax.x && visibleMin.y < visibleMax.y)
+	{
+		uint32_t firstX = (uint32_t)((visibleMin.x - origin.x) / scaleX) / TileSize;
+		uint32_t firstY = (uint32_t)((visibleMin.y - origin.y) / scaleY) / TileSize;
+		uint32_t lastX = std::min((uint32_t)((visibleMax.x - origin.x) / scaleX) / TileSize, info.TilesX - 1);
+		uint32_t lastY = std::min((uint32_t)((visibleMax.y - origin.y) / scaleY) / TileSize, info.TilesY - 1);
+
+		for (uint32_t y = firstY; y <= lastY; y++)
+		{
+			for (uint32_t x = firstX; x <= lastX; x++)
+			{
+				ImVec2 min = ImVec2(origin.x + (float)(x * TileSize) * scaleX, origin.y + (float)(y * TileSize) * scaleY);
+				ImVec2 max = ImVec2(origin.x + (float)std::min((x + 1) * TileSize, info.Width) * scaleX, origin.y + (float)std::min((y + 1) * TileSize, info.Height) * scaleY);
+				m_Stats.VisibleTiles++;
+
+				uint64_t key = Utils::MakeTileKey(level, x, y);
+				uint32_t slot = 0;
+				if (IsResident(key, slot))
+				{
+					ImVec2 texels = ImVec2((float)std::min(TileSize, info.Width - x * TileSize), (float)std::min(TileSize, info.Height - y * TileSize));
+					DrawTile(drawList, slot, min, max, ImVec2(0, 0), texels);
+					continue;
+				}
+
+				DrawFallback(drawList, level, x, y, min, max);
+				requests.push_back(key);
+			}
+		}
+	}
+
+	if (!requests.empty())
+	{
+		// The top level first so there is always something to fall back on, then the middle of the view outwards
+		ImVec2 centre = ImVec2((visibleMin.x + visibleMax.x - 2.0f * origin.x) * 0.5f / scaleX / TileSize, (visibleMin.y + visibleMax.y - 2.0f * origin.y) * 0.5f / scaleY / TileSize);
+		std::stable_sort(requests.begin() + (needsTop ? 1 : 0), requests.end(), [&centre](uint64_t a, uint64_t b)
+		{
+			uint32_t levelA, xA, yA, levelB, xB, yB;
+			Utils::SplitTileKey(a, levelA, xA, yA);
+			Utils::SplitTileKey(b, levelB, xB, yB);
+			float distanceA = std::fabs(xA + 0.5f - centre.x) + std::fabs(yA + 0.5f - centre.y);
+			float distanceB = std::fabs(xB + 0.5f - centre.x) + std::fabs(yB + 0.5f - centre.y);
+			return distanceA < distanceB;
+		});
+		RequestTiles(requests);
+	}
+}
+
+bool TiledImage::IsResident(uint64_t key, uint32_t& outSlot)
+{
+	auto found = m_Resident.find(key);
+	if (found == m_Resident.end())
+		return false;
+
+	outSlot = found->second;
+	return true;
+}
+
+void TiledImage::DrawTile(ImDrawList* drawList, uint32_t slot, const ImVec2& min, const ImVec2& max, const ImVec2& uvMin, const ImVec2& uvMax)
+{
+	m_Slots[slot].LastUsedFrame = m_Frame;
+
+	// uvMin/uvMax are texels inside the tile, skip the border and scale to the cache texture
+	float cacheSize = (float)(m_SlotsPerSide * Utils::g_StoredTileSize);
+	float slotX = (float)((slot % m_SlotsPerSide) * Utils::g_StoredTileSize + TileBorder);
+	float slotY = (float)((slot / m_SlotsPerSide) * Utils::g_StoredTileSize + TileBorder);
+	ImVec2 uv0 = ImVec2((slotX + uvMin.x) / cacheSize, (slotY + uvMin.y) / cacheSize);
+	ImVec2 uv1 = ImVec2((slotX + uvMax.x) / cacheSize, (slotY + uvMax.y) / cacheSize);
+	drawList->AddImage((ImTextureID)m_Cache->GetDescriptorSet(), min, max, uv0, uv1);
+}
+
+bool TiledImage::DrawFallback(ImDrawList* drawList, uint32_t level, uint32_t x, uint32_t y, const ImVec2& min, const ImVec2& max)
+{
+	const std::vector<PyramidLevel>& levels = m_Source->Levels;
+	const PyramidLevel& info = levels[level];
+
+	// The tile's rectangle as a fraction of the image, the same in every level
+	float u0 = (float)(x * TileSize) / info.Width;
+	float v0 = (float)(y * TileSize) / info.Height;
+	float u1 = (float)std::min((x + 1) * TileSize, info.Width) / info.Width;
+	float v1 = (float)std::min((y + 1) * TileSize, info.Height) / info.Height;
+
+	for (uint32_t ancestor = level + 1; ancestor < (uint32_t)levels.size(); ancestor++)
+	{
+		const PyramidLevel& parent = levels[ancestor];
+		ImVec2 texelMin = ImVec2(u0 * parent.Width, v0 * parent.Height);
+		ImVec2 texelMax = ImVec2(u1 * parent.Width, v1 * parent.Height);
+		uint32_t parentX = std::min((uint32_t)texelMin.x / TileSize, parent.TilesX - 1);
+		uint32_t parentY = std::min((uint32_t)texelMin.y / TileSize, parent.TilesY - 1);
+
+		uint32_t slot = 0;
+		if (!IsResident(Utils::MakeTileKey(ancestor, parentX, parentY), slot))
+			continue;
+
+		float originX = (float)(parentX * TileSize);
+		float originY = (float)(parentY * TileSize);
+		DrawTile(drawList, slot, min, max, ImVec2(texelMin.x - originX, texelMin.y - originY), ImVec2(texelMax.x - originX, texelMax.y - originY));
+		return true;
+	}
+	return false;
+}
+
+void TiledImage::RequestTiles(std::vector<uint64_t>& keys)
+{
+	for (uint64_t key : keys)
+	{
+		if (m_Pending.size() >= g_MaxPendingTiles)
+			break;
+		if (!m_Pending.insert(key).second)
+			continue;
+
+		std::shared_ptr<TiledImageSource> source = m_Source;
+		JobSystem::Submit([source, key]()
+		{
+			Utils::LoadTile(source, key);
+		});
+	}
+	m_Stats.PendingTiles = (uint32_t)m_Pending.size();
+}
+
+uint32_t TiledImage::AcquireSlot()
+{
+	// Least recently drawn slot that no frame in flight can still be sampling. The top level tile
+	// never leaves, it is the fallback of last resort.
+	uint64_t retireDelay = (uint64_t)std::max(AstranEditorUI::GetFramesInFlight(), 1u) + 1;
+	uint32_t topLevel = (uint32_t)m_Source->Levels.size() - 1;
+
+	uint32_t best = ~0u;
+	for (uint32_t slot = 0; slot < (uint32_t)m_Slots.size(); slot++)
+	{
+		const Slot& candidate = m_Slots[slot];
+		if (candidate.Key == ~0ull)
+			return slot;
+		if ((uint32_t)(candidate.Key >> 48) == topLevel || candidate.LastUsedFrame + retireDelay >= m_Frame)
+			continue;
+		if (best == ~0u || candidate.LastUsedFrame < m_Slots[best].LastUsedFrame)
+			best = slot;
+	}
+
+	if (best != ~0u)
+	{
+		m_Resident.erase(m_Slots[best].Key);
+		m_Slots[best].Key = ~0ull;
+	}
+	return best;
+}
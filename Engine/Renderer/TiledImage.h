@@ -0,0 +1,89 @@
+#pragma once
+#include <imgui.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class Texture;
+struct TiledImageSource;
+
+struct TiledImageStats
+{
+	uint32_t Level = 0;
+	uint32_t VisibleTiles = 0;
+	uint32_t ResidentTiles = 0;
+	uint32_t CacheSlots = 0;
+	uint32_t PendingTiles = 0;
+	uint64_t TilesStreamed = 0;
+};
+
+// Image of any size shown through a fixed size tile cache texture. The source is decoded once
+// into a tile pyramid (256px tiles, every level half the previous one) stored next to the
+// ImageCache entries, later opens just map it. Tiles a view needs are read on the job system and
+// copied into free cache slots, the least recently drawn tile gives up its slot when the cache is
+// full, so GPU memory stays at the cache size however large the source is.
+// Render thread only, except that loading runs on the job system.
+class TiledImage
+{
+public:
+	static const uint32_t TileSize = 256;
+	// Every stored tile repeats one texel of its neighbours so linear filtering never reads
+	// another cache slot
+	static const uint32_t TileBorder = 1;
+
+	// slotsPerSide^2 tiles stay resident, 16 is a 4128px RGBA8 texture (68 MiB)
+	explicit TiledImage(const std::string& path, uint32_t slotsPerSide = 16);
+	~TiledImage();
+
+	TiledImage(const TiledImage&) = delete;
+	TiledImage& operator=(const TiledImage&) = delete;
+
+	// False until the pyramid has been built or found on disk
+	bool IsReady() const;
+	bool HasFailed() const;
+
+	const std::string& GetPath() const { return m_Path; }
+	// Level 0 size, 0 until IsReady()
+	uint32_t GetWidth() const;
+	uint32_t GetHeight() const;
+	uint32_t GetLevelCount() const;
+
+	// Uploads tiles that finished loading. Call once per frame before drawing.
+	void Update();
+
+	// Draws the image with its top left corner at origin, zoom screen pixels per image pixel,
+	// clipped to [clipMin, clipMax]. Tiles still loading are covered by the closest coarser
+	// resident level until they arrive.
+	void Draw(ImDrawList* drawList, const ImVec2& origin, float zoom, const ImVec2& clipMin, const ImVec2& clipMax);
+
+	const TiledImageStats& GetStats() const { return m_Stats; }
+
+private:
+	struct Slot
+	{
+		uint64_t Key = ~0ull;
+		uint64_t LastUsedFrame = 0;
+	};
+
+	bool IsResident(uint64_t key, uint32_t& outSlot);
+	void DrawTile(ImDrawList* drawList, uint32_t slot, const ImVec2& min, const ImVec2& max, const ImVec2& uvMin, const ImVec2& uvMax);
+	bool DrawFallback(ImDrawList* drawList, uint32_t level, uint32_t x, uint32_t y, const ImVec2& min, const ImVec2& max);
+	void RequestTiles(std::vector<uint64_t>& keys);
+	uint32_t AcquireSlot();
+
+	std::string m_Path;
+	std::shared_ptr<TiledImageSource> m_Source;
+
+	std::unique_ptr<Texture> m_Cache;
+	uint32_t m_SlotsPerSide = 0;
+	std::vector<Slot> m_Slots;
+	std::unordered_map<uint64_t, uint32_t> m_Resident;
+	// Requested from the job system, not uploaded yet
+	std::unordered_set<uint64_t> m_Pending;
+
+	uint64_t m_Frame = 0;
+	TiledImageStats m_Stats;
+};
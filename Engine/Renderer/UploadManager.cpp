@@ -0,0 +1,863 @@
+#include "UploadManager.h"
+
+#include "../AstranEditorUI.h"
+#include "DeviceMemoryAllocator.h"
+#include "GpuCompletionTracker.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+struct PendingImageUpload
+{
+	VkImage image = VK_NULL_HANDLE;
+	uint32_t mipLevels = 1;
+	uint32_t arrayLayers = 1;
+	std::vector<VkBufferImageCopy> regions;
+	std::vector<VkBuffer> sources; // one per region, ring or dedicated buffer
+
+	// Only when every copy queued this batch is a partial update, a single whole image
+	// upload lets the batch discard the old contents
+	bool preserveContents = false;
+	// Earlier frames sampled the image, the copies are ordered after their fragment shaders
+	bool sampled = false;
+
+	// Set by QueueMipGeneration, levels past 0 are blitted after the copies
+	bool generateMips = false;
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	// Copies go to the dedicated transfer queue, see BeginAsyncUploads
+	bool transfer = false;
+};
+
+struct DedicatedStagingBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	DeviceAllocation* memory = nullptr;
+	VkDeviceSize size = 0;
+};
+
+struct UploadBatch
+{
+	uint64_t id = 0;
+	// Graphics queue part, also carries the acquire barriers of earlier transfer parts
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	// Transfer queue part, only with a dedicated transfer queue
+	VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+	VkFence transferFence = VK_NULL_HANDLE;
+	VkDeviceSize ringBytes = 0;
+	std::vector<DedicatedStagingBuffer> dedicatedBuffers;
+
+	// Release barriers of the transfer part, the graphics queue acquires the images once it finished
+	std::vector<VkImageMemoryBarrier> acquires;
+	// Earlier batches whose acquire barriers this one's graphics part records
+	std::vector<uint64_t> acquiredBatches;
+	// Batch that records this one's acquire barriers, 0 until it is flushed
+	uint64_t acquireBatch = 0;
+
+	// Both parts finished and the staging memory went back
+	bool copied = false;
+	// The images can be used on the graphics queue
+	bool done = false;
+};
+
+static VkBuffer                            g_RingBuffer = VK_NULL_HANDLE;
+static DeviceAllocation*                   g_RingMemory = nullptr;
+static char*                               g_RingData = nullptr;
+static VkDeviceSize                        g_RingSize = 0;
+static VkDeviceSize                        g_RingHead = 0;
+static VkDeviceSize                        g_RingTail = 0;
+static VkDeviceSize                        g_RingUsed = 0;
+
+static VkCommandPool                       g_CommandPool = VK_NULL_HANDLE;
+static std::vector<VkCommandBuffer>        g_FreeCommandBuffers;
+static VkCommandPool                       g_TransferCommandPool = VK_NULL_HANDLE;
+static std::vector<VkCommandBuffer>        g_FreeTransferCommandBuffers;
+static std::vector<VkFence>                g_FreeFences;
+
+static bool                                g_AsyncUploads = false;
+// Acquire barriers of finished transfer parts and their batches, recorded by the next Flush
+static std::vector<VkImageMemoryBarrier>   g_PendingAcquires;
+static std::vector<uint64_t>               g_PendingAcquireBatches;
+
+static std::vector<PendingImageUpload>     g_PendingUploads;
+static VkDeviceSize                        g_PendingRingBytes = 0;
+static std::vector<DedicatedStagingBuffer> g_PendingDedicatedBuffers;
+
+// Consecutive ids, retired from the front once done
+static std::deque<UploadBatch>             g_InFlightBatches;
+static uint64_t                            g_NextBatchId = 1;
+
+static VkDeviceSize                        g_DedicatedBytes = 0;
+
+static UploadStats                         g_CurrentStats;
+static UploadStats                         g_LastFrameStats;
+
+namespace Utils {
+
+	static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static void CreateStagingBuffer(VkDeviceSize size, VkBuffer& buffer, DeviceAllocation*& memory)
+	{
+		VkDevice device = AstranEditorUI::GetDevice();
+		VkResult err;
+
+		VkBufferCreateInfo buffer_info = {};
+		buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		buffer_info.size = size;
+		buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		// Read by both queues from one frame to the next, concurrent saves an ownership transfer per use
+		uint32_t families[2] = { AstranEditorUI::GetQueueFamily(), AstranEditorUI::GetTransferQueueFamily() };
+		if (AstranEditorUI::HasDedicatedTransferQueue())
+		{
+			buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			buffer_info.queueFamilyIndexCount = 2;
+			buffer_info.pQueueFamilyIndices = families;
+		}
+		err = vkCreateBuffer(device, &buffer_info, nullptr, &buffer);
+		check_vk_result(err);
+
+		// Coherent memory so the ring never needs explicit flushes, the allocator keeps it mapped
+		memory = DeviceMemoryAllocator::AllocateForBuffer(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		IM_ASSERT(memory && "UploadManager: out of host visible memory");
+	}
+
+	// Staging of its own, released with the batch it ends up in
+	static StagingAllocation AllocateDedicated(VkDeviceSize size)
+	{
+		DedicatedStagingBuffer dedicated;
+		dedicated.size = size;
+		CreateStagingBuffer(size, dedicated.buffer, dedicated.memory);
+		g_DedicatedBytes += size;
+		g_PendingDedicatedBuffers.push_back(dedicated);
+
+		StagingAllocation allocation;
+		allocation.Data = dedicated.memory->MappedData;
+		allocation.Buffer = dedicated.buffer;
+		allocation.Offset = 0;
+		allocation.Size = size;
+		return allocation;
+	}
+
+	static VkCommandPool CreateCommandPool(uint32_t queueFamily)
+	{
+		VkCommandPoolCreateInfo pool_info = {};
+		pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		pool_info.queueFamilyIndex = queueFamily;
+		VkCommandPool pool;
+		VkResult err = vkCreateCommandPool(AstranEditorUI::GetDevice(), &pool_info, nullptr, &pool);
+		check_vk_result(err);
+		return pool;
+	}
+
+	// A recycled or new command buffer of pool, begun for one submit
+	static VkCommandBuffer BeginCommandBuffer(VkCommandPool pool, std::vector<VkCommandBuffer>& freeCommandBuffers)
+	{
+		VkDevice device = AstranEditorUI::GetDevice();
+		VkResult err;
+
+		VkCommandBuffer commandBuffer;
+		if (!freeCommandBuffers.empty())
+		{
+			commandBuffer = freeCommandBuffers.back();
+			freeCommandBuffers.pop_back();
+		}
+		else
+		{
+			VkCommandBufferAllocateInfo alloc_info = {};
+			alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			alloc_info.commandPool = pool;
+			alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			alloc_info.commandBufferCount = 1;
+			err = vkAllocateCommandBuffers(device, &alloc_info, &commandBuffer);
+			check_vk_result(err);
+		}
+
+		VkCommandBufferBeginInfo begin_info = {};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		err = vkBeginCommandBuffer(commandBuffer, &begin_info);
+		check_vk_result(err);
+		return commandBuffer;
+	}
+
+	static VkFence AcquireFence()
+	{
+		if (!g_FreeFences.empty())
+		{
+			VkFence fence = g_FreeFences.back();
+			g_FreeFences.pop_back();
+			return fence;
+		}
+
+		VkFenceCreateInfo fence_info = {};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkFence fence;
+		VkResult err = vkCreateFence(AstranEditorUI::GetDevice(), &fence_info, nullptr, &fence);
+		check_vk_result(err);
+		return fence;
+	}
+
+	static bool IsSignalled(VkFence fence)
+	{
+		return !fence || vkGetFenceStatus(AstranEditorUI::GetDevice(), fence) == VK_SUCCESS;
+	}
+
+	static UploadBatch* FindBatch(uint64_t id)
+	{
+		if (g_InFlightBatches.empty() || id < g_InFlightBatches.front().id || id > g_InFlightBatches.back().id)
+			return nullptr;
+		return &g_InFlightBatches[(size_t)(id - g_InFlightBatches.front().id)];
+	}
+
+	// Blocks until both queues finished the copies of batch, its acquire may still be pending
+	static void WaitForCopies(const UploadBatch& batch)
+	{
+		VkFence fences[2];
+		uint32_t count = 0;
+		if (batch.fence)
+			fences[count++] = batch.fence;
+		if (batch.transferFence)
+			fences[count++] = batch.transferFence;
+		if (count == 0)
+			return;
+
+		VkResult err = vkWaitForFences(AstranEditorUI::GetDevice(), count, fences, VK_TRUE, UINT64_MAX);
+		check_vk_result(err);
+	}
+
+	static bool IsBatchDone(uint64_t id)
+	{
+		if (id >= g_NextBatchId)
+			return false;
+		UploadBatch* batch = FindBatch(id);
+		return !batch || batch->done;
+	}
+
+	// Staging the UploadManager owns, shared with the transfer queue. Per texture upload buffers are not.
+	static bool IsSharedStaging(VkBuffer buffer)
+	{
+		if (buffer == g_RingBuffer)
+			return true;
+		for (const DedicatedStagingBuffer& dedicated : g_PendingDedicatedBuffers)
+		{
+			if (dedicated.buffer == buffer)
+				return true;
+		}
+		return false;
+	}
+
+	// Levels [1, mipLevels) of every upload flagged generateMips, blitted from level 0
+	static void RecordMipGeneration(VkCommandBuffer commandBuffer, const std::vector<PendingImageUpload>& uploads)
+	{
+		uint32_t maxLevels = 1;
+		for (const PendingImageUpload& upload : uploads)
+		{
+			if (upload.generateMips && upload.mipLevels > maxLevels)
+				maxLevels = upload.mipLevels;
+		}
+
+		// Walk the chains level by level so every image shares one barrier per step
+		std::vector<VkImageMemoryBarrier> barriers;
+		for (uint32_t level = 1; level < maxLevels; level++)
+		{
+			barriers.clear();
+			for (const PendingImageUpload& upload : uploads)
+			{
+				if (!upload.generateMips || level >= upload.mipLevels)
+					continue;
+
+				VkImageMemoryBarrier barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = upload.image;
+				barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				barrier.subresourceRange.baseMipLevel = level - 1;
+				barrier.subresourceRange.levelCount = 1;
+				barrier.subresourceRange.layerCount = upload.arrayLayers;
+				barriers.push_back(barrier);
+			}
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, (uint32_t)barriers.size(), barriers.data());
+
+			for (const PendingImageUpload& upload : uploads)
+			{
+				if (!upload.generateMips || level >= upload.mipLevels)
+					continue;
+
+				VkImageBlit blit = {};
+				blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				blit.srcSubresource.mipLevel = level - 1;
+				blit.srcSubresource.layerCount = upload.arrayLayers;
+				blit.srcOffsets[1].x = (int32_t)std::max(upload.width >> (level - 1), 1u);
+				blit.srcOffsets[1].y = (int32_t)std::max(upload.height >> (level - 1), 1u);
+				blit.srcOffsets[1].z = 1;
+				blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+				blit.dstSubresource.mipLevel = level;
+				blit.dstSubresource.layerCount = upload.arrayLayers;
+				blit.dstOffsets[1].x = (int32_t)std::max(upload.width >> level, 1u);
+				blit.dstOffsets[1].y = (int32_t)std::max(upload.height >> level, 1u);
+				blit.dstOffsets[1].z = 1;
+				vkCmdBlitImage(commandBuffer, upload.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+			}
+		}
+	}
+
+	// Layout barriers, copies and mip blits of uploads. With release the images end up released from
+	// the transfer to the graphics queue family and the matching acquire barriers are returned.
+	static std::vector<VkImageMemoryBarrier> RecordUploads(VkCommandBuffer commandBuffer, const std::vector<PendingImageUpload>& uploads, bool release)
+	{
+		VkPipelineStageFlags copy_src_stages = VK_PIPELINE_STAGE_HOST_BIT;
+		std::vector<VkImageMemoryBarrier> barriers(uploads.size());
+		for (size_t i = 0; i < uploads.size(); i++)
+		{
+			VkImageMemoryBarrier& copy_barrier = barriers[i];
+			copy_barrier = {};
+			copy_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			copy_barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			if (uploads[i].sampled)
+			{
+				// Discarded texels may still be read by frames in flight
+				copy_src_stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			}
+			if (uploads[i].preserveContents)
+			{
+				// Earlier frames sampled it, the copy has to wait for them and keep the texels
+				copy_barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				copy_src_stages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			}
+			copy_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			copy_barrier.image = uploads[i].image;
+			copy_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy_barrier.subresourceRange.levelCount = uploads[i].mipLevels;
+			copy_barrier.subresourceRange.layerCount = uploads[i].arrayLayers;
+		}
+		vkCmdPipelineBarrier(commandBuffer, copy_src_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, (uint32_t)barriers.size(), barriers.data());
+
+		for (const PendingImageUpload& upload : uploads)
+		{
+			// One copy per run of regions sharing a source buffer
+			size_t first = 0;
+			for (size_t i = 1; i <= upload.regions.size(); i++)
+			{
+				if (i == upload.regions.size() || upload.sources[i] != upload.sources[first])
+				{
+					vkCmdCopyBufferToImage(commandBuffer, upload.sources[first], upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)(i - first), &upload.regions[first]);
+					first = i;
+				}
+			}
+		}
+
+		RecordMipGeneration(commandBuffer, uploads);
+
+		std::vector<VkImageMemoryBarrier> use_barriers;
+		use_barriers.reserve(barriers.size());
+		for (size_t i = 0; i < uploads.size(); i++)
+		{
+			const PendingImageUpload& upload = uploads[i];
+
+			VkImageMemoryBarrier use_barrier = barriers[i];
+			use_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			use_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			use_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			use_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			if (upload.generateMips)
+			{
+				// Every level but the last was a blit source
+				VkImageMemoryBarrier source_barrier = use_barrier;
+				source_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				source_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				source_barrier.subresourceRange.levelCount = upload.mipLevels - 1;
+				use_barriers.push_back(source_barrier);
+
+				use_barrier.subresourceRange.baseMipLevel = upload.mipLevels - 1;
+				use_barrier.subresourceRange.levelCount = 1;
+			}
+			use_barriers.push_back(use_barrier);
+		}
+
+		if (!release)
+		{
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, (uint32_t)use_barriers.size(), use_barriers.data());
+			return {};
+		}
+
+		// Release half of the ownership transfer, the layout change happens once for both halves.
+		// The acquire half does the SHADER_READ access, a transfer queue has no shader stages.
+		std::vector<VkImageMemoryBarrier> acquires = use_barriers;
+		for (size_t i = 0; i < use_barriers.size(); i++)
+		{
+			use_barriers[i].srcQueueFamilyIndex = AstranEditorUI::GetTransferQueueFamily();
+			use_barriers[i].dstQueueFamilyIndex = AstranEditorUI::GetQueueFamily();
+			use_barriers[i].dstAccessMask = 0;
+
+			acquires[i].srcQueueFamilyIndex = use_barriers[i].srcQueueFamilyIndex;
+			acquires[i].dstQueueFamilyIndex = use_barriers[i].dstQueueFamilyIndex;
+			acquires[i].srcAccessMask = 0;
+		}
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, (uint32_t)use_barriers.size(), use_barriers.data());
+		return acquires;
+	}
+
+}
+
+void UploadManager::Initialize(VkDeviceSize ringSize)
+{
+	g_RingSize = ringSize;
+	Utils::CreateStagingBuffer(g_RingSize, g_RingBuffer, g_RingMemory);
+	g_RingData = (char*)g_RingMemory->MappedData;
+
+	g_CommandPool = Utils::CreateCommandPool(AstranEditorUI::GetQueueFamily());
+	if (AstranEditorUI::HasDedicatedTransferQueue())
+	{
+		g_TransferCommandPool = Utils::CreateCommandPool(AstranEditorUI::GetTransferQueueFamily());
+	}
+}
+
+void UploadManager::Shutdown()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	Flush();
+	WaitForBatch(g_NextBatchId - 1);
+
+	for (VkFence fence : g_FreeFences)
+	{
+		vkDestroyFence(device, fence, nullptr);
+	}
+	g_FreeFences.clear();
+
+	if (!g_FreeCommandBuffers.empty())
+	{
+		vkFreeCommandBuffers(device, g_CommandPool, (uint32_t)g_FreeCommandBuffers.size(), g_FreeCommandBuffers.data());
+		g_FreeCommandBuffers.clear();
+	}
+	vkDestroyCommandPool(device, g_CommandPool, nullptr);
+	g_CommandPool = VK_NULL_HANDLE;
+
+	if (g_TransferCommandPool)
+	{
+		if (!g_FreeTransferCommandBuffers.empty())
+		{
+			vkFreeCommandBuffers(device, g_TransferCommandPool, (uint32_t)g_FreeTransferCommandBuffers.size(), g_FreeTransferCommandBuffers.data());
+			g_FreeTransferCommandBuffers.clear();
+		}
+		vkDestroyCommandPool(device, g_TransferCommandPool, nullptr);
+		g_TransferCommandPool = VK_NULL_HANDLE;
+	}
+
+	vkDestroyBuffer(device, g_RingBuffer, nullptr);
+	DeviceMemoryAllocator::Free(g_RingMemory);
+	g_RingBuffer = VK_NULL_HANDLE;
+	g_RingMemory = nullptr;
+	g_RingData = nullptr;
+}
+
+StagingAllocation UploadManager::AllocateStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+	if (size > g_RingSize)
+	{
+		return Utils::AllocateDedicated(size);
+	}
+
+	StagingAllocation allocation;
+	allocation.Size = size;
+
+	for (;;)
+	{
+		if (g_RingUsed == 0)
+		{
+			g_RingHead = 0;
+			g_RingTail = 0;
+		}
+
+		bool full = g_RingUsed != 0 && g_RingHead == g_RingTail;
+		VkDeviceSize offset = Utils::AlignUp(g_RingHead, alignment);
+		VkDeviceSize consumed = 0;
+		bool fits = false;
+
+		if (!full && g_RingHead >= g_RingTail)
+		{
+			if (offset + size <= g_RingSize)
+			{
+				consumed = offset + size - g_RingHead;
+				fits = true;
+			}
+			else if (size <= g_RingTail)
+			{
+				// Skip the tail end of the ring and start again from the beginning
+				offset = 0;
+				consumed = (g_RingSize - g_RingHead) + size;
+				fits = true;
+			}
+		}
+		else if (!full && offset + size <= g_RingTail)
+		{
+			consumed = offset + size - g_RingHead;
+			fits = true;
+		}
+
+		if (fits)
+		{
+			g_RingHead = offset + size;
+			g_RingUsed += consumed;
+			g_PendingRingBytes += consumed;
+
+			allocation.Data = g_RingData + offset;
+			allocation.Buffer = g_RingBuffer;
+			allocation.Offset = offset;
+			return allocation;
+		}
+
+		// Out of space: push what we have and wait for the oldest batch still holding ring space.
+		// Batches whose copies are done already gave theirs back and only wait for their acquire.
+		Flush();
+		const UploadBatch* oldest = nullptr;
+		for (const UploadBatch& batch : g_InFlightBatches)
+		{
+			if (!batch.copied)
+			{
+				oldest = &batch;
+				break;
+			}
+		}
+
+		if (!oldest)
+		{
+			// Whatever is left is held by allocations whose copies aren't queued yet
+			return Utils::AllocateDedicated(size);
+		}
+
+		Utils::WaitForCopies(*oldest);
+		RetireCompletedBatches();
+	}
+}
+
+void UploadManager::QueueImageUpload(VkImage image, const StagingAllocation& staging, const VkBufferImageCopy* regions, uint32_t regionCount, uint32_t mipLevels, uint32_t arrayLayers, bool sampled)
+{
+	QueueCopies(image, staging, regions, regionCount, mipLevels, arrayLayers, false, sampled);
+}
+
+void UploadManager::QueueImageUpdate(VkImage image, const StagingAllocation& staging, const VkBufferImageCopy* regions, uint32_t regionCount, uint32_t mipLevels, uint32_t arrayLayers)
+{
+	QueueCopies(image, staging, regions, regionCount, mipLevels, arrayLayers, true, true);
+}
+
+void UploadManager::QueueCopies(VkImage image, const StagingAllocation& staging, const VkBufferImageCopy* regions, uint32_t regionCount, uint32_t mipLevels, uint32_t arrayLayers, bool preserveContents, bool sampled)
+{
+	PendingImageUpload* upload = nullptr;
+	for (PendingImageUpload& pending : g_PendingUploads)
+	{
+		// Several updates of one image in a frame share its barriers, copies run in queue order
+		if (pending.image == image)
+		{
+			upload = &pending;
+			break;
+		}
+	}
+
+	// Only whole images nothing samples before IsComplete may move queues, and only from staging both
+	// queues share
+	bool transfer = g_AsyncUploads && g_TransferCommandPool && !preserveContents && !sampled && Utils::IsSharedStaging(staging.Buffer);
+
+	if (!upload)
+	{
+		g_PendingUploads.emplace_back();
+		upload = &g_PendingUploads.back();
+		upload->image = image;
+		upload->mipLevels = mipLevels;
+		upload->arrayLayers = arrayLayers;
+		upload->preserveContents = preserveContents;
+		upload->sampled = sampled;
+		upload->transfer = transfer;
+	}
+	else
+	{
+		upload->preserveContents = upload->preserveContents && preserveContents;
+		upload->sampled = upload->sampled || sampled;
+		upload->transfer = upload->transfer && transfer;
+	}
+
+	for (uint32_t i = 0; i < regionCount; i++)
+	{
+		VkBufferImageCopy region = regions[i];
+		region.bufferOffset += staging.Offset;
+		upload->regions.push_back(region);
+		upload->sources.push_back(staging.Buffer);
+	}
+
+	g_CurrentStats.Uploads++;
+	g_CurrentStats.Bytes += staging.Size;
+}
+
+void UploadManager::QueueMipGeneration(VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	for (PendingImageUpload& pending : g_PendingUploads)
+	{
+		if (pending.image == image)
+		{
+			IM_ASSERT(pending.mipLevels == mipLevels);
+			pending.generateMips = mipLevels > 1;
+			// Blits need the graphics queue
+			pending.transfer = pending.transfer && !pending.generateMips;
+			pending.width = width;
+			pending.height = height;
+			return;
+		}
+	}
+
+	IM_ASSERT(false && "QueueMipGeneration needs a queued upload of level 0 first");
+}
+
+void UploadManager::UploadImage(VkImage image, uint32_t width, uint32_t height, const void* data, VkDeviceSize size)
+{
+	StagingAllocation staging = AllocateStaging(size);
+	memcpy(staging.Data, data, size);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent.width = width;
+	region.imageExtent.height = height;
+	region.imageExtent.depth = 1;
+	QueueImageUpload(image, staging, &region, 1);
+}
+
+void UploadManager::SubmitFrame()
+{
+	Flush();
+	RetireCompletedBatches();
+
+	g_LastFrameStats = g_CurrentStats;
+	g_CurrentStats = UploadStats();
+}
+
+void UploadManager::BeginAsyncUploads()
+{
+	g_AsyncUploads = true;
+}
+
+void UploadManager::EndAsyncUploads()
+{
+	g_AsyncUploads = false;
+}
+
+uint64_t UploadManager::GetCurrentBatch()
+{
+	return g_NextBatchId;
+}
+
+bool UploadManager::IsComplete(uint64_t batch)
+{
+	if (Utils::IsBatchDone(batch))
+		return true;
+
+	RetireCompletedBatches();
+	return Utils::IsBatchDone(batch);
+}
+
+void UploadManager::WaitForBatch(uint64_t batch)
+{
+	if (batch >= g_NextBatchId)
+	{
+		Flush();
+	}
+
+	VkDevice device = AstranEditorUI::GetDevice();
+	while (!Utils::IsBatchDone(batch))
+	{
+		UploadBatch* waited = Utils::FindBatch(batch);
+		if (!waited->copied)
+		{
+			// Copies retire in order, wait for the oldest one still running
+			for (UploadBatch& running : g_InFlightBatches)
+			{
+				if (running.copied)
+					continue;
+
+				Utils::WaitForCopies(running);
+				break;
+			}
+		}
+		else
+		{
+			// The copies are done, the graphics queue still has to acquire the images
+			if (!waited->acquireBatch)
+				Flush();
+			VkResult err = vkWaitForFences(device, 1, &Utils::FindBatch(waited->acquireBatch)->fence, VK_TRUE, UINT64_MAX);
+			check_vk_result(err);
+		}
+		RetireCompletedBatches();
+	}
+}
+
+const UploadStats& UploadManager::GetLastFrameStats()
+{
+	return g_LastFrameStats;
+}
+
+uint64_t UploadManager::GetStagingBytesInUse()
+{
+	return g_RingUsed + g_DedicatedBytes;
+}
+
+void UploadManager::Flush()
+{
+	if (g_PendingUploads.empty() && g_PendingAcquires.empty())
+	{
+		// Dedicated buffers can only exist alongside an upload, nothing else holds ring space
+		return;
+	}
+
+	VkResult err;
+
+	UploadBatch batch;
+	batch.id = g_NextBatchId++;
+
+	std::vector<PendingImageUpload> graphics_uploads;
+	std::vector<PendingImageUpload> transfer_uploads;
+	for (PendingImageUpload& upload : g_PendingUploads)
+	{
+		(upload.transfer ? transfer_uploads : graphics_uploads).push_back(std::move(upload));
+	}
+
+	if (!transfer_uploads.empty())
+	{
+		batch.transferCommandBuffer = Utils::BeginCommandBuffer(g_TransferCommandPool, g_FreeTransferCommandBuffers);
+		batch.transferFence = Utils::AcquireFence();
+		batch.acquires = Utils::RecordUploads(batch.transferCommandBuffer, transfer_uploads, true);
+		err = vkEndCommandBuffer(batch.transferCommandBuffer);
+		check_vk_result(err);
+
+		// Not through the GpuCompletionTracker, its values order the graphics queue only
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &batch.transferCommandBuffer;
+		err = vkQueueSubmit(AstranEditorUI::GetTransferQueue(), 1, &submit_info, batch.transferFence);
+		check_vk_result(err);
+		g_CurrentStats.Submits++;
+	}
+
+	if (!graphics_uploads.empty() || !g_PendingAcquires.empty())
+	{
+		batch.commandBuffer = Utils::BeginCommandBuffer(g_CommandPool, g_FreeCommandBuffers);
+		batch.fence = Utils::AcquireFence();
+
+		if (!g_PendingAcquires.empty())
+		{
+			// Their transfer fences were seen signalled, no semaphore wait holds up this submit
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, (uint32_t)g_PendingAcquires.size(), g_PendingAcquires.data());
+			for (uint64_t acquired : g_PendingAcquireBatches)
+			{
+				Utils::FindBatch(acquired)->acquireBatch = batch.id;
+			}
+			batch.acquiredBatches.swap(g_PendingAcquireBatches);
+			g_PendingAcquires.clear();
+		}
+
+		if (!graphics_uploads.empty())
+		{
+			Utils::RecordUploads(batch.commandBuffer, graphics_uploads, false);
+		}
+
+		err = vkEndCommandBuffer(batch.commandBuffer);
+		check_vk_result(err);
+
+		VkSubmitInfo submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &batch.commandBuffer;
+		GpuCompletionTracker::Submit(AstranEditorUI::GetQueue(), submit_info, batch.fence);
+		g_CurrentStats.Submits++;
+	}
+
+	batch.ringBytes = g_PendingRingBytes;
+	batch.dedicatedBuffers.swap(g_PendingDedicatedBuffers);
+	g_InFlightBatches.push_back(std::move(batch));
+
+	g_PendingUploads.clear();
+	g_PendingRingBytes = 0;
+}
+
+void UploadManager::RetireCompletedBatches()
+{
+	VkDevice device = AstranEditorUI::GetDevice();
+
+	// Each queue finishes its parts in submission order, staging goes back in batch order
+	for (UploadBatch& batch : g_InFlightBatches)
+	{
+		if (batch.copied)
+			continue;
+		if (!Utils::IsSignalled(batch.fence) || !Utils::IsSignalled(batch.transferFence))
+			break;
+
+		for (DedicatedStagingBuffer& dedicated : batch.dedicatedBuffers)
+		{
+			vkDestroyBuffer(device, dedicated.buffer, nullptr);
+			DeviceMemoryAllocator::Free(dedicated.memory);
+			g_DedicatedBytes -= dedicated.size;
+		}
+		batch.dedicatedBuffers.clear();
+
+		g_RingUsed -= batch.ringBytes;
+		g_RingTail = (g_RingTail + batch.ringBytes) % g_RingSize;
+
+		VkResult err;
+		if (batch.fence)
+		{
+			err = vkResetFences(device, 1, &batch.fence);
+			check_vk_result(err);
+			err = vkResetCommandBuffer(batch.commandBuffer, 0);
+			check_vk_result(err);
+			g_FreeFences.push_back(batch.fence);
+			g_FreeCommandBuffers.push_back(batch.commandBuffer);
+		}
+		if (batch.transferFence)
+		{
+			err = vkResetFences(device, 1, &batch.transferFence);
+			check_vk_result(err);
+			err = vkResetCommandBuffer(batch.transferCommandBuffer, 0);
+			check_vk_result(err);
+			g_FreeFences.push_back(batch.transferFence);
+			g_FreeTransferCommandBuffers.push_back(batch.transferCommandBuffer);
+		}
+
+		for (uint64_t acquired : batch.acquiredBatches)
+		{
+			Utils::FindBatch(acquired)->done = true;
+		}
+
+		batch.copied = true;
+		if (batch.acquires.empty())
+		{
+			batch.done = true;
+		}
+		else
+		{
+			g_PendingAcquires.insert(g_PendingAcquires.end(), batch.acquires.begin(), batch.acquires.end());
+			g_PendingAcquireBatches.push_back(batch.id);
+			batch.acquires.clear();
+		}
+	}
+
+	while (!g_InFlightBatches.empty() && g_InFlightBatches.front().done)
+	{
+		g_InFlightBatches.pop_front();
+	}
+}
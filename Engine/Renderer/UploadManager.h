@@ -0,0 +1,74 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+struct UploadStats
+{
+	uint32_t Uploads = 0;
+	uint64_t Bytes = 0;
+	uint32_t Submits = 0;
+};
+
+struct StagingAllocation
+{
+	void* Data = nullptr;
+	VkBuffer Buffer = VK_NULL_HANDLE;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+};
+
+// Owns one persistently mapped staging ring. Image copies queued during a frame are recorded into a
+// single command buffer with batched layout barriers and submitted once from SubmitFrame.
+// With a dedicated transfer queue, async uploads (see BeginAsyncUploads) are copied there instead and
+// handed to the graphics queue family by a later batch, so streaming never delays the frame's submit.
+// Render thread only.
+class UploadManager
+{
+public:
+	static void Initialize(VkDeviceSize ringSize = 64ull * 1024 * 1024);
+	static void Shutdown();
+
+	// Reserves staging memory for this frame's batch. Requests larger than the ring get a
+	// dedicated buffer that is released once the batch retires, so do requests the ring can't make
+	// room for because allocations whose copies aren't queued yet hold the rest of it.
+	static StagingAllocation AllocateStaging(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+	// Queues copies from a staging allocation into every mip/layer of image. The whole image is
+	// overwritten, the previous contents are discarded. sampled: frames in flight may still read the
+	// image, the copies wait for their fragment shaders.
+	static void QueueImageUpload(VkImage image, const StagingAllocation& staging, const VkBufferImageCopy* regions, uint32_t regionCount, uint32_t mipLevels = 1, uint32_t arrayLayers = 1, bool sampled = false);
+
+	// Like QueueImageUpload but texels outside the regions keep their contents. The image must have
+	// been uploaded before, it is expected in SHADER_READ_ONLY_OPTIMAL.
+	static void QueueImageUpdate(VkImage image, const StagingAllocation& staging, const VkBufferImageCopy* regions, uint32_t regionCount, uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
+
+	// Fills levels [1, mipLevels) of an image queued this frame from its level 0 with a linear
+	// vkCmdBlitImage chain. The format must support linear filtered blits, see Texture.
+	static void QueueMipGeneration(VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// Allocate + memcpy + queue for the common single level case
+	static void UploadImage(VkImage image, uint32_t width, uint32_t height, const void* data, VkDeviceSize size);
+
+	// Call once per frame before the frame's own queue submit so uploads land first
+	static void SubmitFrame();
+
+	// Whole image uploads queued in between are only sampled once IsComplete reports their batch, e.g.
+	// by the TextureLoader. They may run on the transfer queue and complete a frame or two later.
+	static void BeginAsyncUploads();
+	static void EndAsyncUploads();
+
+	// Id of the batch that uploads queued right now will be part of
+	static uint64_t GetCurrentBatch();
+	static bool IsComplete(uint64_t batch);
+	static void WaitForBatch(uint64_t batch);
+
+	static const UploadStats& GetLastFrameStats();
+
+	// Ring bytes not yet reclaimed plus dedicated buffers waiting on their batch
+	static uint64_t GetStagingBytesInUse();
+
+private:
+	static void QueueCopies(VkImage image, const StagingAllocation& staging, const VkBufferImageCopy* regions, uint32_t regionCount, uint32_t mipLevels, uint32_t arrayLayers, bool preserveContents, bool sampled);
+	static void Flush();
+	static void RetireCompletedBatches();
+};